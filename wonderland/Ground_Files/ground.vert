@@ -5,7 +5,15 @@ layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec2 vertexUV;
 
 // Uniforms
-uniform mat4 MVP;
+uniform mat4 M;
+
+// Shared with every other program, uploaded once a frame (render/uniform_blocks.h)
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 // Outputs to fragment shader
 out vec2 uv;
@@ -13,5 +21,5 @@ out vec2 uv;
 void main()
 {
     uv = vertexUV;
-    gl_Position = MVP * vec4(vertexPosition, 1.0);
+    gl_Position = viewProjection * M * vec4(vertexPosition, 1.0);
 }
\ No newline at end of file
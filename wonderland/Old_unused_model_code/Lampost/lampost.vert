@@ -5,14 +5,42 @@ layout (location = 0) in vec3 position;
 //layout(location = 1) in vec3 vertexColor;
 //layout (location = 1) in vec3 normal;
 
+// Skinning attributes, bindMesh maps JOINTS_0 and WEIGHTS_0 here
+layout (location = 3) in vec4 joints;
+layout (location = 4) in vec4 weights;
+
 //out vec3 Normal;
 //out vec3 color;
 
 uniform mat4 MVP;
 
+// Has to match MAX_JOINTS in model/animation.h
+#define MAX_JOINTS 64
+
+// 3 rows of an affine matrix per joint
+layout (std140) uniform JointPalette {
+    vec4 jointRows[MAX_JOINTS * 3];
+};
+uniform bool skinned;
+
+vec3 skinPosition(vec4 p)
+{
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < 4; ++i)
+    {
+        int j = int(joints[i]) * 3;
+        result += weights[i] * vec3(dot(jointRows[j], p), dot(jointRows[j + 1], p), dot(jointRows[j + 2], p));
+    }
+    return result;
+}
+
 void main() 
 {
-    gl_Position = MVP * vec4(position, 1.0);
+    vec4 p = vec4(position, 1.0);
+    if (skinned)
+        p = vec4(skinPosition(p), 1.0);
+
+    gl_Position = MVP * p;
 
     //color = vertexColor;
 }
\ No newline at end of file
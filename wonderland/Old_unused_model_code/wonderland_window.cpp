@@ -12,6 +12,16 @@
 #include <stb/stb_image_write.h>
 
 #include <render/shader.h>
+#include <render/vertex_layout.h>
+#include <render/uniform_blocks.h>
+#include <render/stream_buffer.h>
+#include <render/gl_resource.h>
+#include <core/job_system.h>
+#include <core/trace.h>
+#include <scene/builtin_meshes.h>
+#include <scene/terrain.h>
+#include <model/animation.h>
+#include <model/mesh_lod.h>
 
 #include <vector>
 #include <iostream>
@@ -60,11 +70,11 @@ const glm::vec3 wave700(205.0f, 0.0f, 0.0f);
 static glm::vec3 lightIntensity = 5.0f * (8.0f * wave500 + 15.6f * wave600 + 18.4f * wave700);
 static glm::vec3 lightPosition(-275.0f, 500.0f, -275.0f);
 
+// T writes the last few seconds of CPU zones to trace.json
+static bool saveTrace = false;
 
-// For heightmap Heightmap.c
-#define MAX_CIRCLE_SIZE (50.0f)
-#define MAX_DISPLACEMENT (5.0f)
-#define DISPLACEMENT_SIGN_LIMIT (0.3f)
+
+// For heightmap Heightmap.c, the bumps themselves are in scene/terrain.h
 #define MAX_ITER (2000)
 #define MAP_SIZE (2000.0f)
 #define MAP_NUM_VERTICES (100)
@@ -73,13 +83,13 @@ static glm::vec3 lightPosition(-275.0f, 500.0f, -275.0f);
 
 
 // function for loading textures
-static GLuint LoadTextureTileBox(const char* texture_file_path, bool flip) {
+static GLTexture LoadTextureTileBox(const char* texture_file_path, bool flip) {
 	int w, h, channels;
 	stbi_set_flip_vertically_on_load(flip); // This flips our texture along its x axis. Whether or not to flip is decide by parameter flip
 	uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
 
-	GLuint texture;
-	glGenTextures(1, &texture);
+	GLTexture texture;
+	texture.create(texture_file_path);
 	glBindTexture(GL_TEXTURE_2D, texture);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -96,6 +106,7 @@ static GLuint LoadTextureTileBox(const char* texture_file_path, bool flip) {
 		/////////TEST
 		int testVariable = 1;    // This line is throwing the excepttion
 		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.setBytes(glTextureBytes(GL_RGB, w, h, 0));
 	}
 	else {
 		std::cout << "Failed to load texture " << texture_file_path << std::endl;
@@ -109,151 +120,15 @@ struct Skybox {
 	glm::vec3 position;		// Position of the box - should be equal 
 	glm::vec3 scale;		// Size of the skybox in each axis
 
-	GLfloat vertex_buffer_data[72] = {	// Vertex definition for a canonical box
-		// if we swap position of two opposite corners, then rotate 90 degrees to right, it swaps
-		// left - all good
-		//  z,    y,   x   
-		-1.0f, -1.0f, 1.0f,		// top left
-		-1.0f, 1.0f, 1.0f,		// bottom left
-		1.0f, 1.0f, 1.0f,		// bottom right
-		1.0f, -1.0f, 1.0f,		// top right
-
-		// right - All good
-		1.0f, -1.0f, -1.0f,		// bottom right
-		1.0f, 1.0f, -1.0f,		// top right
-		-1.0f, 1.0f, -1.0f,		// top left
-		-1.0f, -1.0f, -1.0f,	// bottom left
-
-		// front - All good
-		-1.0f, -1.0f, -1.0f,	// bottom left
-		-1.0f, 1.0f, -1.0f,		// top left
-		-1.0f, 1.0f, 1.0f,		// top right
-		-1.0f, -1.0f, 1.0f,		// bottom right
-
-		// behind - All good
-		1.0f, -1.0f, 1.0f,		// bottom right
-		1.0f, 1.0f, 1.0f,		// top right
-		1.0f, 1.0f, -1.0f,		// top left
-		1.0f, -1.0f, -1.0f,		// bottom left
-
-		// top - All good
-		-1.0f, 1.0f, -1.0f,		// 
-		1.0f, 1.0f, -1.0f,
-		1.0f, 1.0f, 1.0f,		//
-		-1.0f, 1.0f, 1.0f,
-
-		// bottom - pointing outwards (flip by swapping zs)
-		1.0f, -1.0f, -1.0f,		//
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f, 1.0f,		//
-		1.0f, -1.0f, 1.0f,
-	};
-
-	GLfloat color_buffer_data[72] = {
-		// Front, red
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		// Back, yellow
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-
-		// Left, green
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		// Right, cyan
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-
-		// Top, blue
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-
-		// Bottom, magenta
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-	};
-
-	GLuint index_buffer_data[36] = {		// 12 triangle faces of a box
-		0, 1, 2,
-		0, 2, 3,
-
-		4, 5, 6,
-		4, 6, 7,
-
-		8, 9, 10,
-		8, 10, 11,
-
-		12, 13, 14,
-		12, 14, 15,
-
-		16, 17, 18,
-		16, 18, 19,
-
-		20, 21, 22,
-		20, 22, 23,
-	};
-
-
-	// Here I am making everything end 1 before it actually should because I was getting black lines in the skybox
-	GLfloat uv_buffer_data[48] = {
-		// x, y
-		// left
-		0.25f, 0.334f,		// bottom right
-		0.25f, 0.666f,		// top right
-		0.0f, 0.666f,		// top left					BRING BACK
-		0.0f, 0.334f,		// bottom left
-		// right
-		0.75f, 0.334f,
-		0.75f, 0.666f,
-		0.5f, 0.666f,
-		0.5f, 0.334f,
-		// front
-		0.5f, 0.334f,		// bottom right
-		0.5f, 0.666f,		// top right
-		0.25f, 0.666f,		// top left
-		0.25f, 0.334f,		// bottom left
-		// behind
-		1.0f, 0.334f,
-		1.0f, 0.666f,
-		0.75f, 0.666f,
-		0.75f, 0.334f,
-		// Top
-		0.5f, 0.667f,		// 
-		0.5f, 1.0f,			//
-		0.251f, 1.0f,		// X is higher to avoid a black line
-		0.251f, 0.667f,		// 
-		// Bottom
-		0.499f, 0.0f,
-		0.499f, 0.334f,
-		0.25f, 0.334f,
-		0.25f, 0.0f,
-
-	};
-
-	// OpenGL buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint uvBufferID;
-	GLuint textureID;
+	// OpenGL buffers. Positions and uvs share one interleaved buffer, the
+	// vertex array has the layout and index buffer baked in
+	GLVertexArray vertexArrayID;
+	GLBuffer vertexBufferID;
+	GLBuffer indexBufferID;
+	GLTexture textureID;
 
 	// Shader variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
@@ -262,29 +137,28 @@ struct Skybox {
 		this->position = position;
 		this->scale = scale;
 
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create a vertex buffer object to store the vertex data		
-		glGenBuffers(1, &vertexBufferID);
+		// No color stream, skybox.frag only samples the texture
+		VertexStream streams[] = {
+			{ 0, 3, skybox_vertex_buffer_data },
+			{ 2, 2, skybox_uv_buffer_data },
+		};
+		std::vector<GLfloat> vertices;
+		VertexLayout layout;
+		interleaveStreams(streams, 2, 24, vertices, layout);
+
+		// Create a vertex buffer object to store the interleaved vertex data
+		vertexBufferID.create("skybox");
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the UV data
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+		vertexBufferID.setBytes(vertices.size() * sizeof(GLfloat));
 
 		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
+		indexBufferID.create("skybox");
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(skybox_index_buffer_data), skybox_index_buffer_data, GL_STATIC_DRAW);
+		indexBufferID.setBytes(sizeof(skybox_index_buffer_data));
+
+		vertexArrayID = createVertexArray(vertexBufferID, indexBufferID, layout, "skybox");
 
 		// Create and compile our GLSL program from the shaders
 		//programID = LoadShadersFromFile("../lab2/box.vert", "../lab2/box.frag");
@@ -295,8 +169,9 @@ struct Skybox {
 			std::cerr << "Failed to load shaders." << std::endl;
 		}
 
-		// Get a handle for our "MVP" uniform
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
+		// skybox.vert takes the camera from the shared ViewData block and just the model matrix here
+		modelMatrixID = glGetUniformLocation(programID, "M");
+		bindUniformBlocks(programID);
 
 		// Load a texture
 		textureID = LoadTextureTileBox("../../../wonderland/Skybox_Files/Skybox_1.png", true);
@@ -305,20 +180,10 @@ struct Skybox {
 		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
 	}
 
-	void render(glm::mat4 cameraMatrix) {
+	void render() {
 		glUseProgram(programID);
 
-		glBindVertexArray(vertexArrayID); // solves skybox dissapearing when lamp rendered
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+		glBindVertexArray(vertexArrayID);
 
 		// Model transform 
 		glm::mat4 modelMatrix = glm::mat4();
@@ -328,15 +193,8 @@ struct Skybox {
 		// Scale the box along each axis
 		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// Set model-view-projection matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
+		glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
 
-		// Enable UV buffer and texture sampler
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 		// Set textureSampler to use texture unit 0
 		glActiveTexture(GL_TEXTURE0);
@@ -351,55 +209,28 @@ struct Skybox {
 			GL_UNSIGNED_INT,   // type
 			(void*)0           // element array buffer offset
 		);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		//glDisableVertexAttribArray(2);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteTextures(1, &textureID);
+		vertexBufferID.reset();
+		indexBufferID.reset();
+		vertexArrayID.reset();
+		textureID.reset();
 		glDeleteProgram(programID);
 	}
 };
 
 struct CornellBox {
 
-	GLfloat vertex_buffer_data[60];
-	GLfloat normal_buffer_data[60];
-	GLfloat color_buffer_data[60];
-
-	// Refer to original Cornell Box data 
-	// from https://www.graphics.cornell.edu/online/box/data.html
+	// These point at the shared arrays in builtin_meshes, they all have 20 vertices
+	const GLfloat* vertex_buffer_data;
+	const GLfloat* normal_buffer_data;
+	const GLfloat* color_buffer_data;
 
-	GLuint index_buffer_data[30] = {
-		0, 1, 2,
-		0, 2, 3,
-
-		4, 5, 6,
-		4, 6, 7,
-
-		8, 9, 10,
-		8, 10, 11,
-
-		12, 13, 14,
-		12, 14, 15,
-
-		16, 17, 18,
-		16, 18, 19,
-	};
-
-	// OpenGL buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint normalBufferID;
+	// OpenGL buffers, positions/colors/normals interleaved in one
+	GLVertexArray vertexArrayID;
+	GLBuffer vertexBufferID;
+	GLBuffer indexBufferID;
 
 	// Shader variable IDs
 	GLuint mvpMatrixID;
@@ -407,35 +238,34 @@ struct CornellBox {
 	GLuint lightIntensityID;
 	GLuint programID;
 
-	void initialize(GLfloat vertex_buffer_data[60], GLfloat normal_buffer_data[60], GLfloat color_buffer_data[60]) {
+	void initialize(const GLfloat* vertex_buffer_data, const GLfloat* normal_buffer_data, const GLfloat* color_buffer_data) {
 
-		memcpy(this->vertex_buffer_data, vertex_buffer_data, sizeof(this->vertex_buffer_data));
-		memcpy(this->normal_buffer_data, normal_buffer_data, sizeof(this->normal_buffer_data));
-		memcpy(this->color_buffer_data, color_buffer_data, sizeof(this->color_buffer_data));
+		this->vertex_buffer_data = vertex_buffer_data;
+		this->normal_buffer_data = normal_buffer_data;
+		this->color_buffer_data = color_buffer_data;
 
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
+		VertexStream streams[] = {
+			{ 0, 3, this->vertex_buffer_data },
+			{ 1, 3, this->color_buffer_data },
+			{ 2, 3, this->normal_buffer_data },
+		};
+		std::vector<GLfloat> vertices;
+		VertexLayout layout;
+		interleaveStreams(streams, 3, 20, vertices, layout);
 
-		// Create a vertex buffer object to store the vertex data		
-		glGenBuffers(1, &vertexBufferID);
+		// Create a vertex buffer object to store the interleaved vertex data
+		vertexBufferID.create("cornell box");
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->vertex_buffer_data), this->vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->color_buffer_data), this->color_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the vertex normals		
-		glGenBuffers(1, &normalBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->normal_buffer_data), this->normal_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+		vertexBufferID.setBytes(vertices.size() * sizeof(GLfloat));
 
 		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
+		indexBufferID.create("cornell box");
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(box_index_buffer_data), box_index_buffer_data, GL_STATIC_DRAW);
+		indexBufferID.setBytes(sizeof(box_index_buffer_data));
+
+		vertexArrayID = createVertexArray(vertexBufferID, indexBufferID, layout, "cornell box");
 
 		// Create and compile our GLSL program from the shaders
 		programID = LoadShadersFromFile("../../../wonderland/wonderland_window.vert", "../../../wonderland/wonderland_window.frag");
@@ -453,19 +283,7 @@ struct CornellBox {
 	void render(glm::mat4 cameraMatrix) {
 		glUseProgram(programID);
 
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+		glBindVertexArray(vertexArrayID);
 
 		// Set model-view-projection matrix
 		glm::mat4 mvp = cameraMatrix;
@@ -482,18 +300,12 @@ struct CornellBox {
 			GL_UNSIGNED_INT,   // type
 			(void*)0           // element array buffer offset
 		);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &normalBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
+		vertexBufferID.reset();
+		indexBufferID.reset();
+		vertexArrayID.reset();
 		glDeleteProgram(programID);
 	}
 };
@@ -509,34 +321,40 @@ struct Heightmap
 	std::vector<unsigned int> indices;
 	std::vector<glm::vec2> uvs;
 
-	GLuint vertexArrayID, vertexBufferID, indexBufferID, uvBufferID, textureID;
+	GLVertexArray vertexArrayID;
+	GLBuffer vertexBufferID, indexBufferID, uvBufferID;
+	GLTexture textureID;
 	GLuint programID;
+	bool dirty = false;	// heights changed since the last upload
 	GLuint mvpMatrixID;
 	GLuint textureSamplerID;
 
 	void initialize()
 	{
-		initialiseMap();
-		generateIndices();
+		terrainGrid(N, MAP_SIZE, vertices, uvs);
+		terrainIndices(N, indices);
 
 		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
+		vertexArrayID.create("heightmap");
 		glBindVertexArray(vertexArrayID);
 
 		// Create a vertex buffer object to store the vertex data	
-		glGenBuffers(1, &vertexBufferID);
+		vertexBufferID.create("heightmap");
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_DYNAMIC_DRAW);
+		vertexBufferID.setBytes(vertices.size() * sizeof(glm::vec3));
 		// Using Dynamic Draw because the map can often change
 
-		glGenBuffers(1, &uvBufferID);
+		uvBufferID.create("heightmap");
 		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
 		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), uvs.data(), GL_STATIC_DRAW);
+		uvBufferID.setBytes(uvs.size() * sizeof(glm::vec2));
 
 		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
+		indexBufferID.create("heightmap");
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		indexBufferID.setBytes(indices.size() * sizeof(unsigned int));
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
@@ -562,110 +380,62 @@ struct Heightmap
 		textureSamplerID = glGetUniformLocation(programID, "terrainTextureSampler");
 	}
 
-	/* Generate vertices and indices for the heightmap
- */
-	void initialiseMap()
+	void updateMap()
 	{
-		vertices.resize(TOTAL);
-		uvs.resize(TOTAL);
-
-		GLfloat step = MAP_SIZE / (MAP_NUM_VERTICES - 1);
-		GLfloat x = -MAP_SIZE / 2;	//0,0 should be its center
-		GLfloat z = -MAP_SIZE / 2;
-		/* Create a flat grid */
-		int k = 0;
-		for (int i = 0; i < MAP_NUM_VERTICES; ++i)
-		{
-			for (int j = 0; j < MAP_NUM_VERTICES; ++j)
-			{
-				vertices[k] = glm::vec3(
-					x,
-					0.0f,
-					z
-				);
-				z += step;
-
-				// setting up the uv
-				float u = (float)i / (MAP_NUM_VERTICES - 1);
-				float v = (float)j / (MAP_NUM_VERTICES - 1);
-				uvs[k] = glm::vec2(u, v);
-
-				++k;
-			}
-			x += step;
-			z = -MAP_SIZE / 2;
-		}
+		applyTerrainBump(randomTerrainBump(MAP_SIZE), vertices.data(), 0, (int)vertices.size());
+
+		// Uploaded next frame, however many times this gets called before then
+		dirty = true;
 	}
 
-	void generateIndices()
+	// Same result as calling updateMap iterations times. The bumps are rolled here
+	// in the same order, then every job applies all of them to its own vertices.
+	void generate(JobSystem& jobs, int iterations)
 	{
-		for (int x = 0; x < N - 1; ++x)
-		{
-			for (int z = 0; z < N - 1; ++z)
-			{
-				int i = x * N + z;
-
-				indices.push_back(i);
-				indices.push_back(i + 1);
-				indices.push_back(i + N);
-
-				indices.push_back(i + 1);
-				indices.push_back(i + N + 1);
-				indices.push_back(i + N);
-			}
-		}
+		TRACE_ZONE("generate terrain");
+		std::vector<TerrainBump> bumps(iterations);
+		for (int i = 0; i < iterations; ++i)
+			bumps[i] = randomTerrainBump(MAP_SIZE);
+
+		const TerrainBump* bumpData = bumps.data();
+		parallelFor(jobs, (int)vertices.size(), 256, [this, bumpData, iterations](int begin, int end) {
+			TRACE_ZONE("apply bumps");
+			for (int i = 0; i < iterations; ++i)
+				applyTerrainBump(bumpData[i], vertices.data(), begin, end);
+		});
+		dirty = true;
 	}
 
-	void updateMap()
+	// Writes the new heights into the stream buffer and has the GPU copy them across,
+	// so the CPU never waits on a vertex buffer the last frame might still be drawing
+	void upload(StreamBuffer& stream)
 	{
-		/* center of the circle */
-		/*
-		float center_x = (MAP_SIZE * rand()) / RAND_MAX;
-		float center_z = (MAP_SIZE * rand()) / RAND_MAX;
-		*/
-		float center_x = ((float)rand() / RAND_MAX - 0.5f) * MAP_SIZE;
-		float center_z = ((float)rand() / RAND_MAX - 0.5f) * MAP_SIZE;
-		float circle_size = (MAX_CIRCLE_SIZE * rand()) / RAND_MAX;
-		float sign = ((float)rand() / RAND_MAX) < DISPLACEMENT_SIGN_LIMIT ? -1.0f : 1.0f;
-		float disp = (sign * (MAX_DISPLACEMENT * rand())) / RAND_MAX;
-
-		//disp = disp / 2.0f;   -  Removing this
-
-		for (auto& v : vertices) // For all vertices
-		{
-			GLfloat dx = center_x - v.x;	// x distance
-			GLfloat dz = center_z - v.z;	// y distance from 
-			GLfloat pd = (sqrt((dx * dx) + (dz * dz))) / circle_size; // it recommends removing the 2 *
-			if (fabs(pd) <= 1.0f)
-			{
-				v.y += disp * cos(pd*pd * glm::pi<float>());
-			}
-		}
+		if (!dirty)
+			return;
 
-		// Upload new heights to GPU
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(glm::vec3), vertices.data());
+		size_t size = vertices.size() * sizeof(glm::vec3);
+		StreamAllocation allocation = stream.allocate(size);
+		if (allocation.data == NULL)
+			return;
+		memcpy(allocation.data, vertices.data(), size);
+		stream.flush();
+
+		glBindBuffer(GL_COPY_READ_BUFFER, stream.bufferID);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBufferID);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, 0, size);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		dirty = false;
 	}
 
 	void render(glm::mat4 cameraMatrix)
 	{
 		glUseProgram(programID);
 
-		glBindVertexArray(vertexArrayID); // not sure if this is needed
-
-		// Adding these in to match previou stuff
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		
-		glEnableVertexAttribArray(1);	// Think thi needs to change to 1 - but some other stuff also needs to change
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		
+		// Attributes and index buffer were captured in the vertex array at initialize.
+		// Positions stay in their own buffer since updateMap rewrites them.
+		glBindVertexArray(vertexArrayID);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		
 		// TODO: make the size the same as the skybox, and center it on the player
 		glm::mat4 modelMatrix = glm::mat4();
 
@@ -685,10 +455,6 @@ struct Heightmap
 			indices.size(),
 			GL_UNSIGNED_INT,
 			(void*)0);
-
-		//Another add in to match
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
 	}
 
 	// A function so the ground's y position doesnt change
@@ -698,9 +464,11 @@ struct Heightmap
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
+		vertexBufferID.reset();
+		uvBufferID.reset();
+		indexBufferID.reset();
+		vertexArrayID.reset();
+		textureID.reset();
 		glDeleteProgram(programID);
 	}
 };
@@ -710,37 +478,41 @@ struct Lampost {
 	GLuint mvpMatrixID;
 	GLuint lightPositionID;
 	GLuint lightIntensityID;
+	GLuint skinnedID;
 	GLuint programID;
 
 	tinygltf::Model model;
 
+	// Skinning - one skeleton and clip per glTF skin, played back by the animation system
+	AnimationSystem* animation = NULL;
+	std::vector<Skeleton> skeletons;
+	std::vector<AnimationClip> clips;
+	std::vector<int> skinInstances;	// animation instance for each skin, -1 if it cant be played
+	glm::mat4 rootTransform;
+
 	struct PrimitiveObject {
 		GLuint vao;
 		std::map<int, GLuint> vbos;
+
+		// Level of detail - coarser index lists from wonderland_lodgen, all in one buffer
+		GLuint lodIndexBufferID = 0;
+		PrimitiveLods lods;
+		glm::vec3 boundsCenter;
+		float boundsRadius = 0.0f;
 	};
 	std::vector<PrimitiveObject> primitiveObjects;
+	std::map<int, int> meshFirstPrimitive;	// mesh index -> its first entry in primitiveObjects
+	// Level each node is drawing its primitives at. Kept per node rather than on the
+	// primitive, a mesh can be placed by several nodes at different distances.
+	std::vector<int> nodeLods;
+	std::vector<int> nodeFirstLod;	// node index -> its first entry in nodeLods, -1 without a mesh
+	// What the ids above point at, so cleanup can let all of them go
+	std::vector<GLBuffer> buffers;
+	std::vector<GLVertexArray> vertexArrays;
 
-
-	glm::mat4 getNodeTransform(const tinygltf::Node& node) {
-		glm::mat4 transform(1.0f);
-
-		if (node.matrix.size() == 16) {
-			transform = glm::make_mat4(node.matrix.data());
-		}
-		else {
-			if (node.translation.size() == 3)
-				transform = glm::translate(transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-
-			if (node.rotation.size() == 4) {
-				glm::quat q(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-				transform *= glm::mat4_cast(q);
-			}
-
-			if (node.scale.size() == 3)
-				transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-		}
-		return transform;
-	}
+	std::string modelPath = "../../../wonderland/Old_unused_model_code/Lampost/rusticLamps.gltf";
+	float lodPixelScale = 1.0f;	// turns radius / distance into pixels
+	size_t trianglesDrawn = 0;
 
 
 	bool loadModel(tinygltf::Model& model, const char* filename) {
@@ -765,17 +537,28 @@ struct Lampost {
 		return res;
 	}
 
-	void initialize() {
+	void initialize(AnimationSystem& animation) {
 		// Modify your path if needed
-		if (!loadModel(model, "../../../wonderland/Lampost/rusticLamps.gltf")) {
+		if (!loadModel(model, modelPath.c_str())) {
 			return;
 		}
 
 		// Prepare buffers for rendering 
 		primitiveObjects = bindModel(model);
+		initializeLods();
+
+		nodeFirstLod.assign(model.nodes.size(), -1);
+		for (size_t i = 0; i < model.nodes.size(); ++i) {
+			int mesh = model.nodes[i].mesh;
+			if (mesh >= 0 && mesh < (int)model.meshes.size()) {
+				nodeFirstLod[i] = (int)nodeLods.size();
+				nodeLods.resize(nodeLods.size() + model.meshes[mesh].primitives.size(), 0);
+			}
+		}
 
 		// Create and compile our GLSL program from the shaders
-		programID = LoadShadersFromFile("../../../wonderland/lampost.vert", "../../../wonderland/lampost.frag");
+		programID = LoadShadersFromFile("../../../wonderland/Old_unused_model_code/Lampost/lampost.vert",
+			"../../../wonderland/Old_unused_model_code/Lampost/lampost.frag");
 		if (programID == 0)
 		{
 			std::cerr << "Failed to load shaders." << std::endl;
@@ -785,6 +568,81 @@ struct Lampost {
 		mvpMatrixID = glGetUniformLocation(programID, "MVP");
 		lightPositionID = glGetUniformLocation(programID, "lightPosition");
 		lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
+		skinnedID = glGetUniformLocation(programID, "skinned");
+
+		GLuint paletteBlock = glGetUniformBlockIndex(programID, "JointPalette");
+		if (paletteBlock != GL_INVALID_INDEX)
+			glUniformBlockBinding(programID, paletteBlock, JOINT_PALETTE_BINDING);
+
+		initializeSkins(animation);
+	}
+
+	// Distant lamps are drawn with the coarser index lists generated offline
+	void initializeLods() {
+		std::vector<PrimitiveLods> allLods;
+		if (!loadLodFile(lodFilePath(modelPath), allLods)) {
+			std::cout << "No LODs for " << modelPath << ", run wonderland_lodgen to make them" << std::endl;
+			return;
+		}
+
+		for (size_t i = 0; i < allLods.size(); ++i) {
+			// A stale file can name primitives the model doesnt have any more, or index
+			// past their vertices. Those are skipped, the primitive just stays at full detail.
+			std::map<int, int>::iterator first = meshFirstPrimitive.find(allLods[i].mesh);
+			if (first == meshFirstPrimitive.end() || allLods[i].primitive < 0 ||
+				allLods[i].primitive >= (int)model.meshes[allLods[i].mesh].primitives.size()) {
+				std::cout << "Skipping LODs for mesh " << allLods[i].mesh << " primitive " << allLods[i].primitive
+					<< ", the model has no such primitive" << std::endl;
+				continue;
+			}
+
+			const tinygltf::Primitive& primitive = model.meshes[allLods[i].mesh].primitives[allLods[i].primitive];
+			std::map<std::string, int>::const_iterator position = primitive.attributes.find("POSITION");
+			size_t vertexCount = position != primitive.attributes.end() ? model.accessors[position->second].count : 0;
+			unsigned int maxIndex = 0;
+			for (size_t j = 0; j < allLods[i].indices.size(); ++j)
+				maxIndex = std::max(maxIndex, allLods[i].indices[j]);
+			if (!allLods[i].indices.empty() && maxIndex >= vertexCount) {
+				std::cout << "Skipping LODs for mesh " << allLods[i].mesh << " primitive " << allLods[i].primitive
+					<< ", they index past its " << vertexCount << " vertices" << std::endl;
+				continue;
+			}
+
+			PrimitiveObject& primitiveObject = primitiveObjects[first->second + allLods[i].primitive];
+			primitiveObject.lods = allLods[i];
+
+			GLBuffer lodIndexBuffer;
+			lodIndexBuffer.create(modelPath + " lods");
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodIndexBuffer);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, allLods[i].indices.size() * sizeof(unsigned int),
+				allLods[i].indices.data(), GL_STATIC_DRAW);
+			lodIndexBuffer.setBytes(allLods[i].indices.size() * sizeof(unsigned int));
+			primitiveObject.lodIndexBufferID = lodIndexBuffer;
+			buffers.push_back(std::move(lodIndexBuffer));
+			primitiveObject.lods.indices.clear();	// only needed on the GPU
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	void initializeSkins(AnimationSystem& animation) {
+		this->animation = &animation;
+
+		// Sized up front - the animation instances keep pointers into these
+		skeletons.resize(model.skins.size());
+		clips.resize(model.skins.size());
+		skinInstances.assign(model.skins.size(), -1);
+
+		for (size_t i = 0; i < model.skins.size(); ++i) {
+			if (!buildSkeleton(model, model.skins[i], skeletons[i]))
+				continue;
+
+			// Just play the first animation for now
+			const AnimationClip* clip = NULL;
+			if (!model.animations.empty() && buildAnimationClip(model, model.animations[0], skeletons[i], clips[i]))
+				clip = &clips[i];
+
+			skinInstances[i] = animation.addInstance(&skeletons[i], clip);
+		}
 	}
 
 
@@ -806,13 +664,15 @@ struct Lampost {
 			}
 
 			const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-			GLuint vbo;
-			glGenBuffers(1, &vbo);
+			GLBuffer vbo;
+			vbo.create(modelPath);
 			glBindBuffer(target, vbo);
 			glBufferData(target, bufferView.byteLength,
 				&buffer.data.at(0) + bufferView.byteOffset, GL_STATIC_DRAW);
+			vbo.setBytes(bufferView.byteLength);
 
 			vbos[i] = vbo;
+			buffers.push_back(std::move(vbo));
 		}
 
 		// Each mesh can contain several primitives (or parts), each we need to 
@@ -822,8 +682,10 @@ struct Lampost {
 			tinygltf::Primitive primitive = mesh.primitives[i];
 			tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
 
-			GLuint vao;
-			glGenVertexArrays(1, &vao);
+			GLVertexArray vertexArray;
+			vertexArray.create(modelPath);
+			GLuint vao = vertexArray;
+			vertexArrays.push_back(std::move(vertexArray));
 			glBindVertexArray(vao);
 
 			for (auto& attrib : primitive.attributes) {
@@ -858,6 +720,19 @@ struct Lampost {
 			PrimitiveObject primitiveObject;
 			primitiveObject.vao = vao;
 			primitiveObject.vbos = vbos;
+
+			// Bounding sphere for picking a LOD, glTF always gives POSITION a min and max
+			std::map<std::string, int>::iterator position = primitive.attributes.find("POSITION");
+			if (position != primitive.attributes.end()) {
+				const tinygltf::Accessor& accessor = model.accessors[position->second];
+				if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+					glm::vec3 lo(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
+					glm::vec3 hi(accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]);
+					primitiveObject.boundsCenter = (lo + hi) * 0.5f;
+					primitiveObject.boundsRadius = glm::length(hi - lo) * 0.5f;
+				}
+			}
+
 			primitiveObjects.push_back(primitiveObject);
 
 			glBindVertexArray(0);
@@ -869,6 +744,8 @@ struct Lampost {
 		tinygltf::Node& node) {
 		// Bind buffers for the current mesh at the node
 		if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
+			if (meshFirstPrimitive.find(node.mesh) == meshFirstPrimitive.end())
+				meshFirstPrimitive[node.mesh] = (int)primitiveObjects.size();
 			bindMesh(primitiveObjects, model, model.meshes[node.mesh]);
 		}
 
@@ -892,23 +769,47 @@ struct Lampost {
 	}
 
 	void drawMesh(const std::vector<PrimitiveObject>& primitiveObjects,
-		tinygltf::Model& model, tinygltf::Mesh& mesh) {
+		tinygltf::Model& model, tinygltf::Mesh& mesh, int firstPrimitive, int firstLod,
+		const glm::mat4& modelTransform, const glm::mat4& mvp) {
+
+		// Largest axis scale, so the bounding sphere still covers the mesh
+		float scale = std::max(glm::length(glm::vec3(modelTransform[0])),
+			std::max(glm::length(glm::vec3(modelTransform[1])), glm::length(glm::vec3(modelTransform[2]))));
 
 		for (size_t i = 0; i < mesh.primitives.size(); ++i)
 		{
-			GLuint vao = primitiveObjects[i].vao;
-			std::map<int, GLuint> vbos = primitiveObjects[i].vbos;
+			const PrimitiveObject& primitiveObject = primitiveObjects[firstPrimitive + i];
+			int& currentLod = nodeLods[firstLod + i];
+			GLuint vao = primitiveObject.vao;
+			const std::map<int, GLuint>& vbos = primitiveObject.vbos;
 
 			glBindVertexArray(vao);
 
 			tinygltf::Primitive primitive = mesh.primitives[i];
 			tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos.at(indexAccessor.bufferView));
+			// w is the distance in front of the camera, so this is the radius in pixels
+			if (primitiveObject.lodIndexBufferID) {
+				float w = (mvp * glm::vec4(primitiveObject.boundsCenter, 1.0f)).w;
+				float projectedRadius = w > zNear ? primitiveObject.boundsRadius * scale * lodPixelScale / w : 1e9f;
+				currentLod = selectLod(primitiveObject.lods, projectedRadius, currentLod);
+			}
 
-			glDrawElements(primitive.mode, indexAccessor.count,
-				indexAccessor.componentType,
-				BUFFER_OFFSET(indexAccessor.byteOffset));
+			if (currentLod > 0) {
+				const MeshLod& lod = primitiveObject.lods.levels[currentLod - 1];
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitiveObject.lodIndexBufferID);
+				glDrawElements(primitive.mode, lod.indexCount, GL_UNSIGNED_INT,
+					BUFFER_OFFSET(lod.indexOffset * sizeof(unsigned int)));
+				trianglesDrawn += lod.indexCount / 3;
+			}
+			else {
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos.at(indexAccessor.bufferView));
+
+				glDrawElements(primitive.mode, indexAccessor.count,
+					indexAccessor.componentType,
+					BUFFER_OFFSET(indexAccessor.byteOffset));
+				trianglesDrawn += indexAccessor.count / 3;
+			}
 
 			glBindVertexArray(0);
 		}
@@ -926,19 +827,30 @@ struct Lampost {
 	}
 	*/
 	void drawModelNodes(const std::vector<PrimitiveObject>& primitiveObjects,
-		tinygltf::Model& model, tinygltf::Node& node, glm::mat4 parentTransform,
+		tinygltf::Model& model, int nodeIndex, glm::mat4 parentTransform,
 		glm::mat4 cameraMatrix) {
 
-		glm::mat4 localTransform = parentTransform * getNodeTransform(node);
+		tinygltf::Node& node = model.nodes[nodeIndex];
+		glm::mat4 localTransform = parentTransform * nodeTransform(node);
 
 		// Draw the mesh at the node, and recursively do so for children nodes
 		if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
-			glm::mat4 mvp = cameraMatrix * localTransform;
+			bool skinned = node.skin >= 0 && node.skin < (int)skinInstances.size() && skinInstances[node.skin] >= 0;
+
+			// Skinned meshes ignore their node transform, the joints already place them in the model
+			glm::mat4 mvp = cameraMatrix * (skinned ? rootTransform : localTransform);
 			glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-			drawMesh(primitiveObjects, model, model.meshes[node.mesh]);
+			glUniform1i(skinnedID, skinned ? 1 : 0);
+			if (skinned)
+				animation->bindPalette(skinInstances[node.skin]);
+			else
+				animation->bindRestPalette();
+
+			drawMesh(primitiveObjects, model, model.meshes[node.mesh], meshFirstPrimitive[node.mesh],
+				nodeFirstLod[nodeIndex], skinned ? rootTransform : localTransform, mvp);
 		}
 		for (size_t i = 0; i < node.children.size(); i++) {
-			drawModelNodes(primitiveObjects, model, model.nodes[node.children[i]], localTransform, cameraMatrix);
+			drawModelNodes(primitiveObjects, model, node.children[i], localTransform, cameraMatrix);
 		}
 	}
 
@@ -957,9 +869,10 @@ struct Lampost {
 		glm::mat4 worldTransform) {
 		// Draw all nodes
 		const tinygltf::Scene& scene = model.scenes[model.defaultScene];
+		rootTransform = worldTransform;
 
 		for (size_t i = 0; i < scene.nodes.size(); ++i) {
-			drawModelNodes(primitiveObjects, model, model.nodes[scene.nodes[i]], worldTransform,
+			drawModelNodes(primitiveObjects, model, scene.nodes[i], worldTransform,
 				cameraMatrix);
 		}
 	}
@@ -988,10 +901,17 @@ struct Lampost {
 		glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
 
 		// Draw the GLTF model
+		lodPixelScale = windowHeight / (2.0f * tan(glm::radians(FoV) * 0.5f));
+		trianglesDrawn = 0;
 		drawModel(primitiveObjects, model, cameraMatrix, modelMatrix);
 	}
 
 	void cleanup() {
+		primitiveObjects.clear();
+		nodeLods.clear();
+		nodeFirstLod.clear();
+		buffers.clear();
+		vertexArrays.clear();
 		glDeleteProgram(programID);
 	}
 };
@@ -1049,149 +969,6 @@ int main(void)
 
 
 
-
-	GLfloat tallBoxVertexBufferData[60] = {
-		// This doesnt include one of the vertexes  - its fine its not visible
-		-423.0, 330.0, -247.0,
-		-265.0, 330.0, -296.0,
-		-314.0, 330.0, -456.0,
-		-472.0, 330.0, -406.0,
-
-		-423.0,   0.0, -247.0,
-		-423.0, 330.0, -247.0,
-		-472.0, 330.0, -406.0,
-		-472.0,   0.0, -406.0,
-
-		-472.0,   0.0, -406.0,
-		-472.0, 330.0, -406.0,
-		-314.0, 330.0, -456.0,
-		-314.0,   0.0, -456.0,
-
-		-314.0,   0.0, -456.0,
-		-314.0, 330.0, -456.0,
-		-265.0, 330.0, -296.0,
-		-265.0,   0.0, -296.0,
-
-		-265.0,   0.0, -296.0,
-		-265.0, 330.0, -296.0,
-		-423.0, 330.0, -247.0,
-		-423.0,   0.0, -247.0
-	};
-
-	GLfloat tallBoxNormalBufferData[60] = {
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
-	};
-
-	GLfloat smallBoxVertexBufferData[60] = {
-		-130.0, 165.0,  -65.0,
-		 -82.0, 165.0, -225.0,
-		-240.0, 165.0, -272.0,
-		-290.0, 165.0, -114.0,
-
-		-290.0,   0.0, -114.0,
-		-290.0, 165.0, -114.0,
-		-240.0, 165.0, -272.0,
-		-240.0,   0.0, -272.0,
-
-		-130.0,   0.0,  -65.0,
-		-130.0, 165.0,  -65.0,
-		-290.0, 165.0, -114.0,
-		-290.0,   0.0, -114.0,
-
-		 -82.0,   0.0, -225.0,
-		 -82.0, 165.0, -225.0,
-		-130.0, 165.0,  -65.0,
-		-130.0,   0.0,  -65.0,
-
-		-240.0,   0.0, -272.0,
-		-240.0, 165.0, -272.0,
-		 -82.0, 165.0, -225.0,
-		 -82.0,   0.0, -225.0
-	};
-
-	GLfloat smallBoxNormalBufferData[60] = {
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-
-		0.953, 0.0, 0.302,
-		0.953, 0.0, 0.302,
-		0.953, 0.0, 0.302,
-		0.953, 0.0, 0.302,
-
-		0.293, 0.0, -0.957,
-		0.293, 0.0, -0.957,
-		0.293, 0.0, -0.957,
-		0.293, 0.0, -0.957,
-
-		-0.958, 0.0, -0.287,
-		-0.958, 0.0, -0.287,
-		-0.958, 0.0, -0.287,
-		-0.958, 0.0, -0.287,
-
-		-0.285, 0.0, 0.958,
-		-0.285, 0.0, 0.958,
-		-0.285, 0.0, 0.958,
-		-0.285, 0.0, 0.958
-	};
-
-	GLfloat otherBoxColorBufferData[60] = {
-		// Floor
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Ceiling
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Left wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Right wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Back wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f
-	};
-
-
 	Skybox skybox;
 	skybox.initialize(cameraPosition, glm::vec3(1000, 1000, 1000));  // Scale x,y,z
 
@@ -1200,27 +977,43 @@ int main(void)
 	tallBox.initialize(tallBoxVertexBufferData, tallBoxNormalBufferData, otherBoxColorBufferData);
 	smallBox.initialize(smallBoxVertexBufferData, smallBoxNormalBufferData, otherBoxColorBufferData);
 
+	// Terrain and animation work is spread over a worker per core, this thread included
+	JobSystem jobs;
+	jobs.initialize(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+
 	// Setting up the ground
 	Heightmap ground;
 	ground.initialize();
 	//int iterationNum = 0;
-	for (int i = 0; i <= MAX_ITER; i++) {
-		ground.updateMap();
-	}
+	ground.generate(jobs, MAX_ITER + 1);
+
+	AnimationSystem animation;
+	animation.initialize(jobs);
 
 	Lampost lampost;
-	lampost.initialize();
+	lampost.initialize(animation);
 
 
 	// Camera setup
 	glm::mat4 viewMatrix, projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(FoV), (float)windowWidth / windowHeight, zNear, zFar);
 
+	// Per frame data (camera block, joint palettes, heightmap edits) all goes through here
+	StreamBuffer stream;
+	stream.initialize(256 * 1024, glfwGetProcAddress);
+
+	// Shared camera block, only the skybox shader reads it in this viewer
+	UniformBlocks uniformBlocks;
+	uniformBlocks.initialize();
+	FrameData frameData = FrameData();
+	ViewData view;
+
 	// -----------------------------------------------------------
 	// -----------------------------------------------------------
 
 	do
 	{
+		TRACE_ZONE("frame");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Getting timing for frames
@@ -1228,22 +1021,45 @@ int main(void)
 		deltaTime = currentTime - previousTime;
 		previousTime = currentTime;
 
+		stream.beginFrame();
+
+		// Sample animations while the rest of the scene is drawn
+		animation.beginUpdate(deltaTime);
+
 		// lookAt( where camera is, where its looking at relative to where it is, its up )
 		viewMatrix = glm::lookAt(cameraPosition, cameraPosition + cameraLookVector, cameraUp);
 		glm::mat4 vp = projectionMatrix * viewMatrix;
 
+		frameData.lightPosition = glm::vec4(lightPosition, 1.0f);
+		frameData.lightIntensity = glm::vec4(lightIntensity, 0.0f);
+		frameData.time = currentTime;
+		view.view = viewMatrix;
+		view.projection = projectionMatrix;
+		view.viewProjection = vp;
+		view.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+		uniformBlocks.update(stream, frameData, &view, 1);
+		uniformBlocks.bindView(0);
+
 
 		skybox.position = cameraPosition;
-		skybox.render(vp);
+		skybox.render();
 
 		tallBox.render(vp);
 		smallBox.render(vp);
 
 		ground.updatePosition(cameraPosition);
+		ground.upload(stream);
 		ground.render(vp);
 
+		animation.endUpdate(stream);
 		lampost.render(vp);
 
+		stream.endFrame();
+		if (saveTrace) {
+			traceWrite("trace.json");
+			saveTrace = false;
+		}
+
 		// Swap buffers
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -1260,6 +1076,12 @@ int main(void)
 	ground.cleanup();
 
 	lampost.cleanup();
+	animation.cleanup();
+	jobs.cleanup();
+	stream.cleanup();
+
+	// Anything still alive now was never cleaned up
+	glResources().shutdown();
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
@@ -1303,6 +1125,9 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		cameraPosition += glm::normalize(glm::cross(cameraLookVector, cameraUp)) * cameraSpeed;
 	}
 
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		saveTrace = true;
+
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
 }
@@ -12,11 +12,19 @@ out vec3 color;
 out vec2 uv;
 
 // Matrix for vertex transformation
-uniform mat4 MVP;
+uniform mat4 M;
+
+// Shared with every other program, uploaded once a frame (render/uniform_blocks.h)
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 void main() {
     // Transform vertex
-    gl_Position =  MVP * vec4(vertexPosition, 1);
+    gl_Position =  viewProjection * M * vec4(vertexPosition, 1);
     
     // Pass vertex color to the fragment shader
     color = vertexColor;
@@ -7,10 +7,16 @@ in vec4 LightSpacePos;
 
 out vec3 finalColor;
 
-uniform vec3 lightPosition;
-uniform vec3 lightIntensity;
 uniform sampler2D shadowMap;
-uniform float farPlane;
+
+// Shared with every other program, uploaded once a frame (render/uniform_blocks.h)
+layout(std140) uniform FrameData {
+    mat4 lightSpaceMatrix;
+    vec4 lightPosition;
+    vec4 lightIntensity;
+    float farPlane;
+    float time;
+};
 
 float ShadowCalculation() {
     vec3 projCoords = LightSpacePos.xyz / LightSpacePos.w;
@@ -23,9 +29,9 @@ float ShadowCalculation() {
 
     float closestDistance = texture(shadowMap, projCoords.xy).r * farPlane; 
 
-    float currentDistance = length(worldPosition - lightPosition);
+    float currentDistance = length(worldPosition - lightPosition.xyz);
 
-    float bias = max(0.05 * (1.0 - dot(worldNormal, normalize(lightPosition - worldPosition))), 0.005);
+    float bias = max(0.05 * (1.0 - dot(worldNormal, normalize(lightPosition.xyz - worldPosition))), 0.005);
     
     float shadow = currentDistance - bias > closestDistance ? 1.0 : 0.0;
 
@@ -40,12 +46,12 @@ void main()
     vec3 ambient = 0.1 * color;
 
     vec3 N = normalize(worldNormal);
-	vec3 L = lightPosition - worldPosition; // this is the normalized vector of light to vertex
-    float r = distance(worldPosition, lightPosition);
+	vec3 L = lightPosition.xyz - worldPosition; // this is the normalized vector of light to vertex
+    float r = distance(worldPosition, lightPosition.xyz);
 
 	float dotProduct = max(dot(N, L), 0.0);   // world Normal is N;    We also have to max so values dont become negative
 
-	vec3 reflectedRadiance = ( (0.78 / 3.14) * (dotProduct) * (lightIntensity / (4 * 3.14 * pow(r, 2))) );
+	vec3 reflectedRadiance = ( (0.78 / 3.14) * (dotProduct) * (lightIntensity.xyz / (4 * 3.14 * pow(r, 2))) );
 
 
     vec3 shadowedRadiance = reflectedRadiance * (1.0 - shadowFactor);
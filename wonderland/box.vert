@@ -3,7 +3,7 @@
 // Input
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexColor;
-layout(location = 2) in vec3 vertexNormal;
+layout(location = 2) in vec2 vertexNormal;	// octahedral encoded
 
 // Output data, to be interpolated for each fragment
 out vec3 color;
@@ -11,22 +11,46 @@ out vec3 worldPosition;
 out vec3 worldNormal;
 out vec4 LightSpacePos;
 
-uniform mat4 MVP;
 uniform mat4 M;
-uniform mat4 lightSpaceMatrix;
+uniform mat4 N;		// inverse transpose of the model matrix, without the dequantize
+
+// Shared with every other program, uploaded once a frame (render/uniform_blocks.h)
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+layout(std140) uniform FrameData {
+    mat4 lightSpaceMatrix;
+    vec4 lightPosition;
+    vec4 lightIntensity;
+    float farPlane;
+    float time;
+};
+
+// Unfolds an octahedral normal back onto the unit sphere
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
+    // World-space geometry 
+    vec4 worldPos_4 = M * vec4(vertexPosition, 1.0);
+
     // Transform vertex
-    gl_Position =  MVP * vec4(vertexPosition, 1);
+    gl_Position =  viewProjection * worldPos_4;
 
-    
     // Pass vertex color to the fragment shader
     color = vertexColor;
 
-    // World-space geometry 
-    vec4 worldPos_4 = M * vec4(vertexPosition, 1.0);
     worldPosition = worldPos_4.xyz;
-    worldNormal = vertexNormal;
+    worldNormal = normalize(mat3(N) * octDecode(vertexNormal));
 
     LightSpacePos = lightSpaceMatrix * worldPos_4;
 }
\ No newline at end of file
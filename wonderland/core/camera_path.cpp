@@ -0,0 +1,113 @@
+#include "camera_path.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+
+CameraPath::CameraPath()
+{
+	timestep = 1.0f / 60.0f;
+}
+
+void CameraPath::record(const glm::vec3& position, float yaw, float pitch)
+{
+	CameraKey key;
+	key.position[0] = position.x;
+	key.position[1] = position.y;
+	key.position[2] = position.z;
+	key.yaw = yaw;
+	key.pitch = pitch;
+	keys.push_back(key);
+}
+
+bool CameraPath::save(const std::string& path) const
+{
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Couldn't open " << path << " to save the camera path" << std::endl;
+		return false;
+	}
+
+	CameraPathHeader header;
+	header.magic = CAMERA_PATH_MAGIC;
+	header.version = CAMERA_PATH_VERSION;
+	header.frameCount = (uint32_t)keys.size();
+	header.timestep = timestep;
+	file.write((const char*)&header, sizeof(header));
+	if (!keys.empty())
+		file.write((const char*)keys.data(), keys.size() * sizeof(CameraKey));
+	if (!file)
+	{
+		std::cout << "Failed writing camera path " << path << std::endl;
+		return false;
+	}
+
+	std::cout << "Camera path with " << keys.size() << " frames saved to " << path << std::endl;
+	return true;
+}
+
+bool CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Couldn't open camera path " << path << std::endl;
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t)file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	CameraPathHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != CAMERA_PATH_MAGIC)
+	{
+		std::cout << path << " isn't a camera path" << std::endl;
+		return false;
+	}
+	if (header.version != CAMERA_PATH_VERSION)
+	{
+		std::cout << path << " is camera path version " << header.version << ", expected " << CAMERA_PATH_VERSION << std::endl;
+		return false;
+	}
+	if (header.frameCount == 0 || !(header.timestep > 0.0f))
+	{
+		std::cout << path << " has no frames to replay" << std::endl;
+		return false;
+	}
+
+	// Check the count against whats left before sizing anything by it, a bad header
+	// shouldnt get to ask for gigabytes
+	if (header.frameCount > (fileSize - sizeof(header)) / sizeof(CameraKey))
+	{
+		std::cout << path << " is cut short, expected " << header.frameCount << " frames" << std::endl;
+		return false;
+	}
+
+	keys.resize(header.frameCount);
+	if (!file.read((char*)keys.data(), keys.size() * sizeof(CameraKey)))
+	{
+		std::cout << path << " is cut short, expected " << header.frameCount << " frames" << std::endl;
+		keys.clear();
+		return false;
+	}
+	timestep = header.timestep;
+	return true;
+}
+
+const CameraKey& CameraPath::key(size_t frame) const
+{
+	return keys[frame < keys.size() ? frame : keys.size() - 1];
+}
+
+glm::vec3 lookVectorFromAngles(float yaw, float pitch)
+{
+	glm::vec3 look(
+		cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
+		sin(glm::radians(pitch)),
+		sin(glm::radians(yaw)) * cos(glm::radians(pitch))
+	);
+	return glm::normalize(look);
+}
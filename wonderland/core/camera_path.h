@@ -0,0 +1,52 @@
+#ifndef _CAMERA_PATH_H_
+#define _CAMERA_PATH_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+// Recorded camera, one key per frame:
+//
+//   CameraPathHeader
+//   CameraKey[frameCount]
+//
+// Replaying steps one key per frame with the stored timestep as the frame time, so
+// every run draws exactly the same views however fast the machine is.
+
+#define CAMERA_PATH_MAGIC (0x4d414357u)	// "WCAM"
+#define CAMERA_PATH_VERSION (1)
+
+struct CameraPathHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frameCount;
+	float timestep;		// seconds per frame on replay
+};
+
+// 20 bytes
+struct CameraKey {
+	float position[3];
+	float yaw;			// degrees, same as the mouse controls
+	float pitch;
+};
+
+struct CameraPath {
+	float timestep;
+	std::vector<CameraKey> keys;
+
+	CameraPath();
+
+	void record(const glm::vec3& position, float yaw, float pitch);
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// Past the end gives the last key, so a path can be held on its final view
+	const CameraKey& key(size_t frame) const;
+};
+
+// Which way a camera with this yaw and pitch is looking
+glm::vec3 lookVectorFromAngles(float yaw, float pitch);
+
+#endif
@@ -0,0 +1,192 @@
+#include "job_system.h"
+#include "trace.h"
+
+#include <cstring>
+#include <cstdio>
+#include <cassert>
+#include <new>
+#include <stdint.h>
+
+// Set once by each worker, the thread that calls initialize stays 0
+static thread_local int jobThreadIndex = 0;
+
+void JobQueue::push(Job* job)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.push_back(job);
+}
+
+Job* JobQueue::pop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (jobs.empty())
+		return NULL;
+	Job* job = jobs.back();
+	jobs.pop_back();
+	return job;
+}
+
+Job* JobQueue::steal()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (jobs.empty())
+		return NULL;
+	Job* job = jobs.front();
+	jobs.pop_front();
+	return job;
+}
+
+
+JobSystem::JobSystem()
+{
+	threadCount = 0;
+	queues = NULL;
+	pool = NULL;
+	poolMemory = NULL;
+	poolNext = NULL;
+	queued = 0;
+	sleeping = 0;
+	quit = false;
+}
+
+void JobSystem::initialize(int numWorkers)
+{
+	threadCount = numWorkers + 1;
+	queues = new JobQueue[threadCount];
+	size_t poolSize = (size_t)threadCount * JOB_POOL_SIZE;
+	poolMemory = new unsigned char[poolSize * sizeof(Job) + alignof(Job) - 1];
+	pool = (Job*)(((uintptr_t)poolMemory + alignof(Job) - 1) & ~(uintptr_t)(alignof(Job) - 1));
+	for (size_t i = 0; i < poolSize; ++i)
+		new (&pool[i]) Job();
+	poolNext = new unsigned int[threadCount];
+	memset(poolNext, 0, threadCount * sizeof(unsigned int));
+	queued = 0;
+	sleeping = 0;
+	quit = false;
+
+	jobThreadIndex = 0;
+	TRACE_THREAD("main");
+	for (int i = 1; i < threadCount; ++i)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+int JobSystem::threadIndex()
+{
+	return jobThreadIndex;
+}
+
+Job* JobSystem::create(JobFunction function, Job* parent, const void* data, size_t size)
+{
+	int index = jobThreadIndex;
+	Job* job = &pool[index * JOB_POOL_SIZE + (poolNext[index]++ & (JOB_POOL_SIZE - 1))];
+
+	job->function = function;
+	job->parent = parent;
+	job->unfinished = 1;
+	assert(size <= JOB_DATA_SIZE && "job data doesnt fit, pass a pointer to it instead");
+	if (size > 0)
+		memcpy(job->data, data, size);
+
+	if (parent)
+		parent->unfinished++;
+	return job;
+}
+
+void JobSystem::run(Job* job)
+{
+	queues[jobThreadIndex].push(job);
+	queued++;
+
+	// Only bother with the lock if someone might be asleep. A worker counts itself
+	// as sleeping before it checks queued, so it cant miss this.
+	if (sleeping > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+Job* JobSystem::next()
+{
+	int index = jobThreadIndex;
+	Job* job = queues[index].pop();
+
+	// Nothing of our own, try everyone else starting with the next thread along
+	for (int i = 1; job == NULL && i < threadCount; ++i)
+		job = queues[(index + i) % threadCount].steal();
+
+	if (job)
+		queued--;
+	return job;
+}
+
+void JobSystem::finish(Job* job)
+{
+	// Last one out finishes the parent too. Parent is read first, once unfinished
+	// hits 0 whoever is waiting can move on.
+	Job* parent = job->parent;
+	if (--job->unfinished == 0 && parent)
+		finish(parent);
+}
+
+void JobSystem::execute(Job* job)
+{
+	job->function(job, job->data);
+	finish(job);
+}
+
+void JobSystem::wait(const Job* job)
+{
+	while (job->unfinished > 0)
+	{
+		Job* other = next();
+		if (other)
+			execute(other);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop(int index)
+{
+	jobThreadIndex = index;
+	char name[32];
+	snprintf(name, sizeof(name), "worker %d", index);
+	TRACE_THREAD(name);
+
+	while (!quit)
+	{
+		Job* job = next();
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping++;
+		wake.wait(lock, [this] { return quit || queued > 0; });
+		sleeping--;
+	}
+}
+
+void JobSystem::cleanup()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+		wake.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	workers.clear();
+
+	delete[] queues;
+	delete[] poolMemory;	// Jobs have nothing to destroy
+	delete[] poolNext;
+	queues = NULL;
+	pool = NULL;
+	poolMemory = NULL;
+	poolNext = NULL;
+	threadCount = 0;
+}
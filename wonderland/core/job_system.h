@@ -0,0 +1,151 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+// Bytes of arguments a job can carry, sized so a Job is one cache line. Anything
+// bigger has to be passed by pointer.
+#define JOB_DATA_SIZE (40)
+
+// Jobs each thread can create before its pool wraps round and starts reusing
+// them. Everything created more than this many jobs ago has to be finished.
+#define JOB_POOL_SIZE (4096)
+
+struct Job;
+typedef void (*JobFunction)(Job* job, const void* data);
+
+// Aligned so neighbouring jobs in a pool never share a line, other threads hammer
+// on unfinished while their children finish
+struct alignas(64) Job {
+	JobFunction function;
+	Job* parent;
+	std::atomic<int> unfinished;	// itself plus any children still running
+	unsigned char data[JOB_DATA_SIZE];
+};
+static_assert(sizeof(Job) == 64, "Job should be exactly one cache line");
+
+// One per thread. The owner pushes and pops at the back, so it works on what it
+// just made while that is still in cache, and other threads steal from the front.
+// A plain mutex is plenty, jobs are big enough that the lock never shows up.
+struct JobQueue {
+	std::mutex mutex;
+	std::deque<Job*> jobs;
+
+	void push(Job* job);
+	Job* pop();
+	Job* steal();
+};
+
+// Work stealing job system. Thread 0 is whoever called initialize (the render
+// thread), the rest are workers. Jobs can be made children of another job, and
+// waiting on the parent waits for all of them. A thread that waits keeps running
+// jobs until the one it is waiting on is done, so nothing sits idle.
+//
+// Only the thread that called initialize, or code running inside a job, may
+// create, run or wait on jobs.
+struct JobSystem {
+	int threadCount;
+	std::vector<std::thread> workers;
+	JobQueue* queues;
+	Job* pool;				// JOB_POOL_SIZE per thread
+	unsigned char* poolMemory;	// what pool was carved out of, new doesnt align to 64 before C++17
+	unsigned int* poolNext;	// next free job in each thread's pool
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued;	// roughly how many jobs are waiting in the queues
+	std::atomic<int> sleeping;
+	std::atomic<bool> quit;
+
+	JobSystem();
+
+	void initialize(int numWorkers);
+
+	// data is copied into the job. Adding a child after its parent has finished is a bug.
+	Job* create(JobFunction function, Job* parent = NULL, const void* data = NULL, size_t size = 0);
+	void run(Job* job);
+	void wait(const Job* job);
+
+	void cleanup();
+
+	// Which thread this is, 0 to threadCount - 1
+	static int threadIndex();
+
+private:
+	Job* next();
+	void execute(Job* job);
+	void finish(Job* job);
+	void workerLoop(int index);
+};
+
+
+template <typename Function>
+struct ParallelFor {
+	JobSystem* jobs;
+	Function function;
+	int count;
+	int batchSize;
+};
+
+template <typename Function>
+struct ParallelForBatch {
+	const Function* function;
+	int begin;
+	int end;
+};
+
+template <typename Function>
+void parallelForBatch(Job*, const void* data)
+{
+	const ParallelForBatch<Function>* batch = (const ParallelForBatch<Function>*)data;
+	(*batch->function)(batch->begin, batch->end);
+}
+
+// The root job splits the range up, so kicking off a big loop costs the caller one job.
+// The batches read the function out of the root, which outlives them as their parent.
+template <typename Function>
+void parallelForRoot(Job* job, const void* data)
+{
+	const ParallelFor<Function>* loop = (const ParallelFor<Function>*)data;
+	for (int begin = 0; begin < loop->count; begin += loop->batchSize)
+	{
+		ParallelForBatch<Function> batch;
+		batch.function = &loop->function;
+		batch.begin = begin;
+		batch.end = begin + loop->batchSize < loop->count ? begin + loop->batchSize : loop->count;
+		loop->jobs->run(loop->jobs->create(&parallelForBatch<Function>, job, &batch, sizeof(batch)));
+	}
+}
+
+// Calls function(begin, end) on batches of [0, count) across every thread and returns
+// straight away. Wait on the returned job before touching the results. The function
+// gets copied into the job, so it has to be small and trivially copyable (a lambda
+// capturing a few pointers is fine). Every batch is a job, so count / batchSize has
+// to stay well under JOB_POOL_SIZE.
+template <typename Function>
+Job* parallelForAsync(JobSystem& jobs, int count, int batchSize, const Function& function)
+{
+	static_assert(sizeof(ParallelFor<Function>) <= JOB_DATA_SIZE, "parallelFor function is too big to fit in a job");
+	static_assert(std::is_trivially_copyable<Function>::value, "parallelFor function has to be trivially copyable");
+
+	ParallelFor<Function> loop = { &jobs, function, count, batchSize > 0 ? batchSize : 1 };
+	Job* root = jobs.create(&parallelForRoot<Function>, NULL, &loop, sizeof(loop));
+	jobs.run(root);
+	return root;
+}
+
+// Same as parallelForAsync, but only returns once every batch is done
+template <typename Function>
+void parallelFor(JobSystem& jobs, int count, int batchSize, const Function& function)
+{
+	jobs.wait(parallelForAsync(jobs, count, batchSize, function));
+}
+
+#endif
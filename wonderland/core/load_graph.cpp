@@ -0,0 +1,210 @@
+#include "load_graph.h"
+#include "trace.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+struct LoadTaskJob {
+	LoadGraph* graph;
+	int task;
+};
+
+LoadGraph::LoadGraph()
+{
+	jobs = NULL;
+	finished = 0;
+	totalTime = 0.0;
+}
+
+int LoadGraph::add(const std::string& name, LoadThread thread, const std::function<bool()>& function)
+{
+	LoadTask task;
+	task.name = name;
+	task.thread = thread;
+	task.function = function;
+	task.remaining = 0;
+	task.succeeded = false;
+	task.skipped = false;
+	task.threadIndex = -1;
+	task.start = 0.0;
+	task.end = 0.0;
+	tasks.push_back(task);
+	return (int)tasks.size() - 1;
+}
+
+void LoadGraph::depends(int task, int dependency)
+{
+	tasks[task].dependencies.push_back(dependency);
+	tasks[dependency].dependents.push_back(task);
+}
+
+double LoadGraph::now() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void LoadGraph::taskJob(Job*, const void* data)
+{
+	const LoadTaskJob* taskJob = (const LoadTaskJob*)data;
+	taskJob->graph->execute(taskJob->task);
+}
+
+void LoadGraph::dispatch(int task)
+{
+	if (tasks[task].thread == LOAD_MAIN)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		mainReady.push_back(task);
+		mainWake.notify_one();
+		return;
+	}
+
+	LoadTaskJob taskJob = { this, task };
+	jobs->run(jobs->create(&LoadGraph::taskJob, NULL, &taskJob, sizeof(taskJob)));
+}
+
+void LoadGraph::execute(int index)
+{
+	LoadTask& task = tasks[index];
+	// Points into the graph, traces have to be written while it's still around
+	TRACE_ZONE(task.name.c_str());
+	task.threadIndex = JobSystem::threadIndex();
+
+	// Dependencies have all finished by now, so nothing else writes to them
+	int failedDependency = -1;
+	for (size_t i = 0; i < task.dependencies.size() && failedDependency < 0; ++i)
+		if (!tasks[task.dependencies[i]].succeeded)
+			failedDependency = task.dependencies[i];
+
+	task.start = now();
+	task.skipped = failedDependency >= 0;
+	task.succeeded = !task.skipped && task.function();
+	task.end = now();
+	if (task.skipped)
+		std::cout << "Load task " << task.name << " skipped, " << tasks[failedDependency].name << " failed" << std::endl;
+	else if (!task.succeeded)
+		std::cout << "Load task " << task.name << " failed" << std::endl;
+
+	std::vector<int> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < task.dependents.size(); ++i)
+			if (--tasks[task.dependents[i]].remaining == 0)
+				ready.push_back(task.dependents[i]);
+
+		if (++finished == tasks.size())
+			mainWake.notify_one();
+	}
+
+	for (size_t i = 0; i < ready.size(); ++i)
+		dispatch(ready[i]);
+}
+
+bool LoadGraph::run(JobSystem& jobs)
+{
+	TRACE_ZONE("load graph");
+	this->jobs = &jobs;
+	finished = 0;
+	mainReady.clear();
+	origin = std::chrono::steady_clock::now();
+
+	// Roots are picked out before any of them start, once they do the counts change under us
+	std::vector<int> roots;
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		tasks[i].remaining = (int)tasks[i].dependencies.size();
+		if (tasks[i].remaining == 0)
+			roots.push_back((int)i);
+	}
+	for (size_t i = 0; i < roots.size(); ++i)
+		dispatch(roots[i]);
+
+	// This thread only does the main thread tasks, and sleeps in between
+	std::unique_lock<std::mutex> lock(mutex);
+	while (finished < tasks.size())
+	{
+		if (mainReady.empty())
+		{
+			mainWake.wait(lock);
+			continue;
+		}
+
+		int task = mainReady.front();
+		mainReady.pop_front();
+		lock.unlock();
+		execute(task);
+		lock.lock();
+	}
+	totalTime = now();
+
+	bool succeeded = true;
+	for (size_t i = 0; i < tasks.size(); ++i)
+		succeeded = succeeded && tasks[i].succeeded;
+	return succeeded;
+}
+
+void LoadGraph::printReport() const
+{
+	double work = 0.0;
+	for (size_t i = 0; i < tasks.size(); ++i)
+		work += tasks[i].end - tasks[i].start;
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Startup took " << totalTime << " ms, " << work << " ms of work across " << tasks.size() << " tasks" << std::endl;
+
+	std::vector<int> order(tasks.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = (int)i;
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return tasks[a].start < tasks[b].start; });
+
+	std::cout << "  " << std::left << std::setw(32) << "task" << std::setw(10) << "thread" << std::right
+		<< std::setw(10) << "start" << std::setw(10) << "ms" << std::endl;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const LoadTask& task = tasks[order[i]];
+		std::ostringstream thread;
+		if (task.threadIndex == 0)
+			thread << "main";
+		else
+			thread << "worker " << task.threadIndex;
+		std::cout << "  " << std::left << std::setw(32) << task.name << std::setw(10) << thread.str() << std::right
+			<< std::setw(10) << task.start << std::setw(10) << task.end - task.start
+			<< (task.succeeded ? "" : task.skipped ? "  SKIPPED" : "  FAILED") << std::endl;
+	}
+
+	// Longest chain of task times. Dependencies always end before their dependents
+	// start, so going in order of end time sees them first.
+	std::vector<int> byEnd(order);
+	std::vector<double> chain(tasks.size(), 0.0);
+	std::vector<int> previous(tasks.size(), -1);
+	std::sort(byEnd.begin(), byEnd.end(), [this](int a, int b) { return tasks[a].end < tasks[b].end; });
+	int last = -1;
+	for (size_t i = 0; i < byEnd.size(); ++i)
+	{
+		int t = byEnd[i];
+		for (size_t d = 0; d < tasks[t].dependencies.size(); ++d)
+		{
+			int dependency = tasks[t].dependencies[d];
+			if (chain[dependency] > chain[t])
+			{
+				chain[t] = chain[dependency];
+				previous[t] = dependency;
+			}
+		}
+		chain[t] += tasks[t].end - tasks[t].start;
+		if (last < 0 || chain[t] > chain[last])
+			last = t;
+	}
+
+	if (last >= 0)
+	{
+		std::string path;
+		for (int t = last; t >= 0; t = previous[t])
+			path = tasks[t].name + (path.empty() ? "" : " -> ") + path;
+		std::cout << "Longest chain " << chain[last] << " ms: " << path << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+}
@@ -0,0 +1,73 @@
+#ifndef _LOAD_GRAPH_H_
+#define _LOAD_GRAPH_H_
+
+#include <core/job_system.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Where a load task has to run. Anything that touches GL goes on the main thread,
+// file reads and decoding go to the job system's workers.
+enum LoadThread { LOAD_WORKER = 0, LOAD_MAIN = 1 };
+
+struct LoadTask {
+	std::string name;
+	int thread;
+	std::function<bool()> function;
+
+	std::vector<int> dependencies;
+	std::vector<int> dependents;
+	int remaining;		// dependencies not finished yet
+
+	bool succeeded;
+	bool skipped;		// never ran, something it depends on failed
+	int threadIndex;	// job system thread it ran on
+	double start;		// milliseconds since the graph started running
+	double end;
+};
+
+// Startup work as a dependency graph. Tasks start as soon as everything they
+// depend on has finished, worker tasks as jobs and main thread tasks on whichever
+// thread called run, so the whole thing takes about as long as the slowest chain
+// rather than the sum of everything.
+//
+// When a task fails, everything depending on it is skipped and counts as failed
+// too, the rest of the graph still runs.
+struct LoadGraph {
+	std::vector<LoadTask> tasks;
+	JobSystem* jobs;
+
+	std::mutex mutex;
+	std::condition_variable mainWake;
+	std::deque<int> mainReady;
+	size_t finished;
+
+	std::chrono::steady_clock::time_point origin;
+	double totalTime;
+
+	LoadGraph();
+
+	int add(const std::string& name, LoadThread thread, const std::function<bool()>& function);
+	// task wont start until dependency has finished
+	void depends(int task, int dependency);
+
+	// Runs every task and returns once they have all finished. Has to be called from
+	// the thread that owns the GL context. False if any of them failed.
+	bool run(JobSystem& jobs);
+
+	// Every task's timings, plus the longest chain through the graph
+	void printReport() const;
+
+private:
+	void dispatch(int task);
+	void execute(int task);
+	double now() const;
+	static void taskJob(Job* job, const void* data);
+};
+
+#endif
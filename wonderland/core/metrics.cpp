@@ -0,0 +1,269 @@
+#include "metrics.h"
+#include "process_memory.h"
+#include "trace.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET MetricsSocket;
+#define closeSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int MetricsSocket;
+#define INVALID_SOCKET (-1)
+#define closeSocket close
+#endif
+
+// A scraper that hangs up early shouldn't take the process down with SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL (0)
+#endif
+
+static const double frameBuckets[METRICS_FRAME_BUCKETS] = {
+	0.004, 0.008, 0.0125, 0.0167, 0.02, 0.025, 0.0333, 0.05, 0.1, 0.25
+};
+
+struct GaugeInfo {
+	const char* name;
+	const char* help;
+};
+
+// Same order as MetricGauge
+static const GaugeInfo gaugeInfo[METRIC_GAUGE_COUNT] = {
+	{ "wonderland_gpu_buffer_bytes", "Bytes of GL buffers alive, as tracked by their handles" },
+	{ "wonderland_gpu_texture_bytes", "Estimated bytes of GL textures and renderbuffers alive, all mip levels" },
+	{ "wonderland_scene_meshes", "Meshes in the loaded scene" },
+	{ "wonderland_scene_nodes", "Placed meshes in the loaded scene" },
+	{ "wonderland_scene_textures", "Textures in the loaded scene" },
+	{ "wonderland_scene_vertices", "Vertices in the loaded scene" },
+	{ "wonderland_scene_triangles", "Triangles in the loaded scene" },
+	{ "wonderland_load_tasks_failed", "Startup load tasks that failed" },
+	{ "wonderland_frame_draws", "Draw calls in the last frame" },
+	{ "wonderland_frame_triangles", "Triangles drawn in the last frame" },
+	{ "wonderland_frame_visible_objects", "Objects left after culling in the last frame" },
+};
+
+static int64_t nowNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameHistogram::FrameHistogram()
+{
+	for (int i = 0; i <= METRICS_FRAME_BUCKETS; ++i)
+		buckets[i].store(0);
+	sumNanoseconds.store(0);
+}
+
+void FrameHistogram::record(float ms)
+{
+	double seconds = ms / 1000.0;
+	int bucket = 0;
+	while (bucket < METRICS_FRAME_BUCKETS && seconds > frameBuckets[bucket])
+		++bucket;
+	buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	sumNanoseconds.fetch_add((uint64_t)(ms * 1000000.0), std::memory_order_relaxed);
+}
+
+void FrameHistogram::write(std::string& out, const char* name, const char* help) const
+{
+	std::ostringstream text;
+	text.precision(12);		// the sum goes up to hours of frames
+	text << "# HELP " << name << " " << help << "\n";
+	text << "# TYPE " << name << " histogram\n";
+	uint64_t cumulative = 0;
+	for (int i = 0; i <= METRICS_FRAME_BUCKETS; ++i)
+	{
+		cumulative += buckets[i].load(std::memory_order_relaxed);
+		text << name << "_bucket{le=\"";
+		if (i < METRICS_FRAME_BUCKETS)
+			text << frameBuckets[i];
+		else
+			text << "+Inf";
+		text << "\"} " << cumulative << "\n";
+	}
+	text << name << "_sum " << sumNanoseconds.load(std::memory_order_relaxed) / 1e9 << "\n";
+	text << name << "_count " << cumulative << "\n";
+	out += text.str();
+}
+
+MetricsExporter::MetricsExporter()
+{
+	for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+		gauges[i].store(0);
+	scrapes.store(0);
+	quit.store(false);
+	jobs = NULL;
+	startTime = nowNanoseconds();
+	listenSocket = (intptr_t)INVALID_SOCKET;
+}
+
+bool MetricsExporter::start(int port, const JobSystem* jobs)
+{
+	this->jobs = jobs;
+	startTime = nowNanoseconds();
+
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+	{
+		std::cout << "Couldn't start Winsock for the metrics exporter" << std::endl;
+		return false;
+	}
+#endif
+
+	MetricsSocket listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET)
+	{
+		std::cout << "Couldn't make a socket for the metrics exporter" << std::endl;
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	// Loopback only, nothing off this machine can scrape it
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons((unsigned short)port);
+	if (bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+	{
+		std::cout << "Couldn't listen on 127.0.0.1:" << port << " for metrics" << std::endl;
+		closeSocket(listener);
+		return false;
+	}
+
+	listenSocket = (intptr_t)listener;
+	quit.store(false);
+	thread = std::thread(&MetricsExporter::serve, this);
+	std::cout << "Serving metrics on http://127.0.0.1:" << port << "/metrics" << std::endl;
+	return true;
+}
+
+void MetricsExporter::recordFrame(float cpuMs, float gpuMs)
+{
+	cpuFrames.record(cpuMs);
+	// The GPU profiler gives 0 until its first results come back
+	if (gpuMs > 0.0f)
+		gpuFrames.record(gpuMs);
+}
+
+void MetricsExporter::set(MetricGauge gauge, int64_t value)
+{
+	gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+std::string MetricsExporter::write() const
+{
+	std::string out;
+	cpuFrames.write(out, "wonderland_frame_seconds", "CPU time per frame on the render thread");
+	gpuFrames.write(out, "wonderland_gpu_frame_seconds", "GPU time per frame, from timestamp queries");
+
+	std::ostringstream text;
+	text.precision(12);
+	for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+	{
+		text << "# HELP " << gaugeInfo[i].name << " " << gaugeInfo[i].help << "\n";
+		text << "# TYPE " << gaugeInfo[i].name << " gauge\n";
+		text << gaugeInfo[i].name << " " << gauges[i].load(std::memory_order_relaxed) << "\n";
+	}
+
+	// Sampled now rather than by the app, so none of it costs the render thread anything
+	text << "# HELP wonderland_process_resident_bytes Memory of the process currently resident\n";
+	text << "# TYPE wonderland_process_resident_bytes gauge\n";
+	text << "wonderland_process_resident_bytes " << processResidentBytes() << "\n";
+	if (jobs)
+	{
+		text << "# HELP wonderland_job_queue_depth Jobs waiting in the job system's queues\n";
+		text << "# TYPE wonderland_job_queue_depth gauge\n";
+		text << "wonderland_job_queue_depth " << jobs->queued.load(std::memory_order_relaxed) << "\n";
+		text << "# HELP wonderland_job_threads_idle Job system threads asleep waiting for work\n";
+		text << "# TYPE wonderland_job_threads_idle gauge\n";
+		text << "wonderland_job_threads_idle " << jobs->sleeping.load(std::memory_order_relaxed) << "\n";
+	}
+	text << "# HELP wonderland_uptime_seconds Time since the exporter started\n";
+	text << "# TYPE wonderland_uptime_seconds gauge\n";
+	text << "wonderland_uptime_seconds " << (nowNanoseconds() - startTime) / 1e9 << "\n";
+	text << "# HELP wonderland_metrics_scrapes_total Times this page has been served\n";
+	text << "# TYPE wonderland_metrics_scrapes_total counter\n";
+	text << "wonderland_metrics_scrapes_total " << scrapes.load(std::memory_order_relaxed) << "\n";
+	out += text.str();
+	return out;
+}
+
+// Waits up to timeoutMs for the socket to have something to read
+static bool readable(MetricsSocket s, int timeoutMs)
+{
+	fd_set set;
+	FD_ZERO(&set);
+	FD_SET(s, &set);
+	timeval timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+	return select((int)s + 1, &set, NULL, NULL, &timeout) > 0;
+}
+
+// One connection at a time, it only ever gets the odd scrape. Wakes up a few times a
+// second to see if it should stop.
+void MetricsExporter::serve()
+{
+	TRACE_THREAD("metrics");
+	MetricsSocket listener = (MetricsSocket)listenSocket;
+	while (!quit.load())
+	{
+		if (!readable(listener, 200))
+			continue;
+		MetricsSocket client = accept(listener, NULL, NULL);
+		if (client == INVALID_SOCKET)
+			continue;
+
+		// Only the request line matters, anything that isnt a GET is turned away
+		char request[1024];
+		int received = readable(client, 1000) ? (int)recv(client, request, sizeof(request) - 1, 0) : 0;
+		std::string response;
+		if (received > 0 && strncmp(request, "GET ", 4) == 0)
+		{
+			scrapes.fetch_add(1, std::memory_order_relaxed);
+			std::string body = write();
+			char header[160];
+			snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+				"Content-Length: %u\r\nConnection: close\r\n\r\n", (unsigned)body.size());
+			response = header + body;
+		}
+		else
+			response = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+		size_t sent = 0;
+		while (sent < response.size())
+		{
+			int n = (int)send(client, response.data() + sent, (int)(response.size() - sent), MSG_NOSIGNAL);
+			if (n <= 0)
+				break;
+			sent += n;
+		}
+		closeSocket(client);
+	}
+}
+
+void MetricsExporter::stop()
+{
+	if ((MetricsSocket)listenSocket == INVALID_SOCKET)
+		return;
+	quit.store(true);
+	thread.join();
+	closeSocket((MetricsSocket)listenSocket);
+	listenSocket = (intptr_t)INVALID_SOCKET;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
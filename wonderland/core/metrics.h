@@ -0,0 +1,79 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <core/job_system.h>
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <stdint.h>
+
+// Frame time histogram buckets, the upper bound of each in seconds. Slower frames
+// only show up in the +Inf bucket.
+#define METRICS_FRAME_BUCKETS (10)
+
+// Values the app sets whenever they change, some once at startup, some every frame
+enum MetricGauge {
+	METRIC_GPU_BUFFER_BYTES = 0,
+	METRIC_GPU_TEXTURE_BYTES,
+	METRIC_MESHES,
+	METRIC_NODES,
+	METRIC_TEXTURES,
+	METRIC_VERTICES,
+	METRIC_TRIANGLES_LOADED,
+	METRIC_LOAD_TASKS_FAILED,
+	METRIC_DRAWS,
+	METRIC_TRIANGLES_DRAWN,
+	METRIC_VISIBLE_OBJECTS,
+	METRIC_GAUGE_COUNT
+};
+
+// Only ever added to by one thread, read by the exporter while that happens. Buckets
+// are kept per bucket and summed up when written, so a scrape can't see a count
+// that doesn't match them.
+struct FrameHistogram {
+	std::atomic<uint64_t> buckets[METRICS_FRAME_BUCKETS + 1];	// the last is +Inf
+	std::atomic<uint64_t> sumNanoseconds;
+
+	FrameHistogram();
+	void record(float ms);
+	void write(std::string& out, const char* name, const char* help) const;
+};
+
+// Serves the viewer's health in the Prometheus text format on 127.0.0.1, for watching
+// a soak test from outside. Everything is read and formatted on the exporter's own
+// thread when it is scraped, the render thread only bumps a few atomics a frame.
+// Sampling things like resident memory and the job queues happens at scrape time too.
+struct MetricsExporter {
+	FrameHistogram cpuFrames;
+	FrameHistogram gpuFrames;
+	std::atomic<int64_t> gauges[METRIC_GAUGE_COUNT];
+	std::atomic<uint64_t> scrapes;
+
+	const JobSystem* jobs;	// queue depth is read from here, can be NULL
+	int64_t startTime;		// nanoseconds, for the uptime
+
+	std::thread thread;
+	std::atomic<bool> quit;
+	intptr_t listenSocket;	// SOCKET on Windows, a file descriptor elsewhere
+
+	MetricsExporter();
+
+	// Starts listening on the port, any path serves the metrics. False if the port
+	// couldnt be bound, in which case nothing else needs doing.
+	bool start(int port, const JobSystem* jobs);
+
+	// Once a frame from the render thread
+	void recordFrame(float cpuMs, float gpuMs);
+	void set(MetricGauge gauge, int64_t value);
+
+	// The whole page, as served
+	std::string write() const;
+
+	void stop();
+
+private:
+	void serve();
+};
+
+#endif
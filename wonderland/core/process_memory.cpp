@@ -0,0 +1,32 @@
+#include "process_memory.h"
+
+#if defined(_WIN32)
+// Version 2 is the one in kernel32, so there's no psapi.lib to link
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+size_t processResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#elif defined(__linux__)
+	// Second field is resident pages
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL)
+		return 0;
+	unsigned long size = 0, resident = 0;
+	int read = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	return read == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
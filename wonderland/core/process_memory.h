@@ -0,0 +1,10 @@
+#ifndef _PROCESS_MEMORY_H_
+#define _PROCESS_MEMORY_H_
+
+#include <cstddef>
+
+// Bytes of this process currently in physical memory (working set on Windows,
+// RSS elsewhere). 0 where there's no way of asking.
+size_t processResidentBytes();
+
+#endif
@@ -0,0 +1,135 @@
+#include "trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+static const std::chrono::steady_clock::time_point traceOrigin = std::chrono::steady_clock::now();
+
+// Buffers are made the first time a thread records anything and never freed, so
+// zones from threads that have finished still make it into the trace
+static std::atomic<TraceBuffer*> traceBuffers[TRACE_MAX_THREADS];
+static std::atomic<int> traceBufferCount(0);
+static thread_local TraceBuffer* threadBuffer = NULL;
+static thread_local bool threadUntraced = false;
+
+static TraceBuffer* currentBuffer()
+{
+	if (threadBuffer || threadUntraced)
+		return threadBuffer;
+
+	int slot = traceBufferCount.fetch_add(1);
+	if (slot >= TRACE_MAX_THREADS)
+	{
+		threadUntraced = true;
+		return NULL;
+	}
+
+	threadBuffer = new TraceBuffer;
+	threadBuffer->head.store(0);
+	snprintf(threadBuffer->threadName, sizeof(threadBuffer->threadName), "thread %d", slot);
+	traceBuffers[slot].store(threadBuffer, std::memory_order_release);
+	return threadBuffer;
+}
+
+uint64_t traceNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceOrigin).count();
+}
+
+void traceRecord(const char* name, uint64_t begin, uint64_t end)
+{
+	TraceBuffer* buffer = currentBuffer();
+	if (buffer == NULL)
+		return;
+
+	uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[head & (TRACE_BUFFER_ZONES - 1)];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name)
+{
+	TraceBuffer* buffer = currentBuffer();
+	if (buffer)
+		snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", name);
+}
+
+static std::string jsonString(const char* text)
+{
+	std::string escaped = "\"";
+	for (const char* c = text; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			escaped += '\\';
+		if ((unsigned char)*c >= 0x20)
+			escaped += *c;
+	}
+	return escaped + "\"";
+}
+
+bool traceWrite(const std::string& filename)
+{
+#ifndef WONDERLAND_TRACE
+	std::cout << "Tracing was compiled out, nothing written to " << filename << std::endl;
+	return false;
+#else
+	std::ofstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "Couldn't open " << filename << " for the trace" << std::endl;
+		return false;
+	}
+
+	// Timestamps are in microseconds, keep them down to the nanosecond
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"wonderland\"}}";
+
+	size_t written = 0;
+	std::vector<TraceEvent> events;
+	int threads = std::min(traceBufferCount.load(), TRACE_MAX_THREADS);
+	for (int t = 0; t < threads; ++t)
+	{
+		TraceBuffer* buffer = traceBuffers[t].load(std::memory_order_acquire);
+		if (buffer == NULL)
+			continue;
+
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+			<< ",\"args\":{\"name\":" << jsonString(buffer->threadName) << "}}";
+
+		// Copy out everything written so far, then check how far the thread got while
+		// we were at it. Anything it could have lapped is thrown away, including the slot
+		// event number after is being written into right now.
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t oldest = head > TRACE_BUFFER_ZONES ? head - TRACE_BUFFER_ZONES : 0;
+		events.clear();
+		for (uint64_t i = oldest; i < head; ++i)
+			events.push_back(buffer->events[i & (TRACE_BUFFER_ZONES - 1)]);
+
+		uint64_t after = buffer->head.load(std::memory_order_acquire);
+		size_t lapped = after + 1 > oldest + TRACE_BUFFER_ZONES ? (size_t)(after + 1 - TRACE_BUFFER_ZONES - oldest) : 0;
+		lapped = std::min(lapped, events.size());
+
+		for (size_t i = lapped; i < events.size(); ++i)
+		{
+			const TraceEvent& event = events[i];
+			file << ",\n{\"name\":" << jsonString(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << t
+				<< ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+			++written;
+		}
+	}
+	file << "\n]}\n";
+
+	std::cout << "Trace with " << written << " zones from " << threads << " threads saved to " << filename << std::endl;
+	return true;
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// Zones each thread keeps. The oldest get overwritten once it wraps, so a trace
+// holds roughly the last few seconds.
+#define TRACE_BUFFER_ZONES (1 << 16)
+
+// Threads that can record zones, ones past this just don't show up
+#define TRACE_MAX_THREADS (64)
+
+struct TraceEvent {
+	const char* name;
+	uint64_t begin;		// nanoseconds since the first zone anywhere
+	uint64_t end;
+};
+
+// One per thread, only ever written by that thread. head is bumped after each zone
+// is written, so the exporter knows which ones are complete without taking a lock.
+struct TraceBuffer {
+	TraceEvent events[TRACE_BUFFER_ZONES];
+	std::atomic<uint64_t> head;
+	char threadName[32];
+};
+
+uint64_t traceNow();
+void traceRecord(const char* name, uint64_t begin, uint64_t end);
+void traceThreadName(const char* name);
+
+// Writes every thread's zones as Chrome trace JSON, which chrome://tracing and
+// Perfetto both open. Zones still being written while it runs get left out, so it's
+// safe to call mid-frame. False if the file couldnt be written or tracing was
+// compiled out.
+bool traceWrite(const std::string& filename);
+
+// Times the enclosing scope. Only the name pointer is kept, so it has to outlive
+// the trace being written, string literals are easiest.
+struct TraceZone {
+	const char* name;
+	uint64_t begin;
+
+	explicit TraceZone(const char* name) : name(name), begin(traceNow()) {}
+	~TraceZone() { traceRecord(name, begin, traceNow()); }
+};
+
+// Builds with WONDERLAND_TRACE get zones, without it these compile to nothing
+#ifdef WONDERLAND_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD(name) traceThreadName(name)
+#else
+#define TRACE_ZONE(name) do {} while (0)
+#define TRACE_THREAD(name) do {} while (0)
+#endif
+
+#endif
@@ -2,9 +2,17 @@
 
 layout (location = 0) in vec3 vertexPosition;
 
-uniform mat4 lightSpaceMatrix;
+uniform mat4 M;
+
+// Bound to the light's view for the shadow pass
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * vec4(vertexPosition, 1.0);
+    gl_Position = viewProjection * M * vec4(vertexPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 uv;
+in vec4 color;
+
+// One channel, 1 where a glyph's pixels are
+uniform sampler2D atlas;
+
+out vec4 finalColor;
+
+void main()
+{
+    finalColor = vec4(color.rgb, color.a * texture(atlas, uv).r);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+// Positions are in pixels from the top left of the screen
+layout (location = 0) in vec2 vertexPosition;
+layout (location = 1) in vec2 vertexUV;
+layout (location = 2) in vec4 vertexColor;
+
+uniform vec2 screenSize;
+
+out vec2 uv;
+out vec4 color;
+
+void main()
+{
+    vec2 ndc = vertexPosition / screenSize * vec2(2.0, -2.0) + vec2(-1.0, 1.0);
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    uv = vertexUV;
+    color = vertexColor;
+}
@@ -0,0 +1,410 @@
+#include "animation.h"
+#include "gltf_util.h"
+#include <core/trace.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define ANIMATION_USE_SSE
+#endif
+
+
+int Skeleton::slotOf(int node) const
+{
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i] == node)
+			return (int)i;
+	}
+	return -1;
+}
+
+bool buildSkeleton(const tinygltf::Model& model, const tinygltf::Skin& skin, Skeleton& skeleton)
+{
+	if (skin.joints.empty() || skin.joints.size() > MAX_JOINTS)
+	{
+		std::cout << "Skin has " << skin.joints.size() << " joints, only 1 to " << MAX_JOINTS << " are supported" << std::endl;
+		return false;
+	}
+
+	// glTF only stores children, so work out each node's parent first
+	std::vector<int> parentOf(model.nodes.size(), -1);
+	for (size_t i = 0; i < model.nodes.size(); ++i)
+	{
+		for (size_t c = 0; c < model.nodes[i].children.size(); ++c)
+			parentOf[model.nodes[i].children[c]] = (int)i;
+	}
+
+	// Every joint and everything above it has to be evaluated
+	std::vector<char> needed(model.nodes.size(), 0);
+	for (size_t j = 0; j < skin.joints.size(); ++j)
+	{
+		for (int n = skin.joints[j]; n >= 0 && !needed[n]; n = parentOf[n])
+			needed[n] = 1;
+	}
+
+	// Depth sort gives parent-before-child ordering
+	std::vector<int> depth(model.nodes.size(), 0);
+	std::vector<int> order;
+	for (size_t i = 0; i < model.nodes.size(); ++i)
+	{
+		if (!needed[i])
+			continue;
+		for (int p = parentOf[i]; p >= 0; p = parentOf[p])
+			depth[i]++;
+		order.push_back((int)i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&depth](int a, int b) { return depth[a] < depth[b]; });
+
+	skeleton = Skeleton();
+	skeleton.nodes = order;
+	for (size_t s = 0; s < order.size(); ++s)
+	{
+		const tinygltf::Node& node = model.nodes[order[s]];
+
+		skeleton.parents.push_back(skeleton.slotOf(parentOf[order[s]]));
+
+		glm::vec3 t(0.0f);
+		glm::quat r(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 sc(1.0f);
+		if (node.translation.size() == 3)
+			t = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+		if (node.rotation.size() == 4)
+			r = glm::quat((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]);
+		if (node.scale.size() == 3)
+			sc = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+
+		skeleton.restTranslation.push_back(t);
+		skeleton.restRotation.push_back(r);
+		skeleton.restScale.push_back(sc);
+		skeleton.hasMatrix.push_back(node.matrix.size() == 16);
+		skeleton.restMatrix.push_back(node.matrix.size() == 16 ? glm::mat4(glm::make_mat4(node.matrix.data())) : glm::mat4(1.0f));
+	}
+
+	// Joints without one are left at identity
+	if (skin.inverseBindMatrices >= 0 && !readMatrices(model, skin.inverseBindMatrices, skeleton.inverseBindMatrices))
+		std::cout << "Skin " << skin.name << " has unreadable inverse bind matrices" << std::endl;
+	skeleton.inverseBindMatrices.resize(skin.joints.size(), glm::mat4(1.0f));
+
+	for (size_t j = 0; j < skin.joints.size(); ++j)
+		skeleton.jointSlots.push_back(skeleton.slotOf(skin.joints[j]));
+
+	return true;
+}
+
+bool buildAnimationClip(const tinygltf::Model& model, const tinygltf::Animation& animation,
+	const Skeleton& skeleton, AnimationClip& clip)
+{
+	clip = AnimationClip();
+	clip.name = animation.name;
+	clip.duration = 0.0f;
+
+	for (size_t i = 0; i < animation.samplers.size(); ++i)
+	{
+		const tinygltf::AnimationSampler& source = animation.samplers[i];
+		AnimationSampler sampler;
+
+		std::vector<glm::vec4> times;
+		if (!readAccessor(model, source.input, times) || !readAccessor(model, source.output, sampler.values))
+		{
+			std::cout << "Failed to read animation sampler " << i << " of " << animation.name << std::endl;
+			return false;
+		}
+		for (size_t k = 0; k < times.size(); ++k)
+			sampler.times.push_back(times[k].x);
+
+		sampler.interpolation = INTERP_LINEAR;
+		if (source.interpolation == "STEP")
+			sampler.interpolation = INTERP_STEP;
+		if (source.interpolation == "CUBICSPLINE")
+			sampler.interpolation = INTERP_CUBICSPLINE;
+
+		if (!sampler.times.empty())
+			clip.duration = std::max(clip.duration, sampler.times.back());
+
+		clip.samplers.push_back(sampler);
+	}
+
+	for (size_t i = 0; i < animation.channels.size(); ++i)
+	{
+		const tinygltf::AnimationChannel& source = animation.channels[i];
+
+		// Channels that dont touch the skeleton (or morph weights) are skipped
+		int slot = skeleton.slotOf(source.target_node);
+		if (slot < 0)
+			continue;
+
+		AnimationChannel channel;
+		channel.sampler = source.sampler;
+		channel.slot = slot;
+		if (source.target_path == "translation")
+			channel.path = PATH_TRANSLATION;
+		else if (source.target_path == "rotation")
+			channel.path = PATH_ROTATION;
+		else if (source.target_path == "scale")
+			channel.path = PATH_SCALE;
+		else
+			continue;
+
+		clip.channels.push_back(channel);
+	}
+
+	return true;
+}
+
+static glm::vec4 sampleTrack(const AnimationSampler& sampler, float time, bool isRotation)
+{
+	const std::vector<float>& times = sampler.times;
+	bool cubic = sampler.interpolation == INTERP_CUBICSPLINE;
+
+	// Cubic splines store (in-tangent, value, out-tangent) per key
+	int keyValue = cubic ? 3 : 1;
+	int valueOffset = cubic ? 1 : 0;
+
+	if (times.size() == 1 || time <= times.front())
+		return sampler.values[valueOffset];
+	if (time >= times.back())
+		return sampler.values[(times.size() - 1) * keyValue + valueOffset];
+
+	size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+	size_t prev = next - 1;
+
+	float dt = times[next] - times[prev];
+	float t = (time - times[prev]) / dt;
+
+	if (sampler.interpolation == INTERP_STEP)
+		return sampler.values[prev];
+
+	if (cubic)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		glm::vec4 p0 = sampler.values[prev * 3 + 1];
+		glm::vec4 m0 = sampler.values[prev * 3 + 2] * dt;
+		glm::vec4 p1 = sampler.values[next * 3 + 1];
+		glm::vec4 m1 = sampler.values[next * 3 + 0] * dt;
+		glm::vec4 v = (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 + (t3 - 2.0f * t2 + t) * m0
+			+ (-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * m1;
+		if (isRotation)
+			v = glm::normalize(v);
+		return v;
+	}
+
+	glm::vec4 a = sampler.values[prev];
+	glm::vec4 b = sampler.values[next];
+	if (isRotation)
+	{
+		glm::quat q = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+		return glm::vec4(q.x, q.y, q.z, q.w);
+	}
+	return glm::mix(a, b, t);
+}
+
+// out = a * b, written straight out as the 3 rows of a 3x4 affine matrix
+static void multiplyToRows(const glm::mat4& a, const glm::mat4& b, PaletteRow* out)
+{
+#ifdef ANIMATION_USE_SSE
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+	__m128 columns[4];
+	for (int j = 0; j < 4; ++j)
+	{
+		__m128 c = _mm_mul_ps(a0, _mm_set1_ps(b[j][0]));
+		c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_set1_ps(b[j][1])));
+		c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+		c = _mm_add_ps(c, _mm_mul_ps(a3, _mm_set1_ps(b[j][3])));
+		columns[j] = c;
+	}
+	_MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+	_mm_store_ps(out[0].v, columns[0]);
+	_mm_store_ps(out[1].v, columns[1]);
+	_mm_store_ps(out[2].v, columns[2]);
+#else
+	glm::mat4 m = a * b;
+	for (int r = 0; r < 3; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+			out[r].v[c] = m[c][r];
+	}
+#endif
+}
+
+void sampleAnimation(AnimatedInstance& instance)
+{
+	const Skeleton& skeleton = *instance.skeleton;
+	size_t count = skeleton.nodes.size();
+
+	instance.translation = skeleton.restTranslation;
+	instance.rotation = skeleton.restRotation;
+	instance.scale = skeleton.restScale;
+	instance.global.resize(count);
+
+	std::vector<char>& animated = instance.animated;
+	animated.assign(count, 0);
+	if (instance.clip)
+	{
+		for (size_t i = 0; i < instance.clip->channels.size(); ++i)
+		{
+			const AnimationChannel& channel = instance.clip->channels[i];
+			const AnimationSampler& sampler = instance.clip->samplers[channel.sampler];
+			if (sampler.times.empty())
+				continue;
+
+			glm::vec4 v = sampleTrack(sampler, instance.time, channel.path == PATH_ROTATION);
+			if (channel.path == PATH_TRANSLATION)
+				instance.translation[channel.slot] = glm::vec3(v);
+			else if (channel.path == PATH_ROTATION)
+				instance.rotation[channel.slot] = glm::quat(v.w, v.x, v.y, v.z);
+			else
+				instance.scale[channel.slot] = glm::vec3(v);
+			animated[channel.slot] = 1;
+		}
+	}
+
+	// Parents always come first so one pass is enough
+	for (size_t s = 0; s < count; ++s)
+	{
+		glm::mat4 local;
+		if (skeleton.hasMatrix[s] && !animated[s])
+		{
+			local = skeleton.restMatrix[s];
+		}
+		else
+		{
+			local = glm::translate(glm::mat4(1.0f), instance.translation[s]);
+			local *= glm::mat4_cast(instance.rotation[s]);
+			local = glm::scale(local, instance.scale[s]);
+		}
+
+		int parent = skeleton.parents[s];
+		instance.global[s] = parent >= 0 ? instance.global[parent] * local : local;
+	}
+
+	size_t joints = skeleton.jointSlots.size();
+	instance.palette.resize(joints * 3);
+	for (size_t j = 0; j < joints; ++j)
+		multiplyToRows(instance.global[skeleton.jointSlots[j]], skeleton.inverseBindMatrices[j], &instance.palette[j * 3]);
+}
+
+
+void AnimationSystem::initialize(JobSystem& jobs)
+{
+	this->jobs = &jobs;
+	updateJob = NULL;
+	frameDelta = 0.0f;
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	GLint paletteSize = MAX_JOINTS * 3 * sizeof(PaletteRow);
+	paletteStride = ((paletteSize + alignment - 1) / alignment) * alignment;
+	paletteAlignment = alignment;
+	paletteBufferID = 0;
+	paletteOffset = 0;
+
+	std::vector<PaletteRow> rest(MAX_JOINTS * 3);
+	for (size_t i = 0; i < rest.size(); ++i)
+		for (int j = 0; j < 4; ++j)
+			rest[i].v[j] = (int)(i % 3) == j ? 1.0f : 0.0f;
+	restPaletteID.create("rest palette");
+	glBindBuffer(GL_UNIFORM_BUFFER, restPaletteID);
+	glBufferData(GL_UNIFORM_BUFFER, paletteSize, rest.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	restPaletteID.setBytes(paletteSize);
+}
+
+int AnimationSystem::addInstance(const Skeleton* skeleton, const AnimationClip* clip, float speed, bool loop)
+{
+	AnimatedInstance instance;
+	instance.skeleton = skeleton;
+	instance.clip = clip;
+	instance.time = 0.0f;
+	instance.speed = speed;
+	instance.loop = loop;
+	sampleAnimation(instance);	// so theres a valid pose before the first update
+	instances.push_back(instance);
+	return (int)instances.size() - 1;
+}
+
+void AnimationSystem::updateInstance(int index)
+{
+	AnimatedInstance& instance = instances[index];
+	if (instance.clip && instance.clip->duration > 0.0f)
+	{
+		instance.time += frameDelta * instance.speed;
+		if (instance.loop)
+			instance.time = fmodf(instance.time, instance.clip->duration);
+		else
+			instance.time = std::min(instance.time, instance.clip->duration);
+	}
+	TRACE_ZONE("sample animation");
+	sampleAnimation(instance);
+}
+
+void AnimationSystem::beginUpdate(float deltaTime)
+{
+	// One instance per job, sampling a skeleton is plenty of work on its own
+	frameDelta = deltaTime;
+	updateJob = parallelForAsync(*jobs, (int)instances.size(), 1, [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			updateInstance(i);
+	});
+}
+
+void AnimationSystem::endUpdate(StreamBuffer& stream)
+{
+	if (updateJob)
+	{
+		jobs->wait(updateJob);
+		updateJob = NULL;
+	}
+
+	if (instances.empty())
+		return;
+
+	// Every palette at its aligned offset, straight into this frame's region
+	StreamAllocation allocation = stream.allocate(instances.size() * paletteStride, paletteAlignment);
+	if (allocation.data == NULL)
+		return;
+
+	unsigned char* data = (unsigned char*)allocation.data;
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		const std::vector<PaletteRow>& palette = instances[i].palette;
+		memcpy(data + i * paletteStride, palette.data(), palette.size() * sizeof(PaletteRow));
+	}
+	stream.flush();
+
+	paletteBufferID = stream.bufferID;
+	paletteOffset = allocation.offset;
+}
+
+void AnimationSystem::bindPalette(int instance)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, JOINT_PALETTE_BINDING, paletteBufferID,
+		paletteOffset + instance * paletteStride, MAX_JOINTS * 3 * sizeof(PaletteRow));
+}
+
+void AnimationSystem::bindRestPalette()
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, JOINT_PALETTE_BINDING, restPaletteID);
+}
+
+void AnimationSystem::cleanup()
+{
+	// Dont leave jobs running on instances that are about to go away
+	if (updateJob)
+	{
+		jobs->wait(updateJob);
+		updateJob = NULL;
+	}
+	restPaletteID.reset();
+}
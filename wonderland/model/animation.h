@@ -0,0 +1,129 @@
+#ifndef _ANIMATION_H_
+#define _ANIMATION_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "gltf_util.h"
+#include <render/stream_buffer.h>
+#include <core/job_system.h>
+
+#include <vector>
+#include <string>
+
+// Has to match MAX_JOINTS in the skinning vertex shader
+#define MAX_JOINTS (64)
+
+// Binding point the joint palette uniform block is attached to
+#define JOINT_PALETTE_BINDING (0)
+
+enum AnimationPath { PATH_TRANSLATION = 0, PATH_ROTATION = 1, PATH_SCALE = 2 };
+enum AnimationInterpolation { INTERP_LINEAR = 0, INTERP_STEP = 1, INTERP_CUBICSPLINE = 2 };
+
+// One keyframe track. Values are always stored as vec4 (xyz for T/S, xyzw for R).
+// Cubic spline tracks keep glTF's (in-tangent, value, out-tangent) triplets.
+struct AnimationSampler {
+	std::vector<float> times;
+	std::vector<glm::vec4> values;
+	int interpolation;
+};
+
+struct AnimationChannel {
+	int sampler;
+	int slot;	// index into Skeleton's flattened node list
+	int path;
+};
+
+struct AnimationClip {
+	std::string name;
+	float duration;
+	std::vector<AnimationSampler> samplers;
+	std::vector<AnimationChannel> channels;
+};
+
+// Joints plus all their ancestors, flattened so a parent always comes before its children.
+// This way the global transforms can be built in a single forward pass.
+struct Skeleton {
+	std::vector<int> nodes;			// glTF node index of each slot
+	std::vector<int> parents;		// parent slot, -1 for roots
+	std::vector<glm::vec3> restTranslation;
+	std::vector<glm::quat> restRotation;
+	std::vector<glm::vec3> restScale;
+	std::vector<glm::mat4> restMatrix;	// only used where hasMatrix is set
+	std::vector<char> hasMatrix;
+
+	std::vector<int> jointSlots;	// slot of each skin joint, in skin order
+	std::vector<glm::mat4> inverseBindMatrices;
+
+	int slotOf(int node) const;
+};
+
+// Palette is stored as 3 rows of 4 floats per joint (transposed affine 3x4) so
+// it can go straight into a std140 block and be skinned with dot products.
+struct alignas(16) PaletteRow {
+	float v[4];
+};
+
+struct AnimatedInstance {
+	const Skeleton* skeleton;
+	const AnimationClip* clip;
+	float time;
+	float speed;
+	bool loop;
+
+	// Scratch space for the sampling job, never touched by the render thread
+	std::vector<glm::vec3> translation;
+	std::vector<glm::quat> rotation;
+	std::vector<glm::vec3> scale;
+	std::vector<glm::mat4> global;
+	std::vector<char> animated;		// nodes a channel wrote to this frame
+
+	std::vector<PaletteRow> palette;
+};
+
+bool buildSkeleton(const tinygltf::Model& model, const tinygltf::Skin& skin, Skeleton& skeleton);
+bool buildAnimationClip(const tinygltf::Model& model, const tinygltf::Animation& animation,
+	const Skeleton& skeleton, AnimationClip& clip);
+
+// Samples the clip at the instance's current time and writes its joint palette
+void sampleAnimation(AnimatedInstance& instance);
+
+// Owns every animated instance, samples them as jobs and writes the resulting
+// palettes into the frame's stream buffer region.
+struct AnimationSystem {
+	std::vector<AnimatedInstance> instances;
+
+	GLuint paletteBufferID;	// the stream buffer, once endUpdate has run
+	size_t paletteOffset;	// where this frame's palettes start in it
+	GLint paletteAlignment;	// UBO offset alignment
+	GLint paletteStride;	// bytes between instances, rounded up to the alignment
+	GLBuffer restPaletteID;	// identity for every joint, for draws that arent skinned
+
+	JobSystem* jobs;
+	Job* updateJob;		// this frame's sampling, NULL when there isnt one running
+	float frameDelta;
+
+	void initialize(JobSystem& jobs);
+
+	int addInstance(const Skeleton* skeleton, const AnimationClip* clip, float speed = 1.0f, bool loop = true);
+
+	// Kick off sampling for this frame as jobs. Returns straight away so the
+	// render thread can get on with other passes.
+	void beginUpdate(float deltaTime);
+
+	// Wait for the jobs, then copy every palette into the stream buffer
+	void endUpdate(StreamBuffer& stream);
+
+	// Attach an instance's palette to JOINT_PALETTE_BINDING before drawing it
+	void bindPalette(int instance);
+	// The block is still live in the shader when skinning is off, so something has to
+	// be bound there. This is the identity palette, which leaves vertices where they are.
+	void bindRestPalette();
+
+	void cleanup();
+
+private:
+	void updateInstance(int instance);
+};
+
+#endif
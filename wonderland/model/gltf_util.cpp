@@ -0,0 +1,161 @@
+#include "gltf_util.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// Start of the accessor's data and the distance between elements, or NULL if it has
+// none or its elements dont all fit inside its buffer view
+static const unsigned char* accessorData(const tinygltf::Model& model, int accessorIndex, int& stride)
+{
+	if (accessorIndex < 0 || accessorIndex >= (int)model.accessors.size())
+		return NULL;
+
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	if (accessor.bufferView < 0 || accessor.bufferView >= (int)model.bufferViews.size())
+		return NULL;
+
+	const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+	if (bufferView.buffer < 0 || bufferView.buffer >= (int)model.buffers.size())
+		return NULL;
+	const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+
+	stride = accessor.ByteStride(bufferView);
+	int elementSize = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+	if (stride <= 0 || elementSize <= 0)
+		return NULL;
+
+	size_t viewEnd = std::min<size_t>(bufferView.byteOffset + bufferView.byteLength, buffer.data.size());
+	size_t start = bufferView.byteOffset + accessor.byteOffset;
+	if (accessor.count > 0 && (accessor.count > buffer.data.size() ||
+		start + (accessor.count - 1) * stride + elementSize > viewEnd))
+		return NULL;
+
+	return buffer.data.data() + start;
+}
+
+bool readAccessor(const tinygltf::Model& model, int accessorIndex, std::vector<glm::vec4>& out)
+{
+	int stride;
+	const unsigned char* base = accessorData(model, accessorIndex, stride);
+	if (!base)
+		return false;
+
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	int components = tinygltf::GetNumComponentsInType(accessor.type);
+	if (components <= 0 || components > 4)
+		return false;
+
+	out.resize(accessor.count);
+	for (size_t i = 0; i < accessor.count; ++i)
+	{
+		const unsigned char* element = base + i * stride;
+		glm::vec4 v(0.0f);
+		for (int c = 0; c < components; ++c)
+		{
+			switch (accessor.componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				v[c] = ((const float*)element)[c];
+				break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				v[c] = std::max(((const signed char*)element)[c] / 127.0f, -1.0f);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				v[c] = ((const unsigned char*)element)[c] / 255.0f;
+				break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				v[c] = std::max(((const short*)element)[c] / 32767.0f, -1.0f);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				v[c] = ((const unsigned short*)element)[c] / 65535.0f;
+				break;
+			default:
+				return false;
+			}
+		}
+		out[i] = v;
+	}
+	return true;
+}
+
+bool readMatrices(const tinygltf::Model& model, int accessorIndex, std::vector<glm::mat4>& out)
+{
+	int stride;
+	const unsigned char* base = accessorData(model, accessorIndex, stride);
+	if (!base)
+		return false;
+
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	if (accessor.type != TINYGLTF_TYPE_MAT4 || accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT)
+		return false;
+
+	out.resize(accessor.count);
+	for (size_t i = 0; i < accessor.count; ++i)
+		memcpy(&out[i][0][0], base + i * stride, sizeof(glm::mat4));
+	return true;
+}
+
+bool readPositions(const tinygltf::Model& model, int accessorIndex, std::vector<glm::vec3>& out)
+{
+	std::vector<glm::vec4> values;
+	if (!readAccessor(model, accessorIndex, values))
+		return false;
+
+	out.resize(values.size());
+	for (size_t i = 0; i < values.size(); ++i)
+		out[i] = glm::vec3(values[i]);
+	return true;
+}
+
+bool readIndices(const tinygltf::Model& model, int accessorIndex, std::vector<unsigned int>& out)
+{
+	int stride;
+	const unsigned char* base = accessorData(model, accessorIndex, stride);
+	if (!base)
+		return false;
+
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	out.resize(accessor.count);
+	for (size_t i = 0; i < accessor.count; ++i)
+	{
+		const unsigned char* element = base + i * stride;
+		switch (accessor.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			out[i] = *(const unsigned char*)element;
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			out[i] = *(const unsigned short*)element;
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			out[i] = *(const unsigned int*)element;
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+glm::mat4 nodeTransform(const tinygltf::Node& node)
+{
+	if (node.matrix.size() == 16)
+	{
+		glm::mat4 matrix;
+		for (int i = 0; i < 16; ++i)
+			matrix[i / 4][i % 4] = (float)node.matrix[i];
+		return matrix;
+	}
+
+	glm::mat4 transform;
+	if (node.translation.size() == 3)
+		transform = glm::translate(transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+	if (node.rotation.size() == 4)
+		transform = transform * glm::mat4_cast(glm::quat((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]));
+	if (node.scale.size() == 3)
+		transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+	return transform;
+}
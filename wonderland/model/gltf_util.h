@@ -0,0 +1,36 @@
+#ifndef _GLTF_UTIL_H_
+#define _GLTF_UTIL_H_
+
+#include <glm/glm.hpp>
+
+// Every file has to see tinygltf configured the same way. Images are loaded with our
+// own stb calls, so tinygltf is built without its copy.
+#ifndef TINYGLTF_NOEXCEPTION
+#define TINYGLTF_NOEXCEPTION
+#endif
+#ifndef TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE
+#endif
+#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#endif
+#include "tiny_gltf.h"
+
+#include <vector>
+
+// Reads any float or normalized integer accessor into vec4s (missing components are 0)
+bool readAccessor(const tinygltf::Model& model, int accessorIndex, std::vector<glm::vec4>& out);
+
+// Reads a float MAT4 accessor, like a skin's inverse bind matrices
+bool readMatrices(const tinygltf::Model& model, int accessorIndex, std::vector<glm::mat4>& out);
+
+// Reads a POSITION style accessor
+bool readPositions(const tinygltf::Model& model, int accessorIndex, std::vector<glm::vec3>& out);
+
+// Reads an index accessor of any integer type, widened to 32 bits
+bool readIndices(const tinygltf::Model& model, int accessorIndex, std::vector<unsigned int>& out);
+
+// The node's own transform, from its matrix or its translation, rotation and scale
+glm::mat4 nodeTransform(const tinygltf::Node& node);
+
+#endif
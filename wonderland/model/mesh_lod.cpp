@@ -0,0 +1,184 @@
+#include "mesh_lod.h"
+#include "simplify.h"
+
+#include <fstream>
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+
+void buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	int maxLevels, float reductionRatio, PrimitiveLods& lods)
+{
+	lods.levels.clear();
+	lods.indices.clear();
+
+	std::vector<unsigned int> source = indices;
+	std::vector<unsigned int> simplified;
+	float error = 0.0f;
+
+	for (int level = 0; level < maxLevels; ++level)
+	{
+		size_t target = (size_t)(source.size() / 3 * reductionRatio) * 3;
+		if (target < 3)
+			break;
+
+		// Each level starts from the last, so the error can only grow
+		float levelError = simplifyMesh(positions, source, target, 1.0f, simplified);
+		error = std::max(error, levelError);
+
+		// Not worth another level if it barely changed anything
+		if (simplified.empty() || simplified.size() > source.size() * 0.9f)
+			break;
+
+		MeshLod lod;
+		lod.indexOffset = (unsigned int)lods.indices.size();
+		lod.indexCount = (unsigned int)simplified.size();
+		lod.error = error;
+		lods.levels.push_back(lod);
+		lods.indices.insert(lods.indices.end(), simplified.begin(), simplified.end());
+
+		source.swap(simplified);
+	}
+}
+
+std::string lodFilePath(const std::string& modelPath)
+{
+	size_t dot = modelPath.find_last_of('.');
+	size_t slash = modelPath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return modelPath + ".lod";
+	return modelPath.substr(0, dot) + ".lod";
+}
+
+bool saveLodFile(const std::string& path, const std::vector<PrimitiveLods>& lods)
+{
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write LOD file " << path << std::endl;
+		return false;
+	}
+
+	unsigned int header[3] = { 0x444f4c57u /* "WLOD" */, LOD_FILE_VERSION, (unsigned int)lods.size() };
+	file.write((const char*)header, sizeof(header));
+
+	for (size_t i = 0; i < lods.size(); ++i)
+	{
+		const PrimitiveLods& primitive = lods[i];
+		int ids[2] = { primitive.mesh, primitive.primitive };
+		unsigned int levelCount = (unsigned int)primitive.levels.size();
+		file.write((const char*)ids, sizeof(ids));
+		file.write((const char*)&levelCount, sizeof(levelCount));
+
+		for (size_t l = 0; l < primitive.levels.size(); ++l)
+		{
+			file.write((const char*)&primitive.levels[l].indexCount, sizeof(unsigned int));
+			file.write((const char*)&primitive.levels[l].error, sizeof(float));
+		}
+		file.write((const char*)primitive.indices.data(), primitive.indices.size() * sizeof(unsigned int));
+	}
+
+	return file.good();
+}
+
+bool loadLodFile(const std::string& path, std::vector<PrimitiveLods>& lods)
+{
+	lods.clear();
+
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t)file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	unsigned int header[3];
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] != 0x444f4c57u || header[1] != LOD_FILE_VERSION)
+	{
+		std::cout << "LOD file " << path << " is out of date, regenerate it with wonderland_lodgen" << std::endl;
+		return false;
+	}
+
+	// Every count is checked against what's left of the file before anything is sized
+	// from it, so a corrupt one can't ask for more memory than the file could hold
+	uint64_t remaining = fileSize - sizeof(header);
+	bool fits = header[2] <= remaining / (sizeof(int) * 2 + sizeof(unsigned int));
+	if (fits)
+		lods.resize(header[2]);
+	for (size_t i = 0; i < lods.size() && file && fits; ++i)
+	{
+		PrimitiveLods& primitive = lods[i];
+		int ids[2];
+		unsigned int levelCount = 0;
+		file.read((char*)ids, sizeof(ids));
+		file.read((char*)&levelCount, sizeof(levelCount));
+		primitive.mesh = ids[0];
+		primitive.primitive = ids[1];
+		remaining -= std::min<uint64_t>(remaining, sizeof(ids) + sizeof(levelCount));
+
+		fits = levelCount <= remaining / (sizeof(unsigned int) + sizeof(float));
+		if (!fits)
+			break;
+		uint64_t offset = 0;
+		primitive.levels.resize(levelCount);
+		for (size_t l = 0; l < levelCount; ++l)
+		{
+			file.read((char*)&primitive.levels[l].indexCount, sizeof(unsigned int));
+			file.read((char*)&primitive.levels[l].error, sizeof(float));
+			primitive.levels[l].indexOffset = (unsigned int)offset;
+			offset += primitive.levels[l].indexCount;
+		}
+		remaining -= levelCount * (sizeof(unsigned int) + sizeof(float));
+
+		fits = offset <= remaining / sizeof(unsigned int);
+		if (!fits)
+			break;
+		primitive.indices.resize((size_t)offset);
+		file.read((char*)primitive.indices.data(), offset * sizeof(unsigned int));
+		remaining -= offset * sizeof(unsigned int);
+	}
+
+	if (!file || !fits)
+	{
+		std::cout << "LOD file " << path << " is truncated" << std::endl;
+		lods.clear();
+		return false;
+	}
+	return true;
+}
+
+// Error of a level in pixels, level 0 is exact
+static float levelError(const PrimitiveLods& lods, int level, float projectedRadius)
+{
+	return level == 0 ? 0.0f : lods.levels[level - 1].error * projectedRadius;
+}
+
+int selectLod(const PrimitiveLods& lods, float projectedRadius, int currentLevel,
+	float pixelThreshold, float hysteresis)
+{
+	int levelCount = (int)lods.levels.size() + 1;
+	if (currentLevel < 0 || currentLevel >= levelCount)
+		currentLevel = 0;
+
+	int best = 0;
+	for (int level = 1; level < levelCount; ++level)
+	{
+		if (levelError(lods, level, projectedRadius) <= pixelThreshold)
+			best = level;
+	}
+
+	if (best > currentLevel)
+	{
+		// Going coarser, wait until the new level is comfortably under the threshold
+		while (best > currentLevel && levelError(lods, best, projectedRadius) > pixelThreshold * (1.0f - hysteresis))
+			best--;
+	}
+	else if (best < currentLevel)
+	{
+		// Going finer, put up with the current level until its clearly too coarse
+		if (levelError(lods, currentLevel, projectedRadius) <= pixelThreshold * (1.0f + hysteresis))
+			best = currentLevel;
+	}
+	return best;
+}
@@ -0,0 +1,44 @@
+#ifndef _MESH_LOD_H_
+#define _MESH_LOD_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+#define LOD_FILE_VERSION (1)
+
+// One level of detail, as a range of an index buffer shared by all levels
+struct MeshLod {
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;	// relative to the primitive's bounding radius
+};
+
+// Coarser levels for one glTF primitive. Level 0 (the model's own indices) is not
+// stored, so levels[0] here is the first simplified level.
+struct PrimitiveLods {
+	int mesh;
+	int primitive;
+	std::vector<MeshLod> levels;
+	std::vector<unsigned int> indices;
+};
+
+// Repeatedly simplifies by reductionRatio until maxLevels are made or the
+// simplifier cant get rid of enough triangles any more
+void buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	int maxLevels, float reductionRatio, PrimitiveLods& lods);
+
+// LODs live next to the model, e.g. rusticLamps.gltf -> rusticLamps.lod
+std::string lodFilePath(const std::string& modelPath);
+
+bool saveLodFile(const std::string& path, const std::vector<PrimitiveLods>& lods);
+bool loadLodFile(const std::string& path, std::vector<PrimitiveLods>& lods);
+
+// Picks the coarsest level whose error covers at most pixelThreshold pixels at the
+// given projected radius. Only moves away from the current level once the choice is
+// clearly better by the hysteresis margin, so levels dont flicker at the boundaries.
+// Level 0 is full detail, level i is lods.levels[i - 1].
+int selectLod(const PrimitiveLods& lods, float projectedRadius, int currentLevel,
+	float pixelThreshold = 1.0f, float hysteresis = 0.25f);
+
+#endif
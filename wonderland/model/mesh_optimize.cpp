@@ -0,0 +1,391 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangles = indices.size() / 3;
+	stats.vertices = vertexCount;
+	stats.misses = 0;
+
+	// Timestamp FIFO: a vertex is in the cache if it went in less than cacheSize misses ago
+	std::vector<size_t> insertedAt(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		unsigned int v = indices[i];
+		if (time - insertedAt[v] > (size_t)cacheSize)
+		{
+			insertedAt[v] = time++;
+			stats.misses++;
+		}
+	}
+
+	stats.acmr = stats.triangles ? (float)stats.misses / stats.triangles : 0.0f;
+	stats.atvr = vertexCount ? (float)stats.misses / vertexCount : 0.0f;
+	return stats;
+}
+
+VertexFetchStats analyzeVertexFetch(const std::vector<unsigned int>& indices, size_t vertexCount, size_t vertexStride)
+{
+	const size_t lineSize = 64;
+	const size_t lineCount = 64;	// 4KB, roughly a vertex fetch cache
+
+	VertexFetchStats stats;
+	stats.bytesFetched = 0;
+
+	std::vector<size_t> lines(lineCount, ~(size_t)0);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		size_t start = indices[i] * vertexStride;
+		for (size_t line = start / lineSize; line <= (start + vertexStride - 1) / lineSize; ++line)
+		{
+			size_t slot = line % lineCount;
+			if (lines[slot] != line)
+			{
+				lines[slot] = line;
+				stats.bytesFetched += lineSize;
+			}
+		}
+	}
+
+	size_t bufferSize = vertexCount * vertexStride;
+	stats.overfetch = bufferSize ? (float)stats.bytesFetched / bufferSize : 0.0f;
+	return stats;
+}
+
+size_t buildWeldRemap(const void* vertices, size_t vertexCount, size_t vertexStride, std::vector<unsigned int>& remap)
+{
+	const unsigned char* bytes = (const unsigned char*)vertices;
+
+	// Sort vertex numbers by their bytes so duplicates end up next to each other
+	std::vector<unsigned int> order(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+		order[i] = (unsigned int)i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return memcmp(bytes + a * vertexStride, bytes + b * vertexStride, vertexStride) < 0;
+	});
+
+	// Every duplicate points at the first copy in the original order
+	std::vector<unsigned int> firstCopy(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		bool same = i > 0 && memcmp(bytes + order[i] * vertexStride, bytes + order[i - 1] * vertexStride, vertexStride) == 0;
+		firstCopy[order[i]] = same ? firstCopy[order[i - 1]] : order[i];
+	}
+
+	remap.assign(vertexCount, ~0u);
+	size_t newCount = 0;
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		if (firstCopy[i] == i)
+			remap[i] = (unsigned int)newCount++;
+		else
+			remap[i] = remap[firstCopy[i]];
+	}
+	return newCount;
+}
+
+size_t buildFetchRemap(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& remap)
+{
+	remap.assign(vertexCount, ~0u);
+	size_t newCount = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+		if (remap[indices[i]] == ~0u)
+			remap[indices[i]] = (unsigned int)newCount++;
+	return newCount;
+}
+
+void remapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexStride, const std::vector<unsigned int>& remap)
+{
+	unsigned char* out = (unsigned char*)destination;
+	const unsigned char* in = (const unsigned char*)vertices;
+	for (size_t i = 0; i < vertexCount; ++i)
+		if (remap[i] != ~0u)
+			memcpy(out + remap[i] * vertexStride, in + i * vertexStride, vertexStride);
+}
+
+void remapIndices(std::vector<unsigned int>& indices, const std::vector<unsigned int>& remap)
+{
+	for (size_t i = 0; i < indices.size(); ++i)
+		indices[i] = remap[indices[i]];
+}
+
+// Forsyth's scoring. Cache positions are an LRU of this size, bigger than the
+// real FIFO on purpose, it gives a smoother score.
+#define FORSYTH_CACHE_SIZE (32)
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so the next triangle
+		// doesnt just reuse the same edge over and over
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// Boost vertices with few triangles left, so they get finished off and leave the cache
+	score += 2.0f * powf((float)remainingTriangles, -0.5f);
+	return score;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		adjacencyOffset[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] += adjacencyOffset[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<unsigned int> remaining(vertexCount);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		remaining[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; ++t)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> cache, nextCache;
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	size_t scanStart = 0;
+
+	while (result.size() < triangleCount * 3)
+	{
+		// Best triangle touching the cache, or the best anywhere if the cache has nothing left
+		int best = -1;
+		float bestScore = -1e30f;
+		for (size_t c = 0; c < cache.size(); ++c)
+		{
+			unsigned int v = cache[c];
+			for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a)
+			{
+				unsigned int t = adjacency[a];
+				if (!emitted[t] && triangleScore[t] > bestScore)
+				{
+					best = (int)t;
+					bestScore = triangleScore[t];
+				}
+			}
+		}
+		if (best < 0)
+		{
+			// Only happens when a piece of the mesh is finished, so taking the next
+			// unemitted triangle in order is close enough and keeps this linear
+			while (emitted[scanStart])
+				scanStart++;
+			best = (int)scanStart;
+		}
+
+		emitted[best] = 1;
+		const unsigned int* tri = &indices[best * 3];
+		result.insert(result.end(), tri, tri + 3);
+
+		// Move its vertices to the front of the cache
+		nextCache.assign(tri, tri + 3);
+		for (int k = 0; k < 3; ++k)
+		{
+			// Keep only remaining triangles at the front of the vertex's list
+			unsigned int v = tri[k];
+			for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; ++a)
+			{
+				if (adjacency[a] == (unsigned int)best)
+				{
+					remaining[v]--;
+					std::swap(adjacency[a], adjacency[adjacencyOffset[v] + remaining[v]]);
+					break;
+				}
+			}
+		}
+		for (size_t c = 0; c < cache.size(); ++c)
+			if (cache[c] != tri[0] && cache[c] != tri[1] && cache[c] != tri[2])
+				nextCache.push_back(cache[c]);
+
+		// Vertices that fell out lose their cache score
+		for (size_t c = FORSYTH_CACHE_SIZE; c < nextCache.size(); ++c)
+		{
+			cachePosition[nextCache[c]] = -1;
+			score[nextCache[c]] = vertexScore(-1, remaining[nextCache[c]]);
+		}
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+
+		for (size_t c = 0; c < cache.size(); ++c)
+		{
+			cachePosition[cache[c]] = (int)c;
+			score[cache[c]] = vertexScore((int)c, remaining[cache[c]]);
+		}
+
+		// Only triangles around cached vertices can have changed score
+		for (size_t c = 0; c < cache.size(); ++c)
+		{
+			unsigned int v = cache[c];
+			for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; ++a)
+			{
+				unsigned int t = adjacency[a];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+			}
+		}
+	}
+
+	// Only whole triangles were reordered, a trailing partial one stays at the end
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+struct Cluster {
+	size_t start;
+	size_t end;
+	float sortKey;
+};
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Hard boundaries: triangles where the cache had none of the vertices, so
+	// starting a cluster there costs nothing
+	std::vector<size_t> hard;
+	{
+		std::vector<size_t> insertedAt(positions.size(), 0);
+		size_t time = VERTEX_CACHE_SIZE + 1;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - insertedAt[v] > VERTEX_CACHE_SIZE)
+				{
+					insertedAt[v] = time++;
+					misses++;
+				}
+			}
+			if (t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triangleCount);
+	}
+
+	// Soft boundaries: cut a hard cluster wherever its ACMR so far, measured from a
+	// cold cache, is still within threshold of the whole cluster's
+	std::vector<Cluster> clusters;
+	std::vector<size_t> insertedAt(positions.size(), 0);
+	size_t time = VERTEX_CACHE_SIZE + 1;
+	for (size_t h = 0; h + 1 < hard.size(); ++h)
+	{
+		size_t start = hard[h], end = hard[h + 1];
+
+		time += VERTEX_CACHE_SIZE + 1;
+		size_t clusterMisses = 0;
+		for (size_t i = start * 3; i < end * 3; ++i)
+		{
+			if (time - insertedAt[indices[i]] > VERTEX_CACHE_SIZE)
+			{
+				insertedAt[indices[i]] = time++;
+				clusterMisses++;
+			}
+		}
+		float clusterAcmr = (float)clusterMisses / (end - start);
+
+		size_t clusterStart = start;
+		size_t misses = 0;
+		time += VERTEX_CACHE_SIZE + 1;
+		for (size_t t = start; t < end; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - insertedAt[v] > VERTEX_CACHE_SIZE)
+				{
+					insertedAt[v] = time++;
+					misses++;
+				}
+			}
+			if (t + 1 < end && (float)misses / (t + 1 - clusterStart) <= clusterAcmr * threshold)
+			{
+				Cluster cluster = { clusterStart, t + 1, 0.0f };
+				clusters.push_back(cluster);
+				clusterStart = t + 1;
+				misses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+		Cluster cluster = { clusterStart, end, 0.0f };
+		clusters.push_back(cluster);
+	}
+
+	// Area weighted mesh centre
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const glm::vec3& a = positions[indices[t * 3]];
+		const glm::vec3& b = positions[indices[t * 3 + 1]];
+		const glm::vec3& c = positions[indices[t * 3 + 2]];
+		float area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	// Clusters facing away from the centre are on the outside and should go first
+	for (size_t i = 0; i < clusters.size(); ++i)
+	{
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[i].start; t < clusters[i].end; ++t)
+		{
+			const glm::vec3& a = positions[indices[t * 3]];
+			const glm::vec3& b = positions[indices[t * 3 + 1]];
+			const glm::vec3& c = positions[indices[t * 3 + 2]];
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(n);
+			center += (a + b + c) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+		if (area > 0.0f)
+			center /= area;
+		float normalLength = glm::length(normal);
+		clusters[i].sortKey = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i < clusters.size(); ++i)
+		result.insert(result.end(), indices.begin() + clusters[i].start * 3, indices.begin() + clusters[i].end * 3);
+	std::copy(result.begin(), result.end(), indices.begin());
+}
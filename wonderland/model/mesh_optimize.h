@@ -0,0 +1,57 @@
+#ifndef _MESH_OPTIMIZE_H_
+#define _MESH_OPTIMIZE_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// Index and vertex reordering for static meshes. Run in this order:
+// weld, vertex cache, overdraw, vertex fetch. Each step keeps what the one
+// before it bought, more or less.
+
+// Post transform cache behaviour of an index buffer, simulated as a FIFO.
+// ACMR is cache misses per triangle (0.5 is about the best a grid can do, 3 is
+// no reuse at all). ATVR is misses per vertex, 1.0 means every vertex is shaded once.
+struct VertexCacheStats {
+	size_t triangles;
+	size_t vertices;
+	size_t misses;
+	float acmr;
+	float atvr;
+};
+
+// Bytes pulled through a small direct mapped cache of 64 byte lines, compared to
+// the size of the vertex buffer. 1.0 means every byte is read once.
+struct VertexFetchStats {
+	size_t bytesFetched;
+	float overfetch;
+};
+
+#define VERTEX_CACHE_SIZE (16)
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE);
+VertexFetchStats analyzeVertexFetch(const std::vector<unsigned int>& indices, size_t vertexCount, size_t vertexStride);
+
+// Finds vertices whose bytes are identical. remap[old] is the new index, new
+// vertices keep the order they first appear in. Returns the new vertex count.
+size_t buildWeldRemap(const void* vertices, size_t vertexCount, size_t vertexStride, std::vector<unsigned int>& remap);
+
+// Numbers vertices in the order the index buffer first uses them, so the GPU walks
+// the vertex buffer more or less linearly. Unused vertices map to ~0u and are
+// dropped. Returns the new vertex count.
+size_t buildFetchRemap(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& remap);
+
+// Applies a remap from either of the above. destination needs room for the new count.
+void remapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexStride, const std::vector<unsigned int>& remap);
+void remapIndices(std::vector<unsigned int>& indices, const std::vector<unsigned int>& remap);
+
+// Reorders triangles for the post transform cache (Forsyth's linear speed
+// vertex cache optimisation)
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Splits the cache optimised order into clusters and draws the ones facing out of
+// the mesh first, so later triangles are more likely to fail the depth test.
+// threshold is how much worse the ACMR is allowed to get, 1.05 = 5%.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+#endif
@@ -0,0 +1,63 @@
+#include "quantize.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+glm::mat4 positionDequantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+
+	// Flat meshes like the ground have no extent on one axis, any scale works there
+	for (int i = 0; i < 3; ++i)
+		if (halfExtent[i] <= 0.0f)
+			halfExtent[i] = 1.0f;
+
+	glm::mat4 dequantize = glm::translate(glm::mat4(), center);
+	return glm::scale(dequantize, halfExtent);
+}
+
+void quantizePosition(const glm::vec3& position, const glm::mat4& quantize, int16_t out[3])
+{
+	glm::vec3 normalized = glm::vec3(quantize * glm::vec4(position, 1.0f));
+	for (int i = 0; i < 3; ++i)
+		out[i] = (int16_t)glm::packSnorm1x16(normalized[i]);
+}
+
+static float signNotZero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+void encodeOctahedral(const glm::vec3& normal, int16_t out[2])
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	glm::vec2 folded = length > 0.0f ? glm::vec2(normal.x, normal.y) / length : glm::vec2(0.0f);
+
+	// Lower hemisphere gets folded over the diagonals
+	if (length > 0.0f && normal.z < 0.0f)
+		folded = glm::vec2((1.0f - fabsf(folded.y)) * signNotZero(folded.x), (1.0f - fabsf(folded.x)) * signNotZero(folded.y));
+
+	out[0] = (int16_t)glm::packSnorm1x16(folded.x);
+	out[1] = (int16_t)glm::packSnorm1x16(folded.y);
+}
+
+glm::vec3 decodeOctahedral(const int16_t in[2])
+{
+	glm::vec3 n(glm::unpackSnorm1x16((uint16_t)in[0]), glm::unpackSnorm1x16((uint16_t)in[1]), 0.0f);
+	n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+	float t = glm::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+uint16_t quantizeHalf(float value)
+{
+	return glm::packHalf1x16(value);
+}
+
+uint8_t quantizeUnorm8(float value)
+{
+	return glm::packUnorm1x8(value);
+}
@@ -0,0 +1,24 @@
+#ifndef _QUANTIZE_H_
+#define _QUANTIZE_H_
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+// Helpers for packing static vertex data into as few bits as the GPU can still
+// unpack for free with normalized / half float vertex attributes.
+
+// Positions are stored as normalized 16 bit ints across the mesh's bounding box.
+// Returns the matrix that takes the normalized [-1, 1] values back to mesh space,
+// which the viewer just multiplies into the model matrix.
+glm::mat4 positionDequantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+void quantizePosition(const glm::vec3& position, const glm::mat4& quantize, int16_t out[3]);
+
+// Octahedral normal: the unit sphere folded onto a square, two snorm16s.
+// Decoded in the shader with octDecode, see box.vert.
+void encodeOctahedral(const glm::vec3& normal, int16_t out[2]);
+glm::vec3 decodeOctahedral(const int16_t in[2]);
+
+uint16_t quantizeHalf(float value);
+uint8_t quantizeUnorm8(float value);
+
+#endif
@@ -0,0 +1,332 @@
+#include "simplify.h"
+
+#include <unordered_map>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+// Symmetric 4x4 matrix, only the upper triangle is stored
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+
+	Quadric() { memset(this, 0, sizeof(*this)); }
+
+	// Squared distance to the plane n.p + d = 0
+	void addPlane(const glm::dvec3& n, double d, double weight) {
+		a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+		a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+		a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+		a33 += weight * d * d;
+	}
+
+	void add(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+	}
+
+	double evaluate(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			+ a22 * z * z + 2.0 * a23 * z
+			+ a33;
+	}
+};
+
+struct Collapse {
+	double cost;
+	int from, to;
+	unsigned int fromVersion, toVersion;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+struct PositionHash {
+	size_t operator()(const glm::vec3& p) const {
+		unsigned int h[3];
+		memcpy(h, &p[0], sizeof(h));
+		return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+	}
+};
+
+struct PositionEqual {
+	bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a == b; }
+};
+
+void meshBounds(const std::vector<glm::vec3>& positions, glm::vec3& center, float& radius)
+{
+	if (positions.empty())
+	{
+		center = glm::vec3(0.0f);
+		radius = 0.0f;
+		return;
+	}
+
+	glm::vec3 lo = positions[0], hi = positions[0];
+	for (size_t i = 1; i < positions.size(); ++i)
+	{
+		lo = glm::min(lo, positions[i]);
+		hi = glm::max(hi, positions[i]);
+	}
+	center = (lo + hi) * 0.5f;
+	radius = glm::length(hi - lo) * 0.5f;
+}
+
+static glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	return glm::cross(b - a, c - a);
+}
+
+static unsigned long long edgeKey(int a, int b)
+{
+	if (a > b)
+		std::swap(a, b);
+	return ((unsigned long long)a << 32) | (unsigned int)b;
+}
+
+float simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	size_t targetIndexCount, float maxError, std::vector<unsigned int>& result)
+{
+	glm::vec3 center;
+	float radius;
+	meshBounds(positions, center, radius);
+	if (radius <= 0.0f)
+		radius = 1.0f;
+
+	// Split vertices (UV/normal seams) are welded by position so the collapses see the
+	// real topology. Each welded vertex remembers one original vertex to emit.
+	std::unordered_map<glm::vec3, int, PositionHash, PositionEqual> welded;
+	std::vector<int> remap(positions.size());
+	std::vector<unsigned int> representative;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		std::unordered_map<glm::vec3, int, PositionHash, PositionEqual>::iterator it = welded.find(positions[i]);
+		if (it == welded.end())
+		{
+			it = welded.insert(std::make_pair(positions[i], (int)representative.size())).first;
+			representative.push_back((unsigned int)i);
+		}
+		remap[i] = it->second;
+	}
+
+	size_t vertexCount = representative.size();
+	size_t triangleCount = indices.size() / 3;
+
+	std::vector<int> corners(triangleCount * 3);	// welded vertex of each corner
+	std::vector<unsigned int> originals(indices.begin(), indices.begin() + triangleCount * 3);	// vertex emitted for each corner
+	std::vector<char> triangleAlive(triangleCount, 1);
+	std::vector<std::vector<int> > vertexTriangles(vertexCount);
+	std::vector<Quadric> quadrics(vertexCount);
+	std::unordered_map<unsigned long long, int> edgeUse;
+
+	size_t liveTriangles = 0;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+			corners[t * 3 + k] = remap[indices[t * 3 + k]];
+
+		int a = corners[t * 3], b = corners[t * 3 + 1], c = corners[t * 3 + 2];
+		if (a == b || b == c || a == c)
+		{
+			triangleAlive[t] = 0;
+			continue;
+		}
+		liveTriangles++;
+
+		glm::vec3 pa = positions[representative[a]], pb = positions[representative[b]], pc = positions[representative[c]];
+		glm::dvec3 n(triangleNormal(pa, pb, pc));
+		double area = glm::length(n);
+		if (area > 0.0)
+		{
+			n /= area;
+			Quadric q;
+			q.addPlane(n, -glm::dot(n, glm::dvec3(pa)), 1.0);
+			quadrics[a].add(q);
+			quadrics[b].add(q);
+			quadrics[c].add(q);
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			vertexTriangles[corners[t * 3 + k]].push_back((int)t);
+			edgeUse[edgeKey(corners[t * 3 + k], corners[t * 3 + (k + 1) % 3])]++;
+		}
+	}
+
+	// Open borders get an extra plane at right angles to their triangle, otherwise
+	// the silhouette of thin parts like the lamp's frame would be eaten first
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		if (!triangleAlive[t])
+			continue;
+		glm::vec3 p[3];
+		for (int k = 0; k < 3; ++k)
+			p[k] = positions[representative[corners[t * 3 + k]]];
+		glm::vec3 n = triangleNormal(p[0], p[1], p[2]);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			int a = corners[t * 3 + k], b = corners[t * 3 + (k + 1) % 3];
+			if (edgeUse[edgeKey(a, b)] != 1)
+				continue;
+
+			glm::dvec3 borderNormal(glm::cross(n, p[(k + 1) % 3] - p[k]));
+			double length = glm::length(borderNormal);
+			if (length <= 0.0)
+				continue;
+			borderNormal /= length;
+
+			Quadric q;
+			q.addPlane(borderNormal, -glm::dot(borderNormal, glm::dvec3(p[k])), 10.0);
+			quadrics[a].add(q);
+			quadrics[b].add(q);
+		}
+	}
+
+	std::vector<unsigned int> version(vertexCount, 0);
+	std::vector<char> vertexAlive(vertexCount, 1);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > heap;
+
+	// Queue the cheaper direction of collapsing the edge a-b
+	std::function<void(int, int)> pushEdge = [&](int a, int b) {
+		Quadric q = quadrics[a];
+		q.add(quadrics[b]);
+		double toB = q.evaluate(positions[representative[b]]);
+		double toA = q.evaluate(positions[representative[a]]);
+
+		Collapse collapse;
+		collapse.cost = std::max(0.0, std::min(toA, toB));
+		collapse.from = toB <= toA ? a : b;
+		collapse.to = toB <= toA ? b : a;
+		collapse.fromVersion = version[collapse.from];
+		collapse.toVersion = version[collapse.to];
+		heap.push(collapse);
+	};
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		if (!triangleAlive[t])
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			int a = corners[t * 3 + k], b = corners[t * 3 + (k + 1) % 3];
+			if (a < b || edgeUse[edgeKey(a, b)] == 1)
+				pushEdge(a, b);
+		}
+	}
+
+	double maxCost = (double)maxError * radius;
+	maxCost *= maxCost;
+	double worstCost = 0.0;
+
+	while (liveTriangles * 3 > targetIndexCount && !heap.empty())
+	{
+		Collapse collapse = heap.top();
+		heap.pop();
+
+		if (collapse.cost > maxCost)
+			break;
+
+		int from = collapse.from, to = collapse.to;
+		if (!vertexAlive[from] || !vertexAlive[to] ||
+			version[from] != collapse.fromVersion || version[to] != collapse.toVersion)
+			continue;
+
+		// Reject the collapse if any triangle that survives it would flip over
+		const glm::vec3& target = positions[representative[to]];
+		bool flips = false;
+		std::vector<int>& fromTriangles = vertexTriangles[from];
+		for (size_t i = 0; i < fromTriangles.size() && !flips; ++i)
+		{
+			int t = fromTriangles[i];
+			if (!triangleAlive[t])
+				continue;
+
+			int* c = &corners[t * 3];
+			if (c[0] == to || c[1] == to || c[2] == to)
+				continue;
+
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				before[k] = positions[representative[c[k]]];
+				after[k] = c[k] == from ? target : before[k];
+			}
+			glm::vec3 n0 = triangleNormal(before[0], before[1], before[2]);
+			glm::vec3 n1 = triangleNormal(after[0], after[1], after[2]);
+			if (glm::dot(n0, n1) <= 0.0f)
+				flips = true;
+		}
+		if (flips)
+			continue;
+
+		for (size_t i = 0; i < fromTriangles.size(); ++i)
+		{
+			int t = fromTriangles[i];
+			if (!triangleAlive[t])
+				continue;
+
+			int* c = &corners[t * 3];
+			if (c[0] == to || c[1] == to || c[2] == to)
+			{
+				triangleAlive[t] = 0;
+				liveTriangles--;
+				continue;
+			}
+
+			for (int k = 0; k < 3; ++k)
+			{
+				if (c[k] == from)
+				{
+					c[k] = to;
+					originals[t * 3 + k] = representative[to];
+				}
+			}
+			vertexTriangles[to].push_back(t);
+		}
+
+		fromTriangles.clear();
+		vertexAlive[from] = 0;
+		quadrics[to].add(quadrics[from]);
+		version[to]++;
+		worstCost = std::max(worstCost, collapse.cost);
+
+		// Everything around the merged vertex has a new cost now
+		std::vector<int>& toTriangles = vertexTriangles[to];
+		size_t kept = 0;
+		for (size_t i = 0; i < toTriangles.size(); ++i)
+		{
+			int t = toTriangles[i];
+			if (!triangleAlive[t])
+				continue;
+			toTriangles[kept++] = t;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				int other = corners[t * 3 + k];
+				if (other != to)
+					pushEdge(to, other);
+			}
+		}
+		toTriangles.resize(kept);
+	}
+
+	result.clear();
+	result.reserve(liveTriangles * 3);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		if (!triangleAlive[t])
+			continue;
+		for (int k = 0; k < 3; ++k)
+			result.push_back(originals[t * 3 + k]);
+	}
+
+	return (float)(sqrt(worstCost) / radius);
+}
@@ -0,0 +1,20 @@
+#ifndef _SIMPLIFY_H_
+#define _SIMPLIFY_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Quadric error metric edge collapse (Garland & Heckbert). Vertices are only ever
+// collapsed onto existing vertices, so the result is just a new index list and every
+// LOD can keep sharing the original vertex buffer.
+//
+// Stops once the index count reaches targetIndexCount or the next collapse would
+// cost more than maxError. Both maxError and the returned error are relative to the
+// mesh's bounding radius, so they mean the same thing for a lamp and a building.
+float simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	size_t targetIndexCount, float maxError, std::vector<unsigned int>& result);
+
+// Centre and radius of the sphere around the mesh's bounding box
+void meshBounds(const std::vector<glm::vec3>& positions, glm::vec3& center, float& radius);
+
+#endif
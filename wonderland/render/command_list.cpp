@@ -0,0 +1,121 @@
+#include "command_list.h"
+
+#include <cstring>
+
+CommandList::CommandList()
+{
+	clear();
+}
+
+void CommandList::clear()
+{
+	words.clear();
+	names.clear();
+	program = ~0u;
+	vertexArray = ~0u;
+	for (int i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+		textures[i] = ~0u;
+}
+
+void CommandList::useProgram(uint32_t program)
+{
+	if (this->program == program)
+		return;
+	this->program = program;
+	words.push_back(COMMAND_USE_PROGRAM);
+	words.push_back(program);
+}
+
+void CommandList::bindTexture(uint32_t unit, uint32_t texture)
+{
+	if (textures[unit] == texture)
+		return;
+	textures[unit] = texture;
+	words.push_back(COMMAND_BIND_TEXTURE);
+	words.push_back(unit);
+	words.push_back(texture);
+}
+
+void CommandList::bindVertexArray(uint32_t vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+		return;
+	this->vertexArray = vertexArray;
+	words.push_back(COMMAND_BIND_VERTEX_ARRAY);
+	words.push_back(vertexArray);
+}
+
+void CommandList::setMatrix(int32_t location, const glm::mat4& matrix)
+{
+	size_t at = words.size();
+	words.resize(at + 18);
+	words[at] = COMMAND_SET_MATRIX;
+	words[at + 1] = (uint32_t)location;
+	memcpy(&words[at + 2], &matrix[0][0], 16 * sizeof(float));
+}
+
+void CommandList::drawElements(uint32_t indexCount, size_t indexOffset, int32_t baseVertex)
+{
+	words.push_back(COMMAND_DRAW);
+	words.push_back(indexCount);
+	words.push_back((uint32_t)indexOffset);
+	words.push_back((uint32_t)baseVertex);
+}
+
+void CommandList::beginScope(const char* name)
+{
+	words.push_back(COMMAND_BEGIN_SCOPE);
+	words.push_back((uint32_t)names.size());
+	names.push_back(name);
+}
+
+void CommandList::endScope()
+{
+	words.push_back(COMMAND_END_SCOPE);
+}
+
+void CommandList::replay(GLStateCache& state, GpuProfiler* profiler) const
+{
+	const uint32_t* word = words.data();
+	const uint32_t* end = word + words.size();
+	while (word < end)
+	{
+		switch (word[0])
+		{
+		case COMMAND_USE_PROGRAM:
+			state.useProgram(word[1]);
+			word += 2;
+			break;
+		case COMMAND_BIND_TEXTURE:
+			state.bindTexture(GL_TEXTURE0 + word[1], word[2]);
+			word += 3;
+			break;
+		case COMMAND_BIND_VERTEX_ARRAY:
+			state.bindVertexArray(word[1]);
+			word += 2;
+			break;
+		case COMMAND_SET_MATRIX:
+			// The words are 4 byte aligned, same as floats
+			glUniformMatrix4fv((GLint)word[1], 1, GL_FALSE, (const GLfloat*)&word[2]);
+			word += 18;
+			break;
+		case COMMAND_DRAW:
+			state.drawElements(GL_TRIANGLES, (GLsizei)word[1], GL_UNSIGNED_INT, word[2], (GLint)word[3]);
+			word += 4;
+			break;
+		case COMMAND_BEGIN_SCOPE:
+			if (profiler)
+				profiler->begin(names[word[1]]);
+			word += 2;
+			break;
+		case COMMAND_END_SCOPE:
+			if (profiler)
+				profiler->end();
+			word += 1;
+			break;
+		default:
+			// Only happens if recording went wrong, nothing after it can be trusted
+			return;
+		}
+	}
+}
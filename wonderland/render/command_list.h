@@ -0,0 +1,53 @@
+#ifndef _COMMAND_LIST_H_
+#define _COMMAND_LIST_H_
+
+#include "gl_state.h"
+#include "gpu_profiler.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+enum CommandType {
+	COMMAND_USE_PROGRAM = 0,	// program
+	COMMAND_BIND_TEXTURE,		// unit, texture
+	COMMAND_BIND_VERTEX_ARRAY,	// vertex array
+	COMMAND_SET_MATRIX,			// location, 16 floats
+	COMMAND_DRAW,				// index count, index offset, base vertex
+	COMMAND_BEGIN_SCOPE,		// index into names
+	COMMAND_END_SCOPE,
+};
+
+// Draw commands written down instead of issued. Recording is plain data, so any
+// thread can do it, and only the GL thread replays it. Everything is packed as 32 bit
+// words, a draw with a new matrix comes to 22 of them.
+//
+// Binds are only recorded when they change within the list. Between lists the state
+// cache catches the repeats on replay.
+struct CommandList {
+	std::vector<uint32_t> words;
+	std::vector<const char*> names;	// profiler scopes, have to outlive the replay
+
+	// What the list has bound so far, so recording can skip repeats
+	uint32_t program;
+	uint32_t vertexArray;
+	uint32_t textures[GL_STATE_TEXTURE_UNITS];
+
+	CommandList();
+
+	void clear();
+
+	void useProgram(uint32_t program);
+	void bindTexture(uint32_t unit, uint32_t texture);	// unit is 0 to GL_STATE_TEXTURE_UNITS - 1
+	void bindVertexArray(uint32_t vertexArray);
+	void setMatrix(int32_t location, const glm::mat4& matrix);
+	void drawElements(uint32_t indexCount, size_t indexOffset, int32_t baseVertex);
+	void beginScope(const char* name);
+	void endScope();
+
+	// GL thread only. Triangles with 32 bit indices, which is all the scene has.
+	// Scopes are skipped without a profiler.
+	void replay(GLStateCache& state, GpuProfiler* profiler = NULL) const;
+};
+
+#endif
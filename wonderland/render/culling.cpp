@@ -0,0 +1,267 @@
+#include "culling.h"
+#include <core/trace.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLING_USE_SSE
+#endif
+
+// Leaves hold at most this many objects
+#define BVH_LEAF_SIZE (4)
+
+Aabb transformAabb(const Aabb& bounds, const glm::mat4& transform)
+{
+	// Centre goes through the transform, the extent through its absolute value
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+	glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+	glm::vec3 newExtent;
+	for (int i = 0; i < 3; ++i)
+		newExtent[i] = fabsf(transform[0][i]) * extent.x + fabsf(transform[1][i]) * extent.y + fabsf(transform[2][i]) * extent.z;
+
+	Aabb result;
+	result.min = newCenter - newExtent;
+	result.max = newCenter + newExtent;
+	return result;
+}
+
+Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann: each plane is the w row plus or minus one of the others
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	glm::vec4 planes[8] = {
+		row[3] + row[0], row[3] - row[0],
+		row[3] + row[1], row[3] - row[1],
+		row[3] + row[2], row[3] - row[2],
+	};
+	planes[6] = planes[7] = planes[5];
+
+	Frustum frustum;
+	for (int i = 0; i < 8; ++i)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		glm::vec4 plane = length > 0.0f ? planes[i] / length : planes[i];
+		frustum.nx[i] = plane.x;
+		frustum.ny[i] = plane.y;
+		frustum.nz[i] = plane.z;
+		frustum.d[i] = plane.w;
+	}
+	return frustum;
+}
+
+CullResult testAabb(const Frustum& frustum, const Aabb& bounds)
+{
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+#ifdef CULLING_USE_SSE
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	__m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	int outside = 0, intersecting = 0;
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 nx = _mm_load_ps(frustum.nx + i);
+		__m128 ny = _mm_load_ps(frustum.ny + i);
+		__m128 nz = _mm_load_ps(frustum.nz + i);
+
+		// Signed distance of the centre, and how far the box reaches towards the plane
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+			_mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(frustum.d + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+			_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+	}
+	if (outside)
+		return CULL_OUTSIDE;
+	return intersecting ? CULL_INTERSECTS : CULL_INSIDE;
+#else
+	bool intersecting = false;
+	for (int i = 0; i < 6; ++i)
+	{
+		float distance = frustum.nx[i] * center.x + frustum.ny[i] * center.y + frustum.nz[i] * center.z + frustum.d[i];
+		float radius = fabsf(frustum.nx[i]) * extent.x + fabsf(frustum.ny[i]) * extent.y + fabsf(frustum.nz[i]) * extent.z;
+		if (distance + radius < 0.0f)
+			return CULL_OUTSIDE;
+		if (distance - radius < 0.0f)
+			intersecting = true;
+	}
+	return intersecting ? CULL_INTERSECTS : CULL_INSIDE;
+#endif
+}
+
+static Aabb merge(const Aabb& a, const Aabb& b)
+{
+	Aabb result;
+	result.min = glm::min(a.min, b.min);
+	result.max = glm::max(a.max, b.max);
+	return result;
+}
+
+Bvh::Bvh()
+	: dirty(false)
+{
+}
+
+int Bvh::add(const Aabb& bounds)
+{
+	objectBounds.push_back(bounds);
+	return (int)objectBounds.size() - 1;
+}
+
+void Bvh::update(int object, const Aabb& bounds)
+{
+	objectBounds[object] = bounds;
+	dirty = true;
+}
+
+void Bvh::build()
+{
+	nodes.clear();
+	objectOrder.resize(objectBounds.size());
+	for (size_t i = 0; i < objectOrder.size(); ++i)
+		objectOrder[i] = (int)i;
+
+	if (!objectOrder.empty())
+	{
+		nodes.reserve(objectOrder.size() * 2);
+		nodes.push_back(Node());
+		buildNode(0, 0, (int)objectOrder.size());
+	}
+	dirty = false;
+}
+
+namespace {
+struct CenterLess {
+	const std::vector<Aabb>* bounds;
+	int axis;
+	bool operator()(int a, int b) const
+	{
+		return (*bounds)[a].min[axis] + (*bounds)[a].max[axis] < (*bounds)[b].min[axis] + (*bounds)[b].max[axis];
+	}
+};
+}
+
+void Bvh::buildNode(int index, int first, int count)
+{
+	Aabb bounds = objectBounds[objectOrder[first]];
+	for (int i = 1; i < count; ++i)
+		bounds = merge(bounds, objectBounds[objectOrder[first + i]]);
+	nodes[index].bounds = bounds;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return;
+	}
+
+	// Split at the median along the longest axis
+	glm::vec3 size = bounds.max - bounds.min;
+	CenterLess less;
+	less.bounds = &objectBounds;
+	less.axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	int half = count / 2;
+	std::nth_element(objectOrder.begin() + first, objectOrder.begin() + first + half, objectOrder.begin() + first + count, less);
+
+	// Children sit next to each other so an inner node only needs the first one
+	int children = (int)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[index].first = children;
+	nodes[index].count = 0;
+
+	buildNode(children, first, half);
+	buildNode(children + 1, first + half, count - half);
+}
+
+void Bvh::refit()
+{
+	if (!dirty)
+		return;
+
+	// Children come after parents, so going backwards every child is done first
+	for (int i = (int)nodes.size() - 1; i >= 0; --i)
+	{
+		Node& node = nodes[i];
+		if (node.count > 0)
+		{
+			node.bounds = objectBounds[objectOrder[node.first]];
+			for (int j = 1; j < node.count; ++j)
+				node.bounds = merge(node.bounds, objectBounds[objectOrder[node.first + j]]);
+		}
+		else
+			node.bounds = merge(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+	}
+	dirty = false;
+}
+
+void Bvh::markVisible(const Node& node, std::vector<char>& visible) const
+{
+	if (node.count > 0)
+	{
+		for (int i = 0; i < node.count; ++i)
+			visible[objectOrder[node.first + i]] = 1;
+		return;
+	}
+	markVisible(nodes[node.first], visible);
+	markVisible(nodes[node.first + 1], visible);
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<char>& visible, CullStats& stats) const
+{
+	TRACE_ZONE("frustum cull");
+	visible.assign(objectBounds.size(), 0);
+	memset(&stats, 0, sizeof(stats));
+
+	// Depth is about log2(objects / leaf size), this is plenty
+	int stack[64];
+	int top = 0;
+	if (!nodes.empty())
+		stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		stats.nodesTested++;
+
+		CullResult result = testAabb(frustum, node.bounds);
+		if (result == CULL_OUTSIDE)
+			continue;
+		if (result == CULL_INSIDE)
+		{
+			markVisible(node, visible);
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+			continue;
+		}
+
+		for (int i = 0; i < node.count; ++i)
+		{
+			int object = objectOrder[node.first + i];
+			stats.objectsTested++;
+			if (testAabb(frustum, objectBounds[object]) != CULL_OUTSIDE)
+				visible[object] = 1;
+		}
+	}
+
+	for (size_t i = 0; i < visible.size(); ++i)
+		stats.objectsVisible += visible[i];
+	stats.objectsCulled = (int)visible.size() - stats.objectsVisible;
+}
@@ -0,0 +1,74 @@
+#ifndef _CULLING_H_
+#define _CULLING_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Bounds of a local space box once it has gone through a transform
+Aabb transformAabb(const Aabb& bounds, const glm::mat4& transform);
+
+// The six clip planes of a view-projection, stored a component at a time so
+// four planes can be tested against a box in one go. Two slots are padding
+// (copies of the far plane).
+struct Frustum {
+	alignas(16) float nx[8];
+	alignas(16) float ny[8];
+	alignas(16) float nz[8];
+	alignas(16) float d[8];
+};
+
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+enum CullResult { CULL_OUTSIDE = 0, CULL_INTERSECTS = 1, CULL_INSIDE = 2 };
+
+CullResult testAabb(const Frustum& frustum, const Aabb& bounds);
+
+struct CullStats {
+	int nodesTested;
+	int objectsTested;
+	int objectsVisible;
+	int objectsCulled;
+};
+
+// Bounding volume hierarchy over world space object bounds. Objects are added once
+// and built into the tree; moving objects update their bounds and the tree gets
+// refit (not rebuilt) before culling, which is fine as long as things dont move
+// far from where they started.
+struct Bvh {
+	struct Node {
+		Aabb bounds;
+		int first;	// first child for inner nodes, first entry in objectOrder for leaves
+		int count;	// objects in a leaf, 0 for inner nodes (children are first and first + 1)
+	};
+
+	std::vector<Aabb> objectBounds;
+	std::vector<Node> nodes;		// children always come after their parent
+	std::vector<int> objectOrder;	// leaf contents
+	bool dirty;						// bounds changed since the last refit
+
+	Bvh();
+
+	// Returns the object's id, for update and the visibility results
+	int add(const Aabb& bounds);
+	void update(int object, const Aabb& bounds);
+
+	// Top down median split, call after adding objects
+	void build();
+	// Recomputes node bounds after updates, call before cull. Does nothing if nothing moved.
+	void refit();
+
+	// visible[object] is set to 1 or 0. Subtrees that are entirely inside skip the
+	// remaining plane tests, subtrees entirely outside skip their objects.
+	void cull(const Frustum& frustum, std::vector<char>& visible, CullStats& stats) const;
+
+private:
+	void buildNode(int index, int first, int count);
+	void markVisible(const Node& node, std::vector<char>& visible) const;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "gl_resource.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+
+static const char* resourceTypeNames[GL_RESOURCE_TYPE_COUNT] = {
+	"buffer", "texture", "vertex array", "framebuffer", "renderbuffer"
+};
+
+const char* glResourceTypeName(int type)
+{
+	return type >= 0 && type < GL_RESOURCE_TYPE_COUNT ? resourceTypeNames[type] : "unknown";
+}
+
+size_t glTextureBytes(GLenum internalFormat, int width, int height, int levels)
+{
+	size_t texelBytes = 4;
+	switch (internalFormat)
+	{
+	case GL_R8:
+	case GL_RED:
+		texelBytes = 1;
+		break;
+	case GL_RG8:
+	case GL_RG:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		texelBytes = 2;
+		break;
+	case GL_RGBA16F:
+	case GL_RG32F:
+		texelBytes = 8;
+		break;
+	case GL_RGBA32F:
+		texelBytes = 16;
+		break;
+	default:
+		break;		// RGB(A)8, R32F and the 24/32 bit depth formats
+	}
+
+	size_t bytes = 0;
+	for (int level = 0; levels == 0 || level < levels; ++level)
+	{
+		bytes += (size_t)width * height * texelBytes;
+		if (width == 1 && height == 1)
+			break;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return bytes;
+}
+
+static uint64_t resourceKey(GLResourceType type, GLuint id)
+{
+	return (uint64_t)type << 32 | id;
+}
+
+GLResourceTracker::GLResourceTracker()
+{
+	memset(&current, 0, sizeof(current));
+	contextGone = false;
+}
+
+GLResourceTracker& glResources()
+{
+	// Never destroyed, so handles in globals can still unregister on their way out
+	static GLResourceTracker* tracker = new GLResourceTracker;
+	return *tracker;
+}
+
+GLuint GLResourceTracker::create(GLResourceType type, const std::string& owner)
+{
+	GLuint id = 0;
+	switch (type)
+	{
+	case GL_RESOURCE_BUFFER: glGenBuffers(1, &id); break;
+	case GL_RESOURCE_TEXTURE: glGenTextures(1, &id); break;
+	case GL_RESOURCE_VERTEX_ARRAY: glGenVertexArrays(1, &id); break;
+	case GL_RESOURCE_FRAMEBUFFER: glGenFramebuffers(1, &id); break;
+	case GL_RESOURCE_RENDERBUFFER: glGenRenderbuffers(1, &id); break;
+	default: break;
+	}
+	if (id == 0)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Entry entry;
+	entry.type = type;
+	entry.owner = owner;
+	entry.bytes = 0;
+	live[resourceKey(type, id)] = entry;
+	current.count[type]++;
+	return id;
+}
+
+void GLResourceTracker::resize(GLResourceType type, GLuint id, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<uint64_t, Entry>::iterator found = live.find(resourceKey(type, id));
+	if (found == live.end())
+		return;
+	current.bytes[type] += bytes - found->second.bytes;
+	current.totalBytes += bytes - found->second.bytes;
+	if (current.totalBytes > current.peakBytes)
+		current.peakBytes = current.totalBytes;
+	found->second.bytes = bytes;
+}
+
+void GLResourceTracker::destroy(GLResourceType type, GLuint id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<uint64_t, Entry>::iterator found = live.find(resourceKey(type, id));
+		if (found != live.end())
+		{
+			current.count[type]--;
+			current.bytes[type] -= found->second.bytes;
+			current.totalBytes -= found->second.bytes;
+			live.erase(found);
+		}
+		if (contextGone)
+			return;
+	}
+
+	switch (type)
+	{
+	case GL_RESOURCE_BUFFER: glDeleteBuffers(1, &id); break;
+	case GL_RESOURCE_TEXTURE: glDeleteTextures(1, &id); break;
+	case GL_RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &id); break;
+	case GL_RESOURCE_FRAMEBUFFER: glDeleteFramebuffers(1, &id); break;
+	case GL_RESOURCE_RENDERBUFFER: glDeleteRenderbuffers(1, &id); break;
+	default: break;
+	}
+}
+
+GLResourceTotals GLResourceTracker::totals()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return current;
+}
+
+void GLResourceTracker::printStats()
+{
+	GLResourceTotals t = totals();
+	int objects = 0;
+	for (int i = 0; i < GL_RESOURCE_TYPE_COUNT; ++i)
+		objects += t.count[i];
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "GL memory: " << t.totalBytes / (1024.0 * 1024.0) << " MB in " << objects << " objects (";
+	for (int i = 0; i < GL_RESOURCE_TYPE_COUNT; ++i)
+		std::cout << (i ? ", " : "") << glResourceTypeName(i) << " " << t.count[i] << " / " << t.bytes[i] / (1024.0 * 1024.0) << " MB";
+	std::cout << "), peak " << t.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+int GLResourceTracker::shutdown()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	contextGone = true;
+	if (live.empty())
+	{
+		std::cout << "GL resources: all freed" << std::endl;
+		return 0;
+	}
+
+	// Grouped so one forgotten model shows up as one line, not hundreds
+	struct Leak {
+		int count[GL_RESOURCE_TYPE_COUNT];
+		size_t bytes;
+	};
+	std::map<std::string, Leak> byOwner;
+	for (std::map<uint64_t, Entry>::const_iterator i = live.begin(); i != live.end(); ++i)
+	{
+		std::map<std::string, Leak>::iterator leak = byOwner.find(i->second.owner);
+		if (leak == byOwner.end())
+		{
+			Leak empty;
+			memset(&empty, 0, sizeof(empty));
+			leak = byOwner.insert(std::make_pair(i->second.owner, empty)).first;
+		}
+		leak->second.count[i->second.type]++;
+		leak->second.bytes += i->second.bytes;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "GL resources: " << live.size() << " leaked, " << current.totalBytes / 1024.0 << " KB" << std::endl;
+	for (std::map<std::string, Leak>::const_iterator i = byOwner.begin(); i != byOwner.end(); ++i)
+	{
+		std::cout << "  " << i->first << ":";
+		for (int type = 0; type < GL_RESOURCE_TYPE_COUNT; ++type)
+			if (i->second.count[type])
+				std::cout << " " << i->second.count[type] << " " << glResourceTypeName(type);
+		std::cout << ", " << i->second.bytes / 1024.0 << " KB" << std::endl;
+	}
+	return (int)live.size();
+}
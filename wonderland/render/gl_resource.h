@@ -0,0 +1,120 @@
+#ifndef _GL_RESOURCE_H_
+#define _GL_RESOURCE_H_
+
+#include <glad/gl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+enum GLResourceType {
+	GL_RESOURCE_BUFFER = 0,
+	GL_RESOURCE_TEXTURE,
+	GL_RESOURCE_VERTEX_ARRAY,
+	GL_RESOURCE_FRAMEBUFFER,
+	GL_RESOURCE_RENDERBUFFER,
+	GL_RESOURCE_TYPE_COUNT
+};
+
+const char* glResourceTypeName(int type);
+
+// Rough bytes the driver keeps for a texture or renderbuffer. RGB is counted as 4 bytes
+// a texel since that's how most drivers store it. levels 0 means the whole mip chain.
+size_t glTextureBytes(GLenum internalFormat, int width, int height, int levels = 1);
+
+struct GLResourceTotals {
+	int count[GL_RESOURCE_TYPE_COUNT];
+	size_t bytes[GL_RESOURCE_TYPE_COUNT];
+	size_t totalBytes;
+	size_t peakBytes;	// most there has been live at once
+};
+
+// Every GL object made through a GLHandle, with what it's for and roughly how big it
+// is. Totals are kept as things change, so reading them is cheap enough for every
+// frame. Whatever is still alive when the context goes is a leak.
+struct GLResourceTracker {
+	struct Entry {
+		GLResourceType type;
+		std::string owner;	// the asset or system it belongs to
+		size_t bytes;
+	};
+
+	std::mutex mutex;
+	std::map<uint64_t, Entry> live;		// by type and id
+	GLResourceTotals current;
+	bool contextGone;
+
+	GLResourceTracker();
+
+	// Makes a new object and registers it. 0 if GL didn't give one back.
+	GLuint create(GLResourceType type, const std::string& owner);
+	// Storage changed, after glBufferData / glTexImage2D and friends
+	void resize(GLResourceType type, GLuint id, size_t bytes);
+	// Unregisters it, and deletes it unless the context has already gone
+	void destroy(GLResourceType type, GLuint id);
+
+	GLResourceTotals totals();
+
+	// One line of live totals by type, e.g. "GL memory: 41.3 MB in 18 objects (buffer 6 / 36.1 MB ...)"
+	void printStats();
+
+	// Call just before the context goes. Lists anything still alive as a leak, grouped
+	// by owner, and returns how many there were. Handles let go after this only
+	// unregister, there's nothing left to delete them from.
+	int shutdown();
+};
+
+GLResourceTracker& glResources();
+
+// Owns one GL object, which is deleted by reset or when the handle goes. Move only.
+// Converts to GLuint so it can be handed straight to GL.
+template <GLResourceType Type>
+struct GLHandle {
+	GLuint id;
+
+	GLHandle() : id(0) {}
+	GLHandle(GLHandle&& other) noexcept : id(other.id) { other.id = 0; }
+	~GLHandle() { reset(); }
+
+	GLHandle& operator=(GLHandle&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			id = other.id;
+			other.id = 0;
+		}
+		return *this;
+	}
+
+	// Deletes whatever it held and makes a new one. Give it a size with setBytes once
+	// its storage is allocated.
+	void create(const std::string& owner)
+	{
+		reset();
+		id = glResources().create(Type, owner);
+	}
+
+	void setBytes(size_t bytes) { glResources().resize(Type, id, bytes); }
+
+	void reset()
+	{
+		if (id)
+			glResources().destroy(Type, id);
+		id = 0;
+	}
+
+	operator GLuint() const { return id; }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+};
+
+typedef GLHandle<GL_RESOURCE_BUFFER> GLBuffer;
+typedef GLHandle<GL_RESOURCE_TEXTURE> GLTexture;
+typedef GLHandle<GL_RESOURCE_VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GL_RESOURCE_FRAMEBUFFER> GLFramebuffer;
+typedef GLHandle<GL_RESOURCE_RENDERBUFFER> GLRenderbuffer;
+
+#endif
@@ -0,0 +1,175 @@
+#include "gl_state.h"
+
+#include <iostream>
+#include <cstring>
+
+void GLCallStats::reset()
+{
+	memset(issued, 0, sizeof(issued));
+	memset(elided, 0, sizeof(elided));
+	triangles = 0;
+}
+
+int GLCallStats::totalIssued() const
+{
+	int total = 0;
+	for (int i = 0; i < GL_CALL_KIND_COUNT; ++i)
+		total += issued[i];
+	return total;
+}
+
+int GLCallStats::totalElided() const
+{
+	int total = 0;
+	for (int i = 0; i < GL_CALL_KIND_COUNT; ++i)
+		total += elided[i];
+	return total;
+}
+
+const char* glCallKindName(int kind)
+{
+	static const char* names[GL_CALL_KIND_COUNT] = {
+		"program", "vao", "buffer", "activeTexture", "texture", "framebuffer", "viewport", "cullFace", "draw"
+	};
+	return kind >= 0 && kind < GL_CALL_KIND_COUNT ? names[kind] : "?";
+}
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+	frame.reset();
+	lastFrame.reset();
+}
+
+void GLStateCache::invalidate()
+{
+	boundProgram = boundVertexArray = boundArrayBuffer = boundElementBuffer = boundFramebuffer = (GLuint)-1;
+	boundUnit = 0;
+	memset(boundTextures, 0xff, sizeof(boundTextures));
+	memset(boundViewport, 0xff, sizeof(boundViewport));
+	boundCullFace = 0;
+}
+
+void GLStateCache::endFrame()
+{
+	lastFrame = frame;
+	frame.reset();
+}
+
+void GLStateCache::printStats() const
+{
+	std::cout << "GL calls: " << lastFrame.totalIssued() << " issued, " << lastFrame.totalElided() << " elided (";
+	for (int i = 0; i < GL_CALL_KIND_COUNT; ++i)
+		std::cout << (i ? " " : "") << glCallKindName(i) << " " << lastFrame.issued[i] << "/" << lastFrame.elided[i];
+	std::cout << "), " << lastFrame.triangles << " triangles" << std::endl;
+}
+
+// Counts the call one way or the other and says whether it needs making
+bool GLStateCache::record(int kind, bool differs)
+{
+	if (differs)
+	{
+		frame.issued[kind]++;
+		return true;
+	}
+	frame.elided[kind]++;
+	return false;
+}
+
+void GLStateCache::useProgram(GLuint id)
+{
+	if (record(GL_CALL_USE_PROGRAM, id != boundProgram))
+		glUseProgram(id);
+	boundProgram = id;
+}
+
+void GLStateCache::bindVertexArray(GLuint id)
+{
+	if (record(GL_CALL_BIND_VERTEX_ARRAY, id != boundVertexArray))
+	{
+		glBindVertexArray(id);
+		// Element buffer comes along with the vertex array, dont know what it is now
+		boundElementBuffer = (GLuint)-1;
+	}
+	boundVertexArray = id;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint id)
+{
+	GLuint* bound = target == GL_ARRAY_BUFFER ? &boundArrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? &boundElementBuffer : NULL;
+	if (bound == NULL)
+	{
+		// Not tracked, always goes through
+		frame.issued[GL_CALL_BIND_BUFFER]++;
+		glBindBuffer(target, id);
+		return;
+	}
+	if (record(GL_CALL_BIND_BUFFER, id != *bound))
+		glBindBuffer(target, id);
+	*bound = id;
+}
+
+void GLStateCache::activeTexture(GLenum unit)
+{
+	if (record(GL_CALL_ACTIVE_TEXTURE, unit != boundUnit))
+		glActiveTexture(unit);
+	boundUnit = unit;
+}
+
+void GLStateCache::bindTexture(GLenum unit, GLuint id)
+{
+	int index = (int)(unit - GL_TEXTURE0);
+	if (index < 0 || index >= GL_STATE_TEXTURE_UNITS)
+	{
+		frame.issued[GL_CALL_ACTIVE_TEXTURE]++;
+		frame.issued[GL_CALL_BIND_TEXTURE]++;
+		glActiveTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, id);
+		boundUnit = unit;
+		return;
+	}
+
+	// Only switch units if the bind is actually going to happen
+	if (boundTextures[index] == id)
+	{
+		frame.elided[GL_CALL_BIND_TEXTURE]++;
+		return;
+	}
+	activeTexture(unit);
+	frame.issued[GL_CALL_BIND_TEXTURE]++;
+	glBindTexture(GL_TEXTURE_2D, id);
+	boundTextures[index] = id;
+}
+
+void GLStateCache::bindFramebuffer(GLuint id)
+{
+	if (record(GL_CALL_BIND_FRAMEBUFFER, id != boundFramebuffer))
+		glBindFramebuffer(GL_FRAMEBUFFER, id);
+	boundFramebuffer = id;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint rect[4] = { x, y, width, height };
+	if (record(GL_CALL_VIEWPORT, memcmp(rect, boundViewport, sizeof(rect)) != 0))
+		glViewport(x, y, width, height);
+	memcpy(boundViewport, rect, sizeof(rect));
+}
+
+void GLStateCache::cullFace(GLenum face)
+{
+	if (record(GL_CALL_CULL_FACE, face != boundCullFace))
+		glCullFace(face);
+	boundCullFace = face;
+}
+
+void GLStateCache::drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset, GLint baseVertex)
+{
+	frame.issued[GL_CALL_DRAW]++;
+	if (mode == GL_TRIANGLES)
+		frame.triangles += count / 3;
+	if (baseVertex != 0)
+		glDrawElementsBaseVertex(mode, count, type, (void*)offset, baseVertex);
+	else
+		glDrawElements(mode, count, type, (void*)offset);
+}
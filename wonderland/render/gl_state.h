@@ -0,0 +1,78 @@
+#ifndef _GL_STATE_H_
+#define _GL_STATE_H_
+
+#include <glad/gl.h>
+#include <cstddef>
+
+#define GL_STATE_TEXTURE_UNITS (8)
+
+// Kinds of GL call the state cache goes through, for the per frame counts
+enum GLCallKind {
+	GL_CALL_USE_PROGRAM = 0,
+	GL_CALL_BIND_VERTEX_ARRAY,
+	GL_CALL_BIND_BUFFER,
+	GL_CALL_ACTIVE_TEXTURE,
+	GL_CALL_BIND_TEXTURE,
+	GL_CALL_BIND_FRAMEBUFFER,
+	GL_CALL_VIEWPORT,
+	GL_CALL_CULL_FACE,
+	GL_CALL_DRAW,
+	GL_CALL_KIND_COUNT
+};
+
+struct GLCallStats {
+	int issued[GL_CALL_KIND_COUNT];
+	int elided[GL_CALL_KIND_COUNT];	// calls dropped because the state was already set
+	int triangles;		// drawn by GL_TRIANGLES draws
+
+	void reset();
+	int totalIssued() const;
+	int totalElided() const;
+};
+
+const char* glCallKindName(int kind);
+
+// Remembers what is bound and skips calls that wouldnt change anything. Only works
+// if every bind in the frame goes through here, so anything that binds behind its
+// back (texture uploads, loading code) has to call invalidate() afterwards.
+struct GLStateCache {
+	GLuint boundProgram;
+	GLuint boundVertexArray;
+	GLuint boundArrayBuffer;
+	GLuint boundElementBuffer;	// part of the vertex array state, reset when that changes
+	GLuint boundFramebuffer;
+	GLenum boundUnit;
+	GLuint boundTextures[GL_STATE_TEXTURE_UNITS];
+	GLint boundViewport[4];
+	GLenum boundCullFace;
+
+	GLCallStats frame;		// counts so far this frame
+	GLCallStats lastFrame;	// counts for the previous whole frame
+
+	GLStateCache();
+
+	// Forget everything, the next call of each kind always goes to GL. Unknown state
+	// is kept as values GL never hands out (~0 ids, unit/face 0) so nothing matches them.
+	void invalidate();
+
+	// Moves this frame's counts into lastFrame and starts counting again
+	void endFrame();
+
+	// One line summary of lastFrame, e.g. "GL calls: 40 issued, 112 elided (program 3/20 ...)"
+	void printStats() const;
+
+	void useProgram(GLuint id);
+	void bindVertexArray(GLuint id);
+	void bindBuffer(GLenum target, GLuint id);
+	void bindTexture(GLenum unit, GLuint id);	// unit is GL_TEXTURE0 + n, 2D textures only
+	void bindFramebuffer(GLuint id);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void cullFace(GLenum face);
+	void drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset, GLint baseVertex = 0);
+
+private:
+	void activeTexture(GLenum unit);
+	bool record(int kind, bool differs);
+};
+
+#endif
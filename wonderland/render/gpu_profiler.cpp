@@ -0,0 +1,271 @@
+#include "gpu_profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+// Not in the 3.3 loader either
+#define PROFILER_DEBUG_SOURCE_APPLICATION 0x824A
+
+static bool hasDebugGroups()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 3))
+		return true;
+
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; ++i)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, "GL_KHR_debug") == 0)
+			return true;
+	}
+	return false;
+}
+
+bool GpuProfiler::initialize(GLADloadfunc loader)
+{
+	frame = 0;
+	dropped = 0;
+	open.clear();
+	series.clear();
+	seriesIndex.clear();
+	for (int i = 0; i < GPU_PROFILER_FRAMES; ++i)
+	{
+		glGenQueries(GPU_PROFILER_SCOPES * 2, frames[i].queries);
+		frames[i].scopeCount = 0;
+		frames[i].lastQuery = 0;
+	}
+
+	pushDebugGroup = NULL;
+	popDebugGroup = NULL;
+	if (loader && hasDebugGroups())
+	{
+		// Core names it without a suffix, GLES and some drivers only have the KHR one
+		pushDebugGroup = (PushDebugGroupProc)loader("glPushDebugGroup");
+		popDebugGroup = (PopDebugGroupProc)loader("glPopDebugGroup");
+		if (pushDebugGroup == NULL || popDebugGroup == NULL)
+		{
+			pushDebugGroup = (PushDebugGroupProc)loader("glPushDebugGroupKHR");
+			popDebugGroup = (PopDebugGroupProc)loader("glPopDebugGroupKHR");
+		}
+		if (pushDebugGroup == NULL || popDebugGroup == NULL)
+		{
+			pushDebugGroup = NULL;
+			popDebugGroup = NULL;
+		}
+	}
+
+	std::cout << "GPU profiler: " << GPU_PROFILER_FRAMES << " frames of timestamp queries, debug groups "
+		<< (pushDebugGroup ? "on" : "not supported") << std::endl;
+	return true;
+}
+
+void GpuProfiler::beginFrame()
+{
+	Frame& current = frames[frame];
+	collect(current);
+	current.scopeCount = 0;
+	current.lastQuery = 0;
+	open.clear();
+}
+
+void GpuProfiler::endFrame()
+{
+	while (!open.empty())
+		end();
+	frame = (frame + 1) % GPU_PROFILER_FRAMES;
+}
+
+void GpuProfiler::begin(const char* name)
+{
+	if (pushDebugGroup)
+		pushDebugGroup(PROFILER_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+	Frame& current = frames[frame];
+	if (current.scopeCount == GPU_PROFILER_SCOPES)
+	{
+		open.push_back(-1);
+		return;
+	}
+
+	int index = current.scopeCount++;
+	current.scopes[index].name = name;
+	current.scopes[index].parent = -1;
+	for (size_t i = open.size(); i > 0; --i)
+	{
+		if (open[i - 1] >= 0)
+		{
+			current.scopes[index].parent = open[i - 1];
+			break;
+		}
+	}
+	open.push_back(index);
+
+	current.lastQuery = current.queries[index * 2];
+	glQueryCounter(current.lastQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::end()
+{
+	if (open.empty())
+		return;
+
+	int index = open.back();
+	open.pop_back();
+	if (index >= 0)
+	{
+		Frame& current = frames[frame];
+		current.lastQuery = current.queries[index * 2 + 1];
+		glQueryCounter(current.lastQuery, GL_TIMESTAMP);
+	}
+
+	if (popDebugGroup)
+		popDebugGroup();
+}
+
+void GpuProfiler::collect(Frame& finished)
+{
+	if (finished.scopeCount == 0)
+		return;
+
+	// Never wait on the GPU here, if it's this far behind the frame is just lost
+	GLint available = 0;
+	glGetQueryObjectiv(finished.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		++dropped;
+		return;
+	}
+
+	// Parents always come before their children, so their paths are ready first
+	std::vector<std::string> paths(finished.scopeCount);
+	std::vector<int> depths(finished.scopeCount);
+	std::map<std::string, double> totals;
+	std::vector<std::string> order;
+	for (int i = 0; i < finished.scopeCount; ++i)
+	{
+		const Scope& scope = finished.scopes[i];
+		paths[i] = scope.parent < 0 ? scope.name : paths[scope.parent] + "/" + scope.name;
+		depths[i] = scope.parent < 0 ? 0 : depths[scope.parent] + 1;
+
+		GLuint64 start = 0, stop = 0;
+		glGetQueryObjectui64v(finished.queries[i * 2], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(finished.queries[i * 2 + 1], GL_QUERY_RESULT, &stop);
+		double ms = stop > start ? (stop - start) / 1000000.0 : 0.0;
+
+		if (totals.find(paths[i]) == totals.end())
+			order.push_back(paths[i]);
+		totals[paths[i]] += ms;
+
+		if (seriesIndex.find(paths[i]) == seriesIndex.end())
+		{
+			Series added;
+			added.path = paths[i];
+			added.depth = depths[i];
+			added.next = 0;
+			seriesIndex[paths[i]] = series.size();
+			series.push_back(added);
+		}
+	}
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		Series& s = series[seriesIndex[order[i]]];
+		float ms = (float)totals[order[i]];
+		if (s.samples.size() < GPU_PROFILER_HISTORY)
+			s.samples.push_back(ms);
+		else
+			s.samples[s.next] = ms;
+		s.next = (s.next + 1) % GPU_PROFILER_HISTORY;
+	}
+}
+
+void GpuProfiler::stats(std::vector<GpuScopeStats>& out) const
+{
+	out.clear();
+	std::vector<float> sorted;
+	for (size_t i = 0; i < series.size(); ++i)
+	{
+		const Series& s = series[i];
+		if (s.samples.empty())
+			continue;
+
+		sorted.assign(s.samples.begin(), s.samples.end());
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (size_t j = 0; j < sorted.size(); ++j)
+			sum += sorted[j];
+
+		GpuScopeStats scope;
+		scope.path = s.path;
+		scope.depth = s.depth;
+		scope.samples = (int)sorted.size();
+		scope.average = sum / sorted.size();
+		scope.median = sorted[(sorted.size() - 1) / 2];
+		scope.p95 = sorted[(size_t)((sorted.size() - 1) * 0.95)];
+		scope.max = sorted.back();
+		out.push_back(scope);
+	}
+}
+
+float GpuProfiler::latest(const std::string& path) const
+{
+	std::map<std::string, size_t>::const_iterator found = seriesIndex.find(path);
+	if (found == seriesIndex.end())
+		return 0.0f;
+	// next has only ever gone up by one per sample, so the one before it is the newest
+	const Series& s = series[found->second];
+	return s.samples.empty() ? 0.0f : s.samples[(s.next + GPU_PROFILER_HISTORY - 1) % GPU_PROFILER_HISTORY];
+}
+
+void GpuProfiler::printStats() const
+{
+	std::vector<GpuScopeStats> scopes;
+	stats(scopes);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "GPU ms (average / p95):";
+	for (size_t i = 0; i < scopes.size(); ++i)
+	{
+		size_t slash = scopes[i].path.rfind('/');
+		std::string name = slash == std::string::npos ? scopes[i].path : scopes[i].path.substr(slash + 1);
+		std::cout << " " << std::string(scopes[i].depth, '>') << name << " " << scopes[i].average << "/" << scopes[i].p95;
+	}
+	if (dropped > 0)
+		std::cout << " (" << dropped << " frames dropped)";
+	std::cout << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+}
+
+bool GpuProfiler::writeCsv(const std::string& filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "Couldn't open " << filename << " for the GPU profile" << std::endl;
+		return false;
+	}
+
+	std::vector<GpuScopeStats> scopes;
+	stats(scopes);
+	file << "scope,depth,samples,average_ms,median_ms,p95_ms,max_ms\n";
+	for (size_t i = 0; i < scopes.size(); ++i)
+		file << scopes[i].path << "," << scopes[i].depth << "," << scopes[i].samples << "," << scopes[i].average << ","
+			<< scopes[i].median << "," << scopes[i].p95 << "," << scopes[i].max << "\n";
+
+	std::cout << "GPU profile saved to " << filename << std::endl;
+	return true;
+}
+
+void GpuProfiler::cleanup()
+{
+	for (int i = 0; i < GPU_PROFILER_FRAMES; ++i)
+		glDeleteQueries(GPU_PROFILER_SCOPES * 2, frames[i].queries);
+}
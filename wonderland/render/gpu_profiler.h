@@ -0,0 +1,95 @@
+#ifndef _GPU_PROFILER_H_
+#define _GPU_PROFILER_H_
+
+#include <glad/gl.h>
+#include <vector>
+#include <map>
+#include <string>
+
+// Frames of queries in flight. Results are read when a frame's slot comes round
+// again, by which point the GPU has long finished with it.
+#define GPU_PROFILER_FRAMES (4)
+
+// Scopes per frame, anything past this still gets a debug group but isnt timed
+#define GPU_PROFILER_SCOPES (64)
+
+// Frames of history the averages and percentiles are worked out over
+#define GPU_PROFILER_HISTORY (240)
+
+struct GpuScopeStats {
+	std::string path;	// names of the enclosing scopes and this one, e.g. "frame/shadow/box"
+	int depth;			// 0 for the outermost
+	int samples;		// frames it has results for, up to GPU_PROFILER_HISTORY
+	double average;		// all in milliseconds
+	double median;
+	double p95;
+	double max;
+};
+
+// Times named, nested scopes on the GPU. Each scope puts a GL_TIMESTAMP query at
+// either end (GL_TIME_ELAPSED queries can't be nested). With GL 4.3 / KHR_debug each
+// scope is also a debug group, so tools like RenderDoc show the same tree.
+//
+// Scopes with the same path in one frame are added together, so a pass split over
+// several command lists still comes out as one number.
+struct GpuProfiler {
+	struct Scope {
+		const char* name;	// has to stay valid until the frame is read back
+		int parent;			// index in the same frame, -1 for none
+	};
+
+	struct Frame {
+		GLuint queries[GPU_PROFILER_SCOPES * 2];	// begin and end for each scope
+		Scope scopes[GPU_PROFILER_SCOPES];
+		int scopeCount;
+		GLuint lastQuery;	// queries finish in order, so once this one is done they all are
+	};
+
+	// Ring of results for one scope path
+	struct Series {
+		std::string path;
+		int depth;
+		std::vector<float> samples;
+		size_t next;
+	};
+
+	typedef void (GLAD_API_PTR *PushDebugGroupProc)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+	typedef void (GLAD_API_PTR *PopDebugGroupProc)();
+
+	Frame frames[GPU_PROFILER_FRAMES];
+	int frame;
+	std::vector<int> open;	// scopes begun and not ended yet, -1 for ones past the limit
+
+	std::vector<Series> series;	// in the order they were first seen
+	std::map<std::string, size_t> seriesIndex;
+	int dropped;			// frames whose results weren't ready in time, since initialize
+
+	PushDebugGroupProc pushDebugGroup;
+	PopDebugGroupProc popDebugGroup;
+
+	// loader is used to look up the debug group functions, which the 3.3 loader doesnt
+	// know about. Pass NULL to go without them.
+	bool initialize(GLADloadfunc loader);
+
+	// Reads back whatever finished from the last time this slot was used
+	void beginFrame();
+	void endFrame();	// closes anything still open
+
+	void begin(const char* name);
+	void end();
+
+	void stats(std::vector<GpuScopeStats>& out) const;
+
+	// Newest result for one scope path in milliseconds, 0 if it hasnt had one yet.
+	// Cheap enough to call every frame, unlike stats.
+	float latest(const std::string& path) const;
+	void printStats() const;
+	bool writeCsv(const std::string& filename) const;
+
+	void cleanup();
+
+private:
+	void collect(Frame& frame);
+};
+
+#endif
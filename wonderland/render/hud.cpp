@@ -0,0 +1,204 @@
+#include "hud.h"
+#include "hud_font.h"
+
+#include <cstring>
+#include <cstddef>
+
+// Atlas is a 16x6 grid of 8x8 cells, one per glyph, and the last cell (where DEL
+// would be) filled in for rectangles
+#define HUD_ATLAS_COLUMNS (16)
+#define HUD_ATLAS_ROWS (6)
+#define HUD_CELL_SIZE (8)
+#define HUD_ATLAS_WIDTH (HUD_ATLAS_COLUMNS * HUD_CELL_SIZE)
+#define HUD_ATLAS_HEIGHT (HUD_ATLAS_ROWS * HUD_CELL_SIZE)
+#define HUD_SOLID_CELL (HUD_FONT_GLYPHS)
+
+// One blank column between characters
+#define HUD_ADVANCE ((HUD_FONT_WIDTH + 1) * HUD_TEXT_SCALE)
+
+// Texel position to a normalized uint16 texture coordinate
+static uint16_t atlasCoordinate(float texel, int size)
+{
+	return (uint16_t)(texel / size * 65535.0f + 0.5f);
+}
+
+bool Hud::initialize(GLuint programID, const StreamBuffer& stream)
+{
+	this->programID = programID;
+	screenSizeID = glGetUniformLocation(programID, "screenSize");
+	glUseProgram(programID);
+	glUniform1i(glGetUniformLocation(programID, "atlas"), 0);
+	width = height = 0;
+	vertices.reserve(HUD_MAX_QUADS * 4);
+
+	std::vector<unsigned char> atlas(HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT, 0);
+	for (int glyph = 0; glyph < HUD_FONT_GLYPHS; ++glyph)
+	{
+		int left = (glyph % HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+		int top = (glyph / HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+		for (int row = 0; row < HUD_FONT_HEIGHT; ++row)
+			for (int column = 0; column < HUD_FONT_WIDTH; ++column)
+				if (hudFont[glyph][row] & (1 << (HUD_FONT_WIDTH - 1 - column)))
+					atlas[(top + row) * HUD_ATLAS_WIDTH + left + column] = 255;
+	}
+	int solidLeft = (HUD_SOLID_CELL % HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+	int solidTop = (HUD_SOLID_CELL / HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+	for (int row = 0; row < HUD_CELL_SIZE; ++row)
+		memset(&atlas[(solidTop + row) * HUD_ATLAS_WIDTH + solidLeft], 255, HUD_CELL_SIZE);
+
+	// Rows are 128 bytes so the default unpack alignment is fine. Nearest filtering
+	// keeps the pixels sharp at whole number scales.
+	atlasID.create("hud");
+	glBindTexture(GL_TEXTURE_2D, atlasID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+	atlasID.setBytes(glTextureBytes(GL_R8, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Every quad is two triangles over its own 4 vertices, so the indices never change
+	std::vector<GLushort> indices(HUD_MAX_QUADS * 6);
+	for (int i = 0; i < HUD_MAX_QUADS; ++i)
+	{
+		GLushort first = (GLushort)(i * 4);
+		GLushort quadIndices[6] = { first, (GLushort)(first + 1), (GLushort)(first + 2), (GLushort)(first + 2), (GLushort)(first + 3), first };
+		memcpy(&indices[i * 6], quadIndices, sizeof(quadIndices));
+	}
+
+	vertexArrayID.create("hud");
+	glBindVertexArray(vertexArrayID);
+	indexBufferID.create("hud");
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+	indexBufferID.setBytes(indices.size() * sizeof(GLushort));
+
+	glBindBuffer(GL_ARRAY_BUFFER, stream.bufferID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, color));
+	glBindVertexArray(0);
+
+	return programID != 0;
+}
+
+void Hud::begin(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	vertices.clear();
+}
+
+void Hud::quad(float x, float y, float w, float h, int cell, uint32_t color)
+{
+	if (vertices.size() >= HUD_MAX_QUADS * 4)
+		return;
+
+	// Glyphs only cover the left 5 columns of their cell. Rectangles sample the middle
+	// of the solid cell everywhere, so a thin one can't pick up its neighbour's edge.
+	float left = (float)((cell % HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE);
+	float top = (float)((cell / HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE);
+	float right = left + HUD_FONT_WIDTH;
+	float bottom = top + HUD_CELL_SIZE;
+	if (cell == HUD_SOLID_CELL)
+	{
+		left = right = left + HUD_CELL_SIZE / 2;
+		top = bottom = top + HUD_CELL_SIZE / 2;
+	}
+	uint16_t u0 = atlasCoordinate(left, HUD_ATLAS_WIDTH);
+	uint16_t v0 = atlasCoordinate(top, HUD_ATLAS_HEIGHT);
+	uint16_t u1 = atlasCoordinate(right, HUD_ATLAS_WIDTH);
+	uint16_t v1 = atlasCoordinate(bottom, HUD_ATLAS_HEIGHT);
+
+	HudVertex corners[4] = {
+		{ x, y, u0, v0, color },
+		{ x, y + h, u0, v1, color },
+		{ x + w, y + h, u1, v1, color },
+		{ x + w, y, u1, v0, color },
+	};
+	vertices.insert(vertices.end(), corners, corners + 4);
+}
+
+void Hud::rect(float x, float y, float w, float h, uint32_t color)
+{
+	quad(x, y, w, h, HUD_SOLID_CELL, color);
+}
+
+float Hud::text(float x, float y, const char* text, uint32_t color)
+{
+	for (const char* c = text; *c; ++c, x += HUD_ADVANCE)
+	{
+		int glyph = (unsigned char)*c - HUD_FONT_FIRST;
+		if (glyph == 0)
+			continue;
+		if (glyph < 0 || glyph >= HUD_FONT_GLYPHS)
+			glyph = '?' - HUD_FONT_FIRST;
+		quad(x, y, HUD_FONT_WIDTH * HUD_TEXT_SCALE, HUD_CELL_SIZE * HUD_TEXT_SCALE, glyph, color);
+	}
+	return x;
+}
+
+void Hud::graph(float x, float y, float w, float h, const float* values, int count, int newest, float maxValue, uint32_t color)
+{
+	if (count <= 0 || maxValue <= 0.0f)
+		return;
+	float barWidth = w / count;
+	for (int i = 0; i < count; ++i)
+	{
+		float value = values[(newest + 1 + i) % count];
+		float barHeight = (value < maxValue ? value / maxValue : 1.0f) * h;
+		if (barHeight > 0.0f)
+			rect(x + i * barWidth, y + h - barHeight, barWidth, barHeight, color);
+	}
+}
+
+float Hud::lineHeight()
+{
+	return (HUD_FONT_HEIGHT + 2) * HUD_TEXT_SCALE;
+}
+
+float Hud::textWidth(const char* text)
+{
+	return strlen(text) * HUD_ADVANCE;
+}
+
+void Hud::draw(GLStateCache& state, StreamBuffer& stream)
+{
+	if (vertices.empty())
+		return;
+
+	size_t size = vertices.size() * sizeof(HudVertex);
+	StreamAllocation allocation = stream.allocate(size, sizeof(HudVertex));
+	if (allocation.data == NULL)
+		return;
+	memcpy(allocation.data, vertices.data(), size);
+	stream.flush();
+
+	state.useProgram(programID);
+	glUniform2f(screenSizeID, (float)width, (float)height);
+	state.bindTexture(GL_TEXTURE0, atlasID);
+	state.bindVertexArray(vertexArrayID);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	GLsizei quads = (GLsizei)(vertices.size() / 4);
+	state.drawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT, 0, (GLint)(allocation.offset / sizeof(HudVertex)));
+
+	glDisable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void Hud::cleanup()
+{
+	glDeleteProgram(programID);
+	atlasID.reset();
+	indexBufferID.reset();
+	vertexArrayID.reset();
+}
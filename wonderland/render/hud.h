@@ -0,0 +1,73 @@
+#ifndef _HUD_H_
+#define _HUD_H_
+
+#include <glad/gl.h>
+#include <render/gl_state.h>
+#include <render/gl_resource.h>
+#include <render/stream_buffer.h>
+#include <vector>
+#include <stdint.h>
+
+// Quads in one overlay, text and rectangles together. The index buffer is made for
+// this many up front, anything past it is dropped.
+#define HUD_MAX_QUADS (4096)
+
+// Screen pixels per font pixel
+#define HUD_TEXT_SCALE (2)
+
+// Packs a color the way HudVertex stores it, bytes in r g b a order
+#define HUD_RGBA(r, g, b, a) ((uint32_t)(r) | (uint32_t)(g) << 8 | (uint32_t)(b) << 16 | (uint32_t)(a) << 24)
+
+// 16 bytes, so a stream allocation at the default alignment always starts on a
+// whole vertex and can be drawn with a base vertex instead of new attribute pointers
+struct HudVertex {
+	float x, y;			// pixels, from the top left
+	uint16_t u, v;		// normalized into the atlas
+	uint32_t color;
+};
+
+// Text and flat rectangles for on-screen stats. Everything added between begin and
+// draw is batched into the stream buffer and drawn with one call: glyphs and solid
+// rectangles all sample the same atlas, rectangles just use a cell that is filled in.
+struct Hud {
+	GLuint programID;
+	GLint screenSizeID;
+	GLTexture atlasID;
+	GLVertexArray vertexArrayID;
+	GLBuffer indexBufferID;
+
+	int width, height;	// of the screen this frame
+	std::vector<HudVertex> vertices;
+
+	// Program is hud.vert/hud.frag. The vertex array reads straight out of the stream
+	// buffer, so it has to be initialized first.
+	bool initialize(GLuint programID, const StreamBuffer& stream);
+
+	// Clears out the last frame's quads
+	void begin(int width, int height);
+
+	void rect(float x, float y, float w, float h, uint32_t color);
+
+	// One line of text, returns the x it finished at. Characters outside printable
+	// ASCII come out as '?'.
+	float text(float x, float y, const char* text, uint32_t color);
+
+	// Bar graph of a ring of samples, oldest on the left. newest is the index of the
+	// last one written, values over maxValue are clipped to the top.
+	void graph(float x, float y, float w, float h, const float* values, int count, int newest, float maxValue, uint32_t color);
+
+	// Height of a line of text, for stepping down the screen, and how wide text comes out
+	static float lineHeight();
+	static float textWidth(const char* text);
+
+	// Copies the quads into the stream buffer and draws them on top of whatever is bound.
+	// Depth testing and culling are off while it draws and turned back on after.
+	void draw(GLStateCache& state, StreamBuffer& stream);
+
+	void cleanup();
+
+private:
+	void quad(float x, float y, float w, float h, int cell, uint32_t color);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "mesh_arena.h"
+
+#include <iostream>
+
+void MeshArena::initialize(GLsizei vertexStride, size_t vertexCapacity, size_t indexCapacity)
+{
+	this->vertexStride = vertexStride;
+	this->vertexCapacity = vertexCapacity;
+	this->indexCapacity = indexCapacity;
+	vertexCount = 0;
+	indexCount = 0;
+
+	// Storage only, meshes get copied in by add. Going through the array buffer
+	// target for both since there might not be a VAO bound to take the index buffer.
+	vertexBufferID.create("mesh arena vertices");
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * vertexStride, NULL, GL_STATIC_DRAW);
+	vertexBufferID.setBytes(vertexCapacity * vertexStride);
+
+	indexBufferID.create("mesh arena indices");
+	glBindBuffer(GL_ARRAY_BUFFER, indexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	indexBufferID.setBytes(indexCapacity * sizeof(GLuint));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool MeshArena::add(const void* vertices, size_t meshVertexCount, const GLuint* indices, size_t meshIndexCount, MeshRange& range)
+{
+	if (vertexCount + meshVertexCount > vertexCapacity || indexCount + meshIndexCount > indexCapacity)
+	{
+		std::cerr << "Mesh arena is full, cant fit " << meshVertexCount << " vertices and " << meshIndexCount << " indices" << std::endl;
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexCount * vertexStride, meshVertexCount * vertexStride, vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, indexBufferID);
+	glBufferSubData(GL_ARRAY_BUFFER, indexCount * sizeof(GLuint), meshIndexCount * sizeof(GLuint), indices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	range.baseVertex = (GLint)vertexCount;
+	range.vertexCount = (GLuint)meshVertexCount;
+	range.indexOffset = indexCount * sizeof(GLuint);
+	range.indexCount = (GLsizei)meshIndexCount;
+
+	vertexCount += meshVertexCount;
+	indexCount += meshIndexCount;
+	return true;
+}
+
+void MeshArena::cleanup()
+{
+	vertexBufferID.reset();
+	indexBufferID.reset();
+}
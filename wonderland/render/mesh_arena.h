@@ -0,0 +1,43 @@
+#ifndef _MESH_ARENA_H_
+#define _MESH_ARENA_H_
+
+#include <glad/gl.h>
+#include <render/gl_resource.h>
+#include <cstddef>
+
+// Default room in the arena, the viewer grows these to fit the scene it loads
+#define MESH_ARENA_VERTICES (1 << 18)
+#define MESH_ARENA_INDICES (1 << 20)
+
+// Where one mesh ended up in the arena. Indices are relative to the mesh's own
+// vertices, baseVertex is added on by glDrawElementsBaseVertex.
+struct MeshRange {
+	GLint baseVertex;
+	GLuint vertexCount;
+	size_t indexOffset;		// bytes into the index buffer, for the draw call
+	GLsizei indexCount;
+};
+
+// Every static mesh shares one vertex buffer and one index buffer, handed out front
+// to back and never freed individually. Meshes all have the same vertex format, so
+// one vertex array per shader layout covers the lot and drawing a different mesh
+// doesnt bind anything.
+struct MeshArena {
+	GLBuffer vertexBufferID;
+	GLBuffer indexBufferID;
+	GLsizei vertexStride;
+
+	size_t vertexCapacity;
+	size_t indexCapacity;
+	size_t vertexCount;		// used so far
+	size_t indexCount;
+
+	void initialize(GLsizei vertexStride, size_t vertexCapacity, size_t indexCapacity);
+
+	// Copies a mesh in. False (and range untouched) if it doesnt fit.
+	bool add(const void* vertices, size_t meshVertexCount, const GLuint* indices, size_t meshIndexCount, MeshRange& range);
+
+	void cleanup();
+};
+
+#endif
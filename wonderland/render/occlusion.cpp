@@ -0,0 +1,281 @@
+#include "occlusion.h"
+#include <core/trace.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+// Anything closer to the eye than this (in clip space w) is skipped. Dropping an
+// occluder triangle only means less gets culled, so there's no clipping.
+#define OCCLUSION_MIN_W (1e-3f)
+
+void OcclusionCuller::initialize(JobSystem& jobs)
+{
+	this->jobs = &jobs;
+	viewProjection = glm::mat4(1.0f);
+	stats.occluderTriangles = 0;
+	stats.objectsTested = 0;
+	stats.objectsOccluded = 0;
+
+	// Level 0 is the full buffer, each level after it half the size down to a single row
+	int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+	while (true)
+	{
+		levels.push_back(std::vector<float>(width * height, 1.0f));
+		if (width == 1 || height == 1)
+			break;
+		width /= 2;
+		height /= 2;
+	}
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& modelMatrix)
+{
+	// Vertices arent shared between occluders, so only the ones referenced get copied
+	uint32_t maxIndex = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+		maxIndex = std::max(maxIndex, indices[i]);
+
+	uint32_t base = (uint32_t)occluderPositions.size();
+	for (uint32_t i = 0; indexCount > 0 && i <= maxIndex; ++i)
+		occluderPositions.push_back(glm::vec3(modelMatrix * glm::vec4(positions[i], 1.0f)));
+	for (size_t i = 0; i < indexCount; ++i)
+		occluderIndices.push_back(base + indices[i]);
+}
+
+void OcclusionCuller::setupTriangles()
+{
+	triangles.clear();
+
+	std::vector<glm::vec4> clip(occluderPositions.size());
+	for (size_t i = 0; i < occluderPositions.size(); ++i)
+		clip[i] = viewProjection * glm::vec4(occluderPositions[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < occluderIndices.size(); i += 3)
+	{
+		float x[3], y[3], z[3];
+		bool skip = false;
+		for (int v = 0; v < 3; ++v)
+		{
+			const glm::vec4& c = clip[occluderIndices[i + v]];
+			if (c.w < OCCLUSION_MIN_W)
+			{
+				skip = true;
+				break;
+			}
+			x[v] = (c.x / c.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+			y[v] = (c.y / c.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+			z[v] = c.z / c.w * 0.5f + 0.5f;
+		}
+		if (skip)
+			continue;
+
+		// Both windings get drawn, so flip the clockwise ones round
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (fabsf(area) < 1e-6f)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		// Pixel bounds, clamped in float first since far off vertices can be huge
+		float minX = std::max(std::min(x[0], std::min(x[1], x[2])), 0.0f);
+		float maxX = std::min(std::max(x[0], std::max(x[1], x[2])), (float)OCCLUSION_WIDTH - 1.0f);
+		float minY = std::max(std::min(y[0], std::min(y[1], y[2])), 0.0f);
+		float maxY = std::min(std::max(y[0], std::max(y[1], y[2])), (float)OCCLUSION_HEIGHT - 1.0f);
+		if (minX > maxX || minY > maxY || std::min(z[0], std::min(z[1], z[2])) > 1.0f)
+			continue;
+
+		Triangle triangle;
+		triangle.minX = (int)minX;
+		triangle.maxX = (int)maxX;
+		triangle.minY = (int)minY;
+		triangle.maxY = (int)maxY;
+
+		for (int e = 0; e < 3; ++e)
+		{
+			int next = (e + 1) % 3;
+			triangle.edgeA[e] = y[e] - y[next];
+			triangle.edgeB[e] = x[next] - x[e];
+			triangle.edgeC[e] = -(triangle.edgeA[e] * x[e] + triangle.edgeB[e] * y[e]);
+		}
+
+		triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+		triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+		triangles.push_back(triangle);
+	}
+
+	stats.occluderTriangles = (int)triangles.size();
+}
+
+void OcclusionCuller::rasterizeBand(int band)
+{
+	TRACE_ZONE("rasterize occluders");
+	const int bandHeight = OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+	int bandMinY = band * bandHeight;
+	int bandMaxY = bandMinY + bandHeight - 1;
+
+	float* depth = levels[0].data();
+	std::fill(depth + bandMinY * OCCLUSION_WIDTH, depth + (bandMaxY + 1) * OCCLUSION_WIDTH, 1.0f);
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		const Triangle& t = triangles[i];
+		int minY = std::max(t.minY, bandMinY);
+		int maxY = std::min(t.maxY, bandMaxY);
+		int minX = t.minX & ~3;
+
+#ifdef OCCLUSION_USE_SSE
+		__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 zero = _mm_setzero_ps();
+		__m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+		__m128 depthA = _mm_set1_ps(t.depthA);
+#endif
+
+		for (int y = minY; y <= maxY; ++y)
+		{
+			float py = y + 0.5f;
+			float* row = depth + y * OCCLUSION_WIDTH;
+
+#ifdef OCCLUSION_USE_SSE
+			// Everything that only depends on the row
+			__m128 e0Row = _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+			__m128 e1Row = _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+			__m128 e2Row = _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+			__m128 depthRow = _mm_set1_ps(t.depthB * py + t.depthC);
+
+			// Starting on a multiple of 4 keeps every group inside the row, the edge
+			// tests take care of the pixels left of the triangle
+			for (int x = minX; x <= t.maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0Row);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1Row);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2Row);
+				__m128 inside = _mm_cmpge_ps(_mm_min_ps(e0, _mm_min_ps(e1, e2)), zero);
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), depthRow);
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+#else
+			for (int x = minX; x <= t.maxX; ++x)
+			{
+				float px = x + 0.5f;
+				float e0 = t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0];
+				float e1 = t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1];
+				float e2 = t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2];
+				if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+					continue;
+
+				float z = t.depthA * px + t.depthB * py + t.depthC;
+				row[x] = std::min(row[x], z);
+			}
+#endif
+		}
+	}
+}
+
+void OcclusionCuller::render(const glm::mat4& viewProjection)
+{
+	TRACE_ZONE("occlusion render");
+	this->viewProjection = viewProjection;
+	setupTriangles();
+
+	// Bands dont overlap, so they can all be filled at once
+	parallelFor(*jobs, OCCLUSION_BANDS, 1, [this](int begin, int end) {
+		for (int band = begin; band < end; ++band)
+			rasterizeBand(band);
+	});
+
+	// Each level keeps the farthest depth of the 2x2 below it
+	int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+	for (size_t level = 1; level < levels.size(); ++level)
+	{
+		const float* source = levels[level - 1].data();
+		float* target = levels[level].data();
+		int sourceWidth = width;
+		width /= 2;
+		height /= 2;
+		for (int y = 0; y < height; ++y)
+		{
+			const float* row0 = source + (y * 2) * sourceWidth;
+			const float* row1 = row0 + sourceWidth;
+			for (int x = 0; x < width; ++x)
+				target[y * width + x] = std::max(std::max(row0[x * 2], row0[x * 2 + 1]), std::max(row1[x * 2], row1[x * 2 + 1]));
+		}
+	}
+}
+
+bool OcclusionCuller::occluded(const Aabb& bounds) const
+{
+	float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f, minZ = 1e30f;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+		glm::vec4 c = viewProjection * glm::vec4(corner, 1.0f);
+		if (c.w < OCCLUSION_MIN_W)
+			return false;
+
+		float x = (c.x / c.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		float y = (c.y / c.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, c.z / c.w * 0.5f + 0.5f);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+		return false;
+
+	int x0 = (int)std::max(minX, 0.0f), x1 = (int)std::min(maxX, (float)OCCLUSION_WIDTH - 1.0f);
+	int y0 = (int)std::max(minY, 0.0f), y1 = (int)std::min(maxY, (float)OCCLUSION_HEIGHT - 1.0f);
+
+	// Go up until the rectangle covers at most 2x2 texels
+	int level = 0;
+	while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	const float* depth = levels[level].data();
+	int width = OCCLUSION_WIDTH >> level;
+	for (int y = y0 >> level; y <= (y1 >> level); ++y)
+		for (int x = x0 >> level; x <= (x1 >> level); ++x)
+			if (minZ <= depth[y * width + x])
+				return false;
+	return true;
+}
+
+void OcclusionCuller::cull(const std::vector<Aabb>& bounds, std::vector<char>& visible)
+{
+	TRACE_ZONE("occlusion cull");
+	stats.objectsTested = 0;
+	stats.objectsOccluded = 0;
+	if (triangles.empty())
+		return;
+
+	for (size_t i = 0; i < bounds.size() && i < visible.size(); ++i)
+	{
+		if (!visible[i])
+			continue;
+		stats.objectsTested++;
+		if (occluded(bounds[i]))
+		{
+			visible[i] = 0;
+			stats.objectsOccluded++;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef _OCCLUSION_H_
+#define _OCCLUSION_H_
+
+#include <render/culling.h>
+#include <core/job_system.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+#include <vector>
+
+// Size of the CPU depth buffer. The width has to be a multiple of 4 (SSE fills four
+// pixels at a time) and the height a multiple of OCCLUSION_BANDS.
+#define OCCLUSION_WIDTH (256)
+#define OCCLUSION_HEIGHT (128)
+
+// Horizontal strips of the depth buffer, one job each
+#define OCCLUSION_BANDS (8)
+
+struct OcclusionStats {
+	int occluderTriangles;	// that made it through setup this frame
+	int objectsTested;
+	int objectsOccluded;
+};
+
+// Software occlusion culling, no GL involved. A few big occluder meshes are rasterized
+// into a small depth buffer on the CPU, then reduced into a pyramid of the farthest
+// depth in each 2x2 block. An object is occluded if the nearest point of its bounds
+// is behind everything in the pyramid texels its screen rectangle covers.
+//
+// Only pixel centres get rasterized, so objects right at an occluder's silhouette can
+// be let through or dropped a pixel early. At this resolution thats not noticeable.
+struct OcclusionCuller {
+	// Set up once the view-projection is known, then only read by the workers
+	struct Triangle {
+		float edgeA[3], edgeB[3], edgeC[3];	// edge functions, all >= 0 inside
+		float depthA, depthB, depthC;		// depth plane, z = A * x + B * y + C
+		int minX, maxX, minY, maxY;			// pixel bounds, clamped to the buffer
+	};
+
+	std::vector<glm::vec3> occluderPositions;	// world space
+	std::vector<uint32_t> occluderIndices;
+
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<float> > levels;	// levels[0] is the depth buffer, 0 near and 1 far
+	glm::mat4 viewProjection;
+	OcclusionStats stats;
+
+	JobSystem* jobs;
+
+	void initialize(JobSystem& jobs);
+
+	// Occluders are static, they get moved into world space here
+	void addOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& modelMatrix);
+
+	// Rasterizes the occluders from this view and builds the depth pyramid
+	void render(const glm::mat4& viewProjection);
+
+	// Bounds that cross the near plane or are off screen are never occluded, the
+	// frustum culling deals with those.
+	bool occluded(const Aabb& bounds) const;
+
+	// Clears visible[i] for every still visible object whose bounds are occluded
+	void cull(const std::vector<Aabb>& bounds, std::vector<char>& visible);
+
+private:
+	void setupTriangles();
+	void rasterizeBand(int band);
+};
+
+#endif
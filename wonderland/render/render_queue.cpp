@@ -0,0 +1,143 @@
+#include "render_queue.h"
+#include <core/trace.h>
+
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cstring>
+
+RenderQueue::RenderQueue()
+{
+	commandCount = 0;
+}
+
+void RenderQueue::clear()
+{
+	items.clear();
+	keys.clear();
+}
+
+// Normals are stored unscaled, so only the model matrix goes into this, not the dequantize
+static glm::mat4 normalMatrix(const glm::mat4& modelMatrix)
+{
+	return glm::mat4(glm::inverseTranspose(glm::mat3(modelMatrix)));
+}
+
+void RenderQueue::add(RenderPass pass, const RenderMaterial& material, GLuint vertexArrayID, const MeshRange& mesh,
+	const glm::mat4& modelMatrix, const glm::mat4& dequantize, const glm::mat4& viewMatrix)
+{
+	DrawItem item;
+	item.material = &material;
+	item.vertexArrayID = vertexArrayID;
+	item.mesh = mesh;
+	item.modelMatrix = modelMatrix;
+	item.dequantize = dequantize;
+	items.push_back(item);
+
+	// Dequantizing maps 0 to the middle of the mesh bounds, so this is the mesh centre
+	// in view space. Looking down -z, so flip it to get a distance.
+	glm::vec4 center = viewMatrix * modelMatrix * dequantize[3];
+	float depth = center.z < 0.0f ? -center.z : 0.0f;
+
+	// Positive floats sort the same as their bits, keep the top 24
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	uint64_t key = (uint64_t)(pass & 0xf) << 60
+		| (uint64_t)(material.programID & 0xfff) << 48
+		| (uint64_t)(material.textureID & 0xfff) << 36
+		| (uint64_t)(vertexArrayID & 0xfff) << 24
+		| (uint64_t)(depthBits >> 8);
+	keys.push_back(key);
+}
+
+// LSD radix sort on 8 bit digits. Stable, and digits that are the same for every
+// key (the pass, usually most of the ids) are skipped after the counting step.
+void RenderQueue::sort()
+{
+	TRACE_ZONE("sort queue");
+	size_t count = keys.size();
+	order.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		order[i] = (uint32_t)i;
+
+	sortKeys.assign(keys.begin(), keys.end());
+	tempKeys.resize(count);
+	tempOrder.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (size_t i = 0; i < count; ++i)
+			histogram[(sortKeys[i] >> shift) & 0xff]++;
+
+		if (count == 0 || histogram[(sortKeys[0] >> shift) & 0xff] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int b = 0; b < 256; ++b)
+		{
+			size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t slot = histogram[(sortKeys[i] >> shift) & 0xff]++;
+			tempKeys[slot] = sortKeys[i];
+			tempOrder[slot] = order[i];
+		}
+		sortKeys.swap(tempKeys);
+		order.swap(tempOrder);
+	}
+}
+
+Job* RenderQueue::recordAsync(JobSystem& jobs)
+{
+	commandCount = (order.size() + RENDER_RECORD_BATCH - 1) / RENDER_RECORD_BATCH;
+	if (commands.size() < commandCount)
+		commands.resize(commandCount);
+
+	return parallelForAsync(jobs, (int)order.size(), RENDER_RECORD_BATCH, [this](int begin, int end) {
+		record(commands[begin / RENDER_RECORD_BATCH], begin, end);
+	});
+}
+
+void RenderQueue::record(CommandList& list, size_t begin, size_t end) const
+{
+	TRACE_ZONE("record commands");
+	list.clear();
+	const char* scope = NULL;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const DrawItem& item = items[order[i]];
+		const RenderMaterial& material = *item.material;
+
+		if (material.name != scope)
+		{
+			if (scope)
+				list.endScope();
+			scope = material.name;
+			if (scope)
+				list.beginScope(scope);
+		}
+
+		list.useProgram(material.programID);
+		if (material.textureID != 0)
+			list.bindTexture(0, material.textureID);
+		list.bindVertexArray(item.vertexArrayID);
+		list.setMatrix(material.modelMatrixID, item.modelMatrix * item.dequantize);
+		if (material.normalMatrixID >= 0)
+			list.setMatrix(material.normalMatrixID, normalMatrix(item.modelMatrix));
+		list.drawElements(item.mesh.indexCount, item.mesh.indexOffset, item.mesh.baseVertex);
+	}
+	if (scope)
+		list.endScope();
+}
+
+void RenderQueue::replay(GLStateCache& state, GpuProfiler* profiler) const
+{
+	TRACE_ZONE("replay commands");
+	for (size_t i = 0; i < commandCount; ++i)
+		commands[i].replay(state, profiler);
+}
@@ -0,0 +1,86 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include <glad/gl.h>
+#include "gl_state.h"
+#include "mesh_arena.h"
+#include "command_list.h"
+#include <core/job_system.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+// Draws per command list when recording on the job system
+#define RENDER_RECORD_BATCH (256)
+
+// Passes run in this order within one queue
+enum RenderPass {
+	PASS_OPAQUE = 0,
+	PASS_SKY = 1,		// after the opaque pass so hidden sky pixels fail the depth test
+};
+
+// A shader program and the texture it draws with, plus where the queue puts the
+// model and normal matrices. Camera and light data come from the shared uniform
+// blocks, so those are the only uniforms set per draw.
+struct RenderMaterial {
+	GLuint programID;
+	GLuint textureID;		// bound to texture unit 0, 0 for none
+	GLint modelMatrixID;
+	GLint normalMatrixID;	// -1 if the program doesn't light anything
+	const char* name;		// GPU profiler scope for its draws, NULL for none
+};
+
+struct DrawItem {
+	const RenderMaterial* material;
+	GLuint vertexArrayID;
+	MeshRange mesh;
+	glm::mat4 modelMatrix;
+	glm::mat4 dequantize;
+};
+
+// Objects add draw items instead of drawing straight away. The queue sorts them by
+// pass, program, texture, vertex array and then front to back, so the state cache
+// gets to skip most of the binds between neighbouring draws.
+//
+// Key layout, most significant first:
+//   pass 4 | program 12 | texture 12 | vertex array 12 | view depth 24
+struct RenderQueue {
+	std::vector<DrawItem> items;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+
+	// Scratch for the radix sort, kept around so nothing is allocated per frame
+	std::vector<uint64_t> sortKeys;
+	std::vector<uint64_t> tempKeys;
+	std::vector<uint32_t> tempOrder;
+
+	// Sorted draws recorded a batch per list. Lists past commandCount are only kept
+	// so their memory gets reused.
+	std::vector<CommandList> commands;
+	size_t commandCount;
+
+	RenderQueue();
+
+	void clear();
+
+	// viewMatrix is only used for the depth part of the key
+	void add(RenderPass pass, const RenderMaterial& material, GLuint vertexArrayID, const MeshRange& mesh,
+		const glm::mat4& modelMatrix, const glm::mat4& dequantize, const glm::mat4& viewMatrix);
+
+	void sort();
+
+	// Draws everything in sorted order, in two halves. Recording does all the per draw
+	// work (matrix products, picking out the binds) across the job system and doesnt
+	// touch GL, so it can run on any thread once the queue is sorted. Wait on the
+	// returned job before replaying, replay just walks the lists on the GL thread.
+	// Binds go through the state cache, which also keeps the counts of what was issued
+	// and skipped. The right view has to be bound with UniformBlocks::bindView first.
+	// Each run of draws with the same material name gets a profiler scope.
+	Job* recordAsync(JobSystem& jobs);
+	void replay(GLStateCache& state, GpuProfiler* profiler = NULL) const;
+
+private:
+	void record(CommandList& list, size_t begin, size_t end) const;
+};
+
+#endif
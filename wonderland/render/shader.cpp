@@ -6,14 +6,9 @@
 #include <sstream> 
 #include <vector>
 
-GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path)
+bool ReadShaderFiles(const char *vertex_file_path, const char *fragment_file_path, std::string& VertexShaderCode, std::string& FragmentShaderCode)
 {
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
 	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
 	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
 	if (VertexShaderStream.is_open())
 	{
@@ -25,11 +20,10 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	else
 	{
 		printf("Vertex shader not found %s.\n", vertex_file_path);
-		return 0;
+		return false;
 	}
 
 	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
 	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
 	if (FragmentShaderStream.is_open())
 	{
@@ -41,8 +35,20 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	else
 	{
 		printf("Fragment shader not found %s.\n", fragment_file_path);
-		return 0;
+		return false;
 	}
+	return true;
+}
+
+GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path)
+{
+	std::string VertexShaderCode, FragmentShaderCode;
+	if (!ReadShaderFiles(vertex_file_path, fragment_file_path, VertexShaderCode, FragmentShaderCode))
+		return 0;
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -6,6 +6,9 @@
 
 GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path);
 
+// Just the file reading half of LoadShadersFromFile, no GL calls so it can run on any thread
+bool ReadShaderFiles(const char *vertex_file_path, const char *fragment_file_path, std::string& VertexShaderCode, std::string& FragmentShaderCode);
+
 GLuint LoadShadersFromString(std::string VertexShaderCode, std::string FragmentShaderCode);
 
 #endif
@@ -0,0 +1,167 @@
+#include "stream_buffer.h"
+
+#include <iostream>
+#include <cstring>
+
+// Not in the 3.3 loader, looked up by hand when the context has it
+#define STREAM_MAP_PERSISTENT_BIT 0x0040
+#define STREAM_MAP_COHERENT_BIT 0x0080
+typedef void (GLAD_API_PTR *BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static bool hasBufferStorage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; ++i)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+	return false;
+}
+
+bool StreamBuffer::initialize(size_t frameSize, GLADloadfunc loader)
+{
+	// Regions have to start on a boundary any UBO offset alignment is happy with
+	frameSize = (frameSize + 255) / 256 * 256;
+	this->frameSize = frameSize;
+	frame = 0;
+	head = 0;
+	flushed = 0;
+	stalls = 0;
+	mapped = NULL;
+	persistent = false;
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+		fences[i] = 0;
+
+	size_t totalSize = frameSize * STREAM_BUFFER_FRAMES;
+	bufferID.create("stream buffer");
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+
+	BufferStorageProc bufferStorage = NULL;
+	if (loader && hasBufferStorage())
+	{
+		bufferStorage = (BufferStorageProc)loader("glBufferStorage");
+		if (bufferStorage == NULL)
+			bufferStorage = (BufferStorageProc)loader("glBufferStorageARB");
+	}
+
+	if (bufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | STREAM_MAP_PERSISTENT_BIT | STREAM_MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+		persistent = mapped != NULL;
+	}
+
+	if (!persistent)
+	{
+		// Storage from glBufferStorage is immutable, start again with a new name
+		if (bufferStorage)
+		{
+			bufferID.create("stream buffer");
+			glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+		}
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+		staging.resize(frameSize);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	bufferID.setBytes(totalSize);
+
+	std::cout << "Stream buffer: " << STREAM_BUFFER_FRAMES << " x " << frameSize / 1024 << " KB, "
+		<< (persistent ? "persistently mapped" : "orphaned uploads") << std::endl;
+	return bufferID != 0;
+}
+
+void StreamBuffer::beginFrame()
+{
+	head = 0;
+	flushed = 0;
+
+	GLsync fence = fences[frame];
+	if (fence == 0)
+		return;
+
+	// Usually already signalled, only waits if the CPU is a whole ring ahead
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		stalls++;
+		do
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	fences[frame] = 0;
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+	StreamAllocation allocation;
+	size_t start = (head + alignment - 1) / alignment * alignment;
+	if (start + size > frameSize)
+	{
+		std::cerr << "Stream buffer out of room, " << size << " bytes wanted with " << frameSize - head << " left" << std::endl;
+		allocation.offset = 0;
+		allocation.data = NULL;
+		return allocation;
+	}
+
+	// Regions start at multiples of frameSize, keep that a multiple of any alignment used
+	allocation.offset = frame * frameSize + start;
+	allocation.data = persistent ? mapped + allocation.offset : &staging[start];
+	head = start + size;
+	return allocation;
+}
+
+void StreamBuffer::flush()
+{
+	if (persistent || flushed == head)
+		return;
+
+	// Nothing the GPU still needs lives in this range (the fence said so), so it can
+	// be invalidated and written without the driver waiting
+	size_t offset = frame * frameSize + flushed;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+	void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, head - flushed,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (data)
+	{
+		memcpy(data, &staging[flushed], head - flushed);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	flushed = head;
+}
+
+void StreamBuffer::endFrame()
+{
+	flush();
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame = (frame + 1) % STREAM_BUFFER_FRAMES;
+}
+
+void StreamBuffer::cleanup()
+{
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	bufferID.reset();
+	mapped = NULL;
+}
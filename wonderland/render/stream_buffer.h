@@ -0,0 +1,60 @@
+#ifndef _STREAM_BUFFER_H_
+#define _STREAM_BUFFER_H_
+
+#include <glad/gl.h>
+#include <render/gl_resource.h>
+#include <vector>
+#include <cstddef>
+
+// How many frames the CPU can get ahead of the GPU before beginFrame has to wait
+#define STREAM_BUFFER_FRAMES (3)
+
+struct StreamAllocation {
+	size_t offset;		// from the start of the buffer, for glBindBufferRange and friends
+	void* data;			// where to write it, NULL if the frame ran out of room
+};
+
+// One big buffer for everything that changes every frame, split into a region per
+// frame in flight. Each region gets a fence when the frame is done, and is only
+// written again once that fence has passed, so the GPU is never reading what the
+// CPU is writing and the driver never has to sync behind our back.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer stays persistently mapped and
+// allocations are written straight into it. Otherwise they go to a staging copy
+// and flush() uploads them into a freshly invalidated (orphaned) range.
+struct StreamBuffer {
+	GLBuffer bufferID;
+	size_t frameSize;
+	bool persistent;
+
+	int frame;			// region being filled
+	size_t head;		// bytes used in that region
+	size_t flushed;		// bytes of it already uploaded, only used without persistent mapping
+	GLsync fences[STREAM_BUFFER_FRAMES];
+
+	unsigned char* mapped;	// the whole buffer when persistent
+	std::vector<unsigned char> staging;	// one region otherwise
+
+	int stalls;			// times beginFrame had to wait for the GPU, since initialize
+
+	// loader is used to look up glBufferStorage, which the 3.3 loader doesnt know about.
+	// Pass NULL to always use the fallback.
+	bool initialize(size_t frameSize, GLADloadfunc loader);
+
+	// Waits until the GPU is done with the region this frame is going to write
+	void beginFrame();
+
+	// Space in this frame's region. Pointers stay valid until endFrame.
+	StreamAllocation allocate(size_t size, size_t alignment = 16);
+
+	// Makes everything written since the last flush visible to GL. Call it after
+	// writing and before drawing with the data, it's free when persistently mapped.
+	void flush();
+
+	// Fences this frame's region and moves on to the next
+	void endFrame();
+
+	void cleanup();
+};
+
+#endif
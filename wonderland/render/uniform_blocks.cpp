@@ -0,0 +1,58 @@
+#include "uniform_blocks.h"
+
+#include <cstring>
+
+static GLint alignUp(GLint size, GLint alignment)
+{
+	return ((size + alignment - 1) / alignment) * alignment;
+}
+
+void UniformBlocks::initialize()
+{
+	alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	bufferID = 0;
+	viewsOffset = 0;
+	viewCount = 0;
+}
+
+void UniformBlocks::update(StreamBuffer& stream, const FrameData& frame, const ViewData* views, int viewCount)
+{
+	GLint viewStride = alignUp(sizeof(ViewData), alignment);
+	GLint frameSize = alignUp(sizeof(FrameData), alignment);
+
+	StreamAllocation allocation = stream.allocate(frameSize + viewStride * viewCount, alignment);
+	if (allocation.data == NULL)
+		return;
+
+	unsigned char* data = (unsigned char*)allocation.data;
+	memcpy(data, &frame, sizeof(FrameData));
+	for (int i = 0; i < viewCount; ++i)
+		memcpy(data + frameSize + i * viewStride, &views[i], sizeof(ViewData));
+	stream.flush();
+
+	bufferID = stream.bufferID;
+	viewsOffset = allocation.offset + frameSize;
+	this->viewCount = viewCount;
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, bufferID, allocation.offset, sizeof(FrameData));
+}
+
+void UniformBlocks::bindView(int view)
+{
+	if (view >= viewCount)
+		return;
+	GLint viewStride = alignUp(sizeof(ViewData), alignment);
+	glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_DATA_BINDING, bufferID, viewsOffset + view * viewStride, sizeof(ViewData));
+}
+
+void bindUniformBlocks(GLuint programID)
+{
+	GLuint frameBlock = glGetUniformBlockIndex(programID, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(programID, frameBlock, FRAME_DATA_BINDING);
+
+	GLuint viewBlock = glGetUniformBlockIndex(programID, "ViewData");
+	if (viewBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(programID, viewBlock, VIEW_DATA_BINDING);
+}
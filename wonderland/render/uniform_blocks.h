@@ -0,0 +1,49 @@
+#ifndef _UNIFORM_BLOCKS_H_
+#define _UNIFORM_BLOCKS_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "stream_buffer.h"
+
+// Binding points for the shared blocks. 0 is taken by the joint palette (animation.h).
+#define FRAME_DATA_BINDING (1)
+#define VIEW_DATA_BINDING (2)
+
+// std140 layouts, these have to match the FrameData/ViewData blocks in the shaders
+struct FrameData {
+	glm::mat4 lightSpaceMatrix;
+	glm::vec4 lightPosition;	// xyz
+	glm::vec4 lightIntensity;	// xyz
+	float farPlane;
+	float time;
+	float padding[2];
+};
+
+struct ViewData {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition;	// xyz
+};
+
+// The frame block followed by a block for each view (the camera, the shadow map
+// light, ...), written once a frame into the stream buffer. Each pass then just
+// points VIEW_DATA_BINDING at its own view.
+struct UniformBlocks {
+	GLuint bufferID;
+	GLint alignment;	// UBO offset alignment
+	size_t viewsOffset;
+	int viewCount;
+
+	void initialize();
+
+	// Writes the frame data and views into this frame's part of the stream and binds the frame block
+	void update(StreamBuffer& stream, const FrameData& frame, const ViewData* views, int viewCount);
+
+	void bindView(int view);
+};
+
+// Points a program's FrameData and ViewData blocks (whichever it has) at the shared binding points
+void bindUniformBlocks(GLuint programID);
+
+#endif
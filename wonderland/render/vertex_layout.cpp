@@ -0,0 +1,69 @@
+#include "vertex_layout.h"
+
+VertexLayout::VertexLayout()
+	: stride(0), attributeCount(0)
+{
+}
+
+void VertexLayout::add(GLint location, GLint size, GLenum type, GLboolean normalized, size_t offset)
+{
+	if (attributeCount == MAX_VERTEX_ATTRIBUTES)
+		return;
+	VertexAttribute& attribute = attributes[attributeCount++];
+	attribute.location = location;
+	attribute.size = size;
+	attribute.type = type;
+	attribute.normalized = normalized;
+	attribute.offset = offset;
+}
+
+void interleaveStreams(const VertexStream* streams, int streamCount, int vertexCount,
+	std::vector<GLfloat>& vertices, VertexLayout& layout)
+{
+	layout = VertexLayout();
+	int floatsPerVertex = 0;
+	for (int s = 0; s < streamCount; ++s)
+	{
+		layout.add(streams[s].location, streams[s].components, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(GLfloat));
+		floatsPerVertex += streams[s].components;
+	}
+	layout.stride = floatsPerVertex * sizeof(GLfloat);
+
+	vertices.resize((size_t)floatsPerVertex * vertexCount);
+	GLfloat* out = vertices.data();
+	for (int v = 0; v < vertexCount; ++v)
+	{
+		for (int s = 0; s < streamCount; ++s)
+		{
+			const GLfloat* in = streams[s].data + v * streams[s].components;
+			for (int c = 0; c < streams[s].components; ++c)
+				*out++ = in[c];
+		}
+	}
+}
+
+GLVertexArray createVertexArray(GLuint vertexBufferID, GLuint indexBufferID, const VertexLayout& layout, const std::string& owner)
+{
+	GLVertexArray vertexArray;
+	vertexArray.create(owner);
+	glBindVertexArray(vertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	for (int i = 0; i < layout.attributeCount; ++i)
+	{
+		const VertexAttribute& attribute = layout.attributes[i];
+		if (attribute.location < 0)
+			continue;
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+			layout.stride, (void*)attribute.offset);
+	}
+
+	// Element buffer binding is part of the VAO state
+	if (indexBufferID != 0)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return vertexArray;
+}
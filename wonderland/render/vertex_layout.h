@@ -0,0 +1,45 @@
+#ifndef _VERTEX_LAYOUT_H_
+#define _VERTEX_LAYOUT_H_
+
+#include <glad/gl.h>
+#include <render/gl_resource.h>
+#include <vector>
+#include <cstddef>
+
+#define MAX_VERTEX_ATTRIBUTES (8)
+
+struct VertexAttribute {
+	GLint location;		// shader location, -1 to leave the attribute out
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	size_t offset;		// bytes from the start of the vertex
+};
+
+// How one interleaved vertex buffer is laid out
+struct VertexLayout {
+	GLsizei stride;
+	int attributeCount;
+	VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+
+	VertexLayout();
+	void add(GLint location, GLint size, GLenum type, GLboolean normalized, size_t offset);
+};
+
+// One float attribute stored on its own, the way the built-in mesh arrays are
+struct VertexStream {
+	GLint location;
+	GLint components;
+	const GLfloat* data;
+};
+
+// Packs separate streams into one interleaved buffer and fills in the matching layout
+void interleaveStreams(const VertexStream* streams, int streamCount, int vertexCount,
+	std::vector<GLfloat>& vertices, VertexLayout& layout);
+
+// Vertex array with the layout and the index buffer captured in it, so drawing only
+// needs a glBindVertexArray. Pass 0 for indexBufferID if there isnt one. owner is
+// what it shows up under in the GL resource tracker.
+GLVertexArray createVertexArray(GLuint vertexBufferID, GLuint indexBufferID, const VertexLayout& layout, const std::string& owner);
+
+#endif
@@ -0,0 +1,416 @@
+#include "builtin_meshes.h"
+
+#include <cstddef>
+
+// Skybox - a canonical box, see Skybox_Files/Skybox_1.png for the UV layout
+const GLfloat skybox_vertex_buffer_data[72] = {	// Vertex definition for a canonical box
+	// if we swap position of two opposite corners, then rotate 90 degrees to right, it swaps
+	// left - all good
+	//  z,    y,   x   
+	-1.0f, -1.0f, 1.0f,		// top left
+	-1.0f, 1.0f, 1.0f,		// bottom left
+	1.0f, 1.0f, 1.0f,		// bottom right
+	1.0f, -1.0f, 1.0f,		// top right
+
+	// right - All good
+	1.0f, -1.0f, -1.0f,		// bottom right
+	1.0f, 1.0f, -1.0f,		// top right
+	-1.0f, 1.0f, -1.0f,		// top left
+	-1.0f, -1.0f, -1.0f,	// bottom left
+
+	// front - All good
+	-1.0f, -1.0f, -1.0f,	// bottom left
+	-1.0f, 1.0f, -1.0f,		// top left
+	-1.0f, 1.0f, 1.0f,		// top right
+	-1.0f, -1.0f, 1.0f,		// bottom right
+
+	// behind - All good
+	1.0f, -1.0f, 1.0f,		// bottom right
+	1.0f, 1.0f, 1.0f,		// top right
+	1.0f, 1.0f, -1.0f,		// top left
+	1.0f, -1.0f, -1.0f,		// bottom left
+
+	// top - All good
+	-1.0f, 1.0f, -1.0f,		// 
+	1.0f, 1.0f, -1.0f,
+	1.0f, 1.0f, 1.0f,		//
+	-1.0f, 1.0f, 1.0f,
+
+	// bottom - pointing outwards (flip by swapping zs)
+	1.0f, -1.0f, -1.0f,		//
+	-1.0f, -1.0f, -1.0f,
+	-1.0f, -1.0f, 1.0f,		//
+	1.0f, -1.0f, 1.0f,
+};
+
+const GLfloat skybox_color_buffer_data[72] = {
+	// Front, red
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	// Back, yellow
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+
+	// Left, green
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	// Right, cyan
+	0.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f,
+
+	// Top, blue
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	// Bottom, magenta
+	1.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 1.0f,
+};
+
+const GLuint skybox_index_buffer_data[36] = {		// 12 triangle faces of a box
+	0, 1, 2,
+	0, 2, 3,
+
+	4, 5, 6,
+	4, 6, 7,
+
+	8, 9, 10,
+	8, 10, 11,
+
+	12, 13, 14,
+	12, 14, 15,
+
+	16, 17, 18,
+	16, 18, 19,
+
+	20, 21, 22,
+	20, 22, 23,
+};
+
+// Here I am making everything end 1 before it actually should because I was getting black lines in the skybox
+const GLfloat skybox_uv_buffer_data[48] = {
+	// x, y
+	// left
+	0.25f, 0.334f,		// bottom right
+	0.25f, 0.666f,		// top right
+	0.0f, 0.666f,		// top left					BRING BACK
+	0.0f, 0.334f,		// bottom left
+	// right
+	0.75f, 0.334f,
+	0.75f, 0.666f,
+	0.5f, 0.666f,
+	0.5f, 0.334f,
+	// front
+	0.5f, 0.334f,		// bottom right
+	0.5f, 0.666f,		// top right
+	0.25f, 0.666f,		// top left
+	0.25f, 0.334f,		// bottom left
+	// behind
+	1.0f, 0.334f,
+	1.0f, 0.666f,
+	0.75f, 0.666f,
+	0.75f, 0.334f,
+	// Top
+	0.5f, 0.667f,		// 
+	0.5f, 1.0f,			//
+	0.251f, 1.0f,		// X is higher to avoid a black line
+	0.251f, 0.667f,		// 
+	// Bottom
+	0.499f, 0.0f,
+	0.499f, 0.334f,
+	0.25f, 0.334f,
+	0.25f, 0.0f,
+
+};
+
+// Ground - one unit tile, scaled up by tileSize when drawn
+const GLfloat ground_vertex_buffer_data[12] = {
+	-0.5f, 0.0f, -0.5f,
+	 0.5f, 0.0f, -0.5f,
+	 0.5f, 0.0f,  0.5f,
+	-0.5f, 0.0f,  0.5f
+};
+
+const GLfloat ground_uv_buffer_data[8] = {
+	0.0f, 0.0f,
+	1.0f, 0.0f,
+	1.0f, 1.0f,
+	0.0f, 1.0f
+};
+
+const GLuint ground_index_buffer_data[6] = {
+	0, 2, 1,
+	0, 3, 2
+};
+
+// Box - the Cornell style building in wonderland_redo
+const GLfloat boxVertexBufferData[60] = {
+	// This doesnt include one of the vertexes  - its fine its not visible
+	-105.75, 82.5, -61.75,
+	-66.25, 82.5, -74.0,
+	-78.5, 82.5, -114.0,
+	-118.0, 82.5, -101.5,
+
+	-105.75, 0.0, -61.75,
+	-105.75, 82.5, -61.75,
+	-118.0, 82.5, -101.5,
+	-118.0, 0.0, -101.5,
+
+	-118.0, 0.0, -101.5,
+	-118.0, 82.5, -101.5,
+	-78.5, 82.5, -114.0,
+	-78.5, 0.0, -114.0,
+
+	-78.5, 0.0, -114.0,
+	-78.5, 82.5, -114.0,
+	-66.25, 82.5, -74.0,
+	-66.25, 0.0, -74.0,
+
+	-66.25, 0.0, -74.0,
+	-66.25, 82.5, -74.0,
+	-105.75, 82.5, -61.75,
+	-105.75, 0.0, -61.75
+};
+
+const GLfloat boxNormalBufferData[60] = {
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+};
+
+const GLfloat boxColorBufferData[60] = {
+	// Floor
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Ceiling
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Left wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Right wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Back wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f
+};
+
+// Refer to original Cornell Box data 
+// from https://www.graphics.cornell.edu/online/box/data.html
+const GLuint box_index_buffer_data[30] = {
+	0, 1, 2,
+	0, 2, 3,
+
+	4, 5, 6,
+	4, 6, 7,
+
+	8, 9, 10,
+	8, 10, 11,
+
+	12, 13, 14,
+	12, 14, 15,
+
+	16, 17, 18,
+	16, 18, 19,
+};
+
+// Tall and small boxes from wonderland_window, they share the box indices
+const GLfloat tallBoxVertexBufferData[60] = {
+	// This doesnt include one of the vertexes  - its fine its not visible
+	-423.0, 330.0, -247.0,
+	-265.0, 330.0, -296.0,
+	-314.0, 330.0, -456.0,
+	-472.0, 330.0, -406.0,
+
+	-423.0,   0.0, -247.0,
+	-423.0, 330.0, -247.0,
+	-472.0, 330.0, -406.0,
+	-472.0,   0.0, -406.0,
+
+	-472.0,   0.0, -406.0,
+	-472.0, 330.0, -406.0,
+	-314.0, 330.0, -456.0,
+	-314.0,   0.0, -456.0,
+
+	-314.0,   0.0, -456.0,
+	-314.0, 330.0, -456.0,
+	-265.0, 330.0, -296.0,
+	-265.0,   0.0, -296.0,
+
+	-265.0,   0.0, -296.0,
+	-265.0, 330.0, -296.0,
+	-423.0, 330.0, -247.0,
+	-423.0,   0.0, -247.0
+};
+
+const GLfloat tallBoxNormalBufferData[60] = {
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+	0.956, 0.0, 0.295,
+
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+	0.302, 0.0, -0.953,
+
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+	-0.955, 0.0, -0.293,
+
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+	-0.296, 0.0, 0.955,
+};
+
+const GLfloat smallBoxVertexBufferData[60] = {
+	-130.0, 165.0,  -65.0,
+	 -82.0, 165.0, -225.0,
+	-240.0, 165.0, -272.0,
+	-290.0, 165.0, -114.0,
+
+	-290.0,   0.0, -114.0,
+	-290.0, 165.0, -114.0,
+	-240.0, 165.0, -272.0,
+	-240.0,   0.0, -272.0,
+
+	-130.0,   0.0,  -65.0,
+	-130.0, 165.0,  -65.0,
+	-290.0, 165.0, -114.0,
+	-290.0,   0.0, -114.0,
+
+	 -82.0,   0.0, -225.0,
+	 -82.0, 165.0, -225.0,
+	-130.0, 165.0,  -65.0,
+	-130.0,   0.0,  -65.0,
+
+	-240.0,   0.0, -272.0,
+	-240.0, 165.0, -272.0,
+	 -82.0, 165.0, -225.0,
+	 -82.0,   0.0, -225.0
+};
+
+const GLfloat smallBoxNormalBufferData[60] = {
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+	0.0, 1.0, 0.0,
+
+	0.953, 0.0, 0.302,
+	0.953, 0.0, 0.302,
+	0.953, 0.0, 0.302,
+	0.953, 0.0, 0.302,
+
+	0.293, 0.0, -0.957,
+	0.293, 0.0, -0.957,
+	0.293, 0.0, -0.957,
+	0.293, 0.0, -0.957,
+
+	-0.958, 0.0, -0.287,
+	-0.958, 0.0, -0.287,
+	-0.958, 0.0, -0.287,
+	-0.958, 0.0, -0.287,
+
+	-0.285, 0.0, 0.958,
+	-0.285, 0.0, 0.958,
+	-0.285, 0.0, 0.958,
+	-0.285, 0.0, 0.958
+};
+
+const GLfloat otherBoxColorBufferData[60] = {
+	// Floor
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Ceiling
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Left wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Right wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Back wall
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f
+};
+
+const BuiltinMesh builtinMeshes[] = {
+	{ "skybox", skybox_vertex_buffer_data, skybox_color_buffer_data, NULL, skybox_uv_buffer_data, 24, skybox_index_buffer_data, 36, "Skybox_1.png" },
+	{ "ground", ground_vertex_buffer_data, NULL, NULL, ground_uv_buffer_data, 4, ground_index_buffer_data, 6, "IMGP1394.jpg" },
+	{ "box", boxVertexBufferData, boxColorBufferData, boxNormalBufferData, NULL, 20, box_index_buffer_data, 30, NULL },
+	{ "tallBox", tallBoxVertexBufferData, otherBoxColorBufferData, tallBoxNormalBufferData, NULL, 20, box_index_buffer_data, 30, NULL },
+	{ "smallBox", smallBoxVertexBufferData, otherBoxColorBufferData, smallBoxNormalBufferData, NULL, 20, box_index_buffer_data, 30, NULL },
+};
+const int builtinMeshCount = sizeof(builtinMeshes) / sizeof(builtinMeshes[0]);
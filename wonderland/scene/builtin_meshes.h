@@ -0,0 +1,44 @@
+#ifndef _BUILTIN_MESHES_H_
+#define _BUILTIN_MESHES_H_
+
+#include <glad/gl.h>
+
+// Hand made meshes shared by the viewers and baked into cooked scenes by wonderland_cook
+
+extern const GLfloat skybox_vertex_buffer_data[72];
+extern const GLfloat skybox_color_buffer_data[72];
+extern const GLuint skybox_index_buffer_data[36];
+extern const GLfloat skybox_uv_buffer_data[48];
+
+extern const GLfloat ground_vertex_buffer_data[12];
+extern const GLfloat ground_uv_buffer_data[8];
+extern const GLuint ground_index_buffer_data[6];
+
+extern const GLfloat boxVertexBufferData[60];
+extern const GLfloat boxNormalBufferData[60];
+extern const GLfloat boxColorBufferData[60];
+extern const GLuint box_index_buffer_data[30];
+
+extern const GLfloat tallBoxVertexBufferData[60];
+extern const GLfloat tallBoxNormalBufferData[60];
+extern const GLfloat smallBoxVertexBufferData[60];
+extern const GLfloat smallBoxNormalBufferData[60];
+extern const GLfloat otherBoxColorBufferData[60];
+
+// Describes one of the meshes above for tools that want all of them
+struct BuiltinMesh {
+	const char* name;
+	const GLfloat* positions;
+	const GLfloat* colors;		// NULL means white
+	const GLfloat* normals;		// NULL means work them out from the triangles
+	const GLfloat* uvs;			// NULL means (0, 0)
+	int vertexCount;
+	const GLuint* indices;
+	int indexCount;
+	const char* texture;		// file name of the image it's drawn with, NULL if none
+};
+
+extern const BuiltinMesh builtinMeshes[];
+extern const int builtinMeshCount;
+
+#endif
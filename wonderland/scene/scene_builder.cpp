@@ -0,0 +1,332 @@
+#include "scene_builder.h"
+#include "builtin_meshes.h"
+#include <model/quantize.h>
+
+#include <glm/gtc/type_ptr.hpp>
+#include <stb/stb_image.h>
+
+#include <iostream>
+#include <cstring>
+
+static std::string baseName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static void copyName(char* out, const std::string& name)
+{
+	if (name.size() >= SCENE_NAME_LENGTH)
+		std::cout << "WARN: name " << name << " is too long and will be cut short" << std::endl;
+	memset(out, 0, SCENE_NAME_LENGTH);
+	strncpy(out, name.c_str(), SCENE_NAME_LENGTH - 1);
+}
+
+SceneBuilder::SceneBuilder()
+	: optimizeMeshes(true)
+{
+}
+
+bool loadSceneTexture(const std::string& path, SceneTexture& texture, std::vector<unsigned char>& data)
+{
+	// Per thread setting, other threads may be loading at the same time
+	int w, h, channels;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* img = stbi_load(path.c_str(), &w, &h, &channels, 3);
+	if (!img)
+	{
+		std::cout << "Failed to load texture " << path << std::endl;
+		return false;
+	}
+
+	memset(&texture, 0, sizeof(texture));
+	copyName(texture.name, baseName(path));
+	texture.width = w;
+	texture.height = h;
+
+	data.assign(img, img + w * h * 3);
+	stbi_image_free(img);
+
+	size_t levelStart = 0;
+	texture.levels = 1;
+	while (w > 1 || h > 1)
+	{
+		int nw = w > 1 ? w / 2 : 1;
+		int nh = h > 1 ? h / 2 : 1;
+		size_t nextStart = data.size();
+		data.resize(nextStart + nw * nh * 3);
+		for (int y = 0; y < nh; ++y)
+		{
+			for (int x = 0; x < nw; ++x)
+			{
+				// Odd sizes just clamp, the last row/column gets dropped
+				int x0 = x * 2, x1 = x0 + 1 < w ? x0 + 1 : x0;
+				int y0 = y * 2, y1 = y0 + 1 < h ? y0 + 1 : y0;
+				for (int c = 0; c < 3; ++c)
+				{
+					int sum = data[levelStart + (y0 * w + x0) * 3 + c] + data[levelStart + (y0 * w + x1) * 3 + c]
+						+ data[levelStart + (y1 * w + x0) * 3 + c] + data[levelStart + (y1 * w + x1) * 3 + c];
+					data[nextStart + (y * nw + x) * 3 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		levelStart = nextStart;
+		w = nw;
+		h = nh;
+		texture.levels++;
+	}
+	texture.dataSize = data.size();
+	return true;
+}
+
+bool SceneBuilder::addTexture(const std::string& path)
+{
+	SceneTexture texture;
+	std::vector<unsigned char> data;
+	if (!loadSceneTexture(path, texture, data))
+		return false;
+	addTexture(texture, data);
+	return true;
+}
+
+void SceneBuilder::addTexture(const SceneTexture& texture, const std::vector<unsigned char>& textureTexels)
+{
+	textures.push_back(texture);
+	texels.push_back(textureTexels);
+}
+
+int SceneBuilder::findTexture(const char* name) const
+{
+	for (size_t i = 0; name && i < textures.size(); ++i)
+		if (strncmp(textures[i].name, name, SCENE_NAME_LENGTH) == 0)
+			return (int)i;
+	return -1;
+}
+
+int SceneBuilder::addMesh(const std::string& name, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& colors, const std::vector<glm::vec2>& uvs, const std::vector<uint32_t>& meshIndices, int texture)
+{
+	for (size_t i = 0; i < meshIndices.size(); ++i)
+	{
+		if (meshIndices[i] >= positions.size())
+		{
+			std::cout << "Mesh " << name << " has index " << meshIndices[i] << " past its " << positions.size() << " vertices" << std::endl;
+			return -1;
+		}
+	}
+
+	SceneMesh mesh;
+	memset(&mesh, 0, sizeof(mesh));
+	copyName(mesh.name, name);
+	mesh.firstVertex = (uint32_t)vertices.size();
+	mesh.firstIndex = (uint32_t)indices.size();
+	mesh.indexCount = (uint32_t)meshIndices.size();
+	mesh.texture = texture;
+
+	std::vector<glm::vec3> smoothNormals;
+	if (normals.size() != positions.size())
+	{
+		smoothNormals.assign(positions.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < meshIndices.size(); i += 3)
+		{
+			uint32_t a = meshIndices[i], b = meshIndices[i + 1], c = meshIndices[i + 2];
+			glm::vec3 faceNormal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+			smoothNormals[a] += faceNormal;
+			smoothNormals[b] += faceNormal;
+			smoothNormals[c] += faceNormal;
+		}
+		for (size_t i = 0; i < smoothNormals.size(); ++i)
+		{
+			float length = glm::length(smoothNormals[i]);
+			smoothNormals[i] = length > 0.0f ? smoothNormals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+	const std::vector<glm::vec3>& meshNormals = smoothNormals.empty() ? normals : smoothNormals;
+
+	glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		boundsMin = glm::min(boundsMin, positions[i]);
+		boundsMax = glm::max(boundsMax, positions[i]);
+	}
+	if (positions.empty())
+		boundsMin = boundsMax = glm::vec3(0.0f);
+	memcpy(mesh.boundsMin, &boundsMin[0], sizeof(mesh.boundsMin));
+	memcpy(mesh.boundsMax, &boundsMax[0], sizeof(mesh.boundsMax));
+
+	glm::mat4 dequantize = positionDequantization(boundsMin, boundsMax);
+	glm::mat4 quantize = glm::inverse(dequantize);
+	memcpy(mesh.dequantize, glm::value_ptr(dequantize), sizeof(mesh.dequantize));
+
+	std::vector<SceneVertex> meshVertices;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		SceneVertex v;
+		memset(&v, 0, sizeof(v));
+		glm::vec3 color = i < colors.size() ? colors[i] : glm::vec3(1.0f);
+		glm::vec2 uv = i < uvs.size() ? uvs[i] : glm::vec2(0.0f);
+
+		quantizePosition(positions[i], quantize, v.position);
+		encodeOctahedral(meshNormals[i], v.normal);
+		v.uv[0] = quantizeHalf(uv.x);
+		v.uv[1] = quantizeHalf(uv.y);
+		for (int c = 0; c < 3; ++c)
+			v.color[c] = quantizeUnorm8(color[c]);
+		v.color[3] = 255;
+		meshVertices.push_back(v);
+	}
+
+	std::vector<unsigned int> optimizedIndices(meshIndices.begin(), meshIndices.end());
+	if (optimizeMeshes)
+		optimize(meshVertices, positions, optimizedIndices);
+	mesh.vertexCount = (uint32_t)meshVertices.size();
+	vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+
+	// Left relative to the mesh, the viewer draws with firstVertex as the base vertex
+	indices.insert(indices.end(), optimizedIndices.begin(), optimizedIndices.end());
+
+	meshes.push_back(mesh);
+	return (int)meshes.size() - 1;
+}
+
+// Welding works on the quantized vertices, so anything that quantizes to the same
+// bytes gets merged. Positions only go along for the overdraw sort.
+void SceneBuilder::optimize(std::vector<SceneVertex>& meshVertices, const std::vector<glm::vec3>& positions, std::vector<unsigned int>& meshIndices)
+{
+	MeshOptimizeReport report;
+	report.verticesBefore = meshVertices.size();
+	report.cacheBefore = analyzeVertexCache(meshIndices, meshVertices.size());
+	report.fetchBefore = analyzeVertexFetch(meshIndices, meshVertices.size(), sizeof(SceneVertex));
+
+	std::vector<unsigned int> remap;
+	size_t weldedCount = buildWeldRemap(meshVertices.data(), meshVertices.size(), sizeof(SceneVertex), remap);
+	std::vector<SceneVertex> welded(weldedCount);
+	std::vector<glm::vec3> weldedPositions(weldedCount);
+	remapVertices(welded.data(), meshVertices.data(), meshVertices.size(), sizeof(SceneVertex), remap);
+	remapVertices(weldedPositions.data(), positions.data(), positions.size(), sizeof(glm::vec3), remap);
+	remapIndices(meshIndices, remap);
+
+	optimizeVertexCache(meshIndices, weldedCount);
+	optimizeOverdraw(meshIndices, weldedPositions);
+
+	size_t fetchCount = buildFetchRemap(meshIndices, weldedCount, remap);
+	meshVertices.resize(fetchCount);
+	remapVertices(meshVertices.data(), welded.data(), weldedCount, sizeof(SceneVertex), remap);
+	remapIndices(meshIndices, remap);
+
+	report.verticesAfter = meshVertices.size();
+	report.cacheAfter = analyzeVertexCache(meshIndices, meshVertices.size());
+	report.fetchAfter = analyzeVertexFetch(meshIndices, meshVertices.size(), sizeof(SceneVertex));
+	reports.push_back(report);
+}
+
+void SceneBuilder::printReport(const std::string& label, size_t firstMesh, size_t endMesh) const
+{
+	size_t triangles = 0, verticesBefore = 0, verticesAfter = 0, missesBefore = 0, missesAfter = 0, fetchedBefore = 0, fetchedAfter = 0;
+	for (size_t i = firstMesh; i < endMesh && i < reports.size(); ++i)
+	{
+		const MeshOptimizeReport& report = reports[i];
+		triangles += report.cacheBefore.triangles;
+		verticesBefore += report.verticesBefore;
+		verticesAfter += report.verticesAfter;
+		missesBefore += report.cacheBefore.misses;
+		missesAfter += report.cacheAfter.misses;
+		fetchedBefore += report.fetchBefore.bytesFetched;
+		fetchedAfter += report.fetchAfter.bytesFetched;
+	}
+	if (triangles == 0 || verticesAfter == 0)
+		return;
+
+	size_t bytesBefore = verticesBefore * sizeof(SceneVertex), bytesAfter = verticesAfter * sizeof(SceneVertex);
+	std::cout << label << ": " << triangles << " triangles, vertices " << verticesBefore << " -> " << verticesAfter
+		<< ", ACMR " << (float)missesBefore / triangles << " -> " << (float)missesAfter / triangles
+		<< ", ATVR " << (float)missesBefore / verticesBefore << " -> " << (float)missesAfter / verticesAfter
+		<< ", overfetch " << (float)fetchedBefore / bytesBefore << " -> " << (float)fetchedAfter / bytesAfter << std::endl;
+}
+
+void SceneBuilder::addNode(const std::string& name, int mesh, const glm::mat4& transform)
+{
+	SceneNode node;
+	memset(&node, 0, sizeof(node));
+	copyName(node.name, name);
+	node.mesh = mesh;
+	memcpy(node.transform, glm::value_ptr(transform), sizeof(node.transform));
+	nodes.push_back(node);
+}
+
+void SceneBuilder::addBuiltinMeshes()
+{
+	for (int m = 0; m < builtinMeshCount; ++m)
+	{
+		const BuiltinMesh& builtin = builtinMeshes[m];
+
+		std::vector<glm::vec3> positions, normals, colors;
+		std::vector<glm::vec2> uvs;
+		for (int i = 0; i < builtin.vertexCount; ++i)
+		{
+			positions.push_back(glm::make_vec3(builtin.positions + i * 3));
+			if (builtin.normals)
+				normals.push_back(glm::make_vec3(builtin.normals + i * 3));
+			if (builtin.colors)
+				colors.push_back(glm::make_vec3(builtin.colors + i * 3));
+			if (builtin.uvs)
+				uvs.push_back(glm::make_vec2(builtin.uvs + i * 2));
+		}
+		std::vector<uint32_t> meshIndices(builtin.indices, builtin.indices + builtin.indexCount);
+
+		int texture = findTexture(builtin.texture);
+		if (builtin.texture && texture < 0)
+			std::cout << "WARN: " << builtin.name << " wants " << builtin.texture << " but it wasnt loaded, it will be untextured" << std::endl;
+
+		addMesh(builtin.name, positions, normals, colors, uvs, meshIndices, texture);
+	}
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + SCENE_ALIGNMENT - 1) / SCENE_ALIGNMENT * SCENE_ALIGNMENT;
+}
+
+static void copyBlob(std::vector<unsigned char>& out, uint64_t offset, const void* data, size_t bytes)
+{
+	if (bytes > 0)
+		memcpy(&out[offset], data, bytes);
+}
+
+void SceneBuilder::serialize(std::vector<unsigned char>& out) const
+{
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SCENE_MAGIC;
+	header.version = SCENE_VERSION;
+	header.vertexStride = sizeof(SceneVertex);
+	header.meshCount = (uint32_t)meshes.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	header.textureCount = (uint32_t)textures.size();
+	header.vertexCount = vertices.size();
+	header.indexCount = indices.size();
+
+	header.meshOffset = alignOffset(sizeof(SceneHeader));
+	header.nodeOffset = alignOffset(header.meshOffset + meshes.size() * sizeof(SceneMesh));
+	header.textureOffset = alignOffset(header.nodeOffset + nodes.size() * sizeof(SceneNode));
+	header.vertexOffset = alignOffset(header.textureOffset + textures.size() * sizeof(SceneTexture));
+	header.indexOffset = alignOffset(header.vertexOffset + vertices.size() * sizeof(SceneVertex));
+
+	std::vector<SceneTexture> placedTextures = textures;
+	uint64_t offset = alignOffset(header.indexOffset + indices.size() * sizeof(uint32_t));
+	for (size_t i = 0; i < placedTextures.size(); ++i)
+	{
+		placedTextures[i].dataOffset = offset;
+		offset = alignOffset(offset + placedTextures[i].dataSize);
+	}
+
+	out.assign((size_t)offset, 0);
+	copyBlob(out, 0, &header, sizeof(header));
+	copyBlob(out, header.meshOffset, meshes.data(), meshes.size() * sizeof(SceneMesh));
+	copyBlob(out, header.nodeOffset, nodes.data(), nodes.size() * sizeof(SceneNode));
+	copyBlob(out, header.textureOffset, placedTextures.data(), placedTextures.size() * sizeof(SceneTexture));
+	copyBlob(out, header.vertexOffset, vertices.data(), vertices.size() * sizeof(SceneVertex));
+	copyBlob(out, header.indexOffset, indices.data(), indices.size() * sizeof(uint32_t));
+	for (size_t i = 0; i < placedTextures.size(); ++i)
+		copyBlob(out, placedTextures[i].dataOffset, texels[i].data(), texels[i].size());
+}
@@ -0,0 +1,70 @@
+#ifndef _SCENE_BUILDER_H_
+#define _SCENE_BUILDER_H_
+
+#include <glm/glm.hpp>
+#include <model/mesh_optimize.h>
+#include "scene_format.h"
+
+#include <vector>
+#include <string>
+
+// What the optimisation pass did to one mesh
+struct MeshOptimizeReport {
+	size_t verticesBefore;
+	size_t verticesAfter;
+	VertexCacheStats cacheBefore;
+	VertexCacheStats cacheAfter;
+	VertexFetchStats fetchBefore;
+	VertexFetchStats fetchAfter;
+};
+
+// Collects meshes, nodes and textures and lays them out as a cooked scene.
+// wonderland_cook writes the result to disk, the viewer can also build one in
+// memory when there is no cooked file.
+struct SceneBuilder {
+	// Weld, then reorder for the vertex cache, overdraw and vertex fetch as meshes are added
+	bool optimizeMeshes;
+	std::vector<MeshOptimizeReport> reports;	// one per mesh added while optimizeMeshes was on
+
+	std::vector<SceneVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneNode> nodes;
+	std::vector<SceneTexture> textures;
+	std::vector<std::vector<unsigned char> > texels;
+
+	SceneBuilder();
+
+	// Loads an image flipped the same way the viewer always has and builds every mip
+	// level down to 1x1 with a box filter. Named after the file, without the directory.
+	bool addTexture(const std::string& path);
+	// Adds one that loadSceneTexture already decoded
+	void addTexture(const SceneTexture& texture, const std::vector<unsigned char>& textureTexels);
+	int findTexture(const char* name) const;
+
+	// Appends a mesh to the shared buffers, quantizing its vertices. Missing normals are
+	// worked out from the triangles, missing colors are white and missing uvs are 0.
+	// -1 if an index points past the vertices, nothing is added then.
+	int addMesh(const std::string& name, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec3>& colors, const std::vector<glm::vec2>& uvs, const std::vector<uint32_t>& meshIndices, int texture);
+
+	void addNode(const std::string& name, int mesh, const glm::mat4& transform);
+
+	// Everything in builtin_meshes, textured with whichever images were added already
+	void addBuiltinMeshes();
+
+	// Prints ACMR/ATVR and overfetch before and after optimising, summed over a range of meshes
+	void printReport(const std::string& label, size_t firstMesh, size_t endMesh) const;
+
+	// The whole scene file, ready to write out or hand to SceneFile::openMemory
+	void serialize(std::vector<unsigned char>& out) const;
+
+private:
+	void optimize(std::vector<SceneVertex>& meshVertices, const std::vector<glm::vec3>& positions, std::vector<unsigned int>& meshIndices);
+};
+
+// The decoding half of SceneBuilder::addTexture. Doesnt touch any shared state, so
+// several images can be loaded at once on different threads.
+bool loadSceneTexture(const std::string& path, SceneTexture& texture, std::vector<unsigned char>& texels);
+
+#endif
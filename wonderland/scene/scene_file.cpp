@@ -0,0 +1,338 @@
+#include "scene_file.h"
+#include <render/vertex_layout.h>
+
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SceneFile::SceneFile()
+	: data(NULL), size(0), mapped(false), header(NULL), meshes(NULL), nodes(NULL), textures(NULL)
+#ifdef _WIN32
+	, fileHandle(NULL), mappingHandle(NULL)
+#endif
+{
+}
+
+// count elements of elementSize bytes, checked by dividing so a huge count cant wrap
+static bool inFile(uint64_t offset, uint64_t count, size_t elementSize, size_t size)
+{
+	return offset <= size && count <= (size - offset) / elementSize && offset % SCENE_ALIGNMENT == 0;
+}
+
+// Names are fixed size records, the cooker always leaves a terminator in them
+static bool terminated(const char* name)
+{
+	return memchr(name, 0, SCENE_NAME_LENGTH) != NULL;
+}
+
+bool SceneFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Couldnt open scene " << path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!view)
+	{
+		std::cout << "Couldnt map scene " << path << std::endl;
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cout << "Couldnt open scene " << path << std::endl;
+		return false;
+	}
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+		view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// the mapping keeps the file alive
+	if (view == MAP_FAILED)
+	{
+		std::cout << "Couldnt map scene " << path << std::endl;
+		return false;
+	}
+	size = (size_t)info.st_size;
+#endif
+	data = (const unsigned char*)view;
+	mapped = true;
+	return parse(path);
+}
+
+bool SceneFile::openMemory(const unsigned char* buffer, size_t bufferSize)
+{
+	close();
+	data = buffer;
+	size = bufferSize;
+	return parse("Scene");
+}
+
+bool SceneFile::parse(const std::string& path)
+{
+	header = (const SceneHeader*)data;
+	if (size < sizeof(SceneHeader) || header->magic != SCENE_MAGIC)
+	{
+		std::cout << path << " isnt a cooked scene" << std::endl;
+		close();
+		return false;
+	}
+	if (header->version != SCENE_VERSION || header->vertexStride != sizeof(SceneVertex))
+	{
+		std::cout << path << " was cooked with version " << header->version << ", expected " << SCENE_VERSION << ". Run wonderland_cook again" << std::endl;
+		close();
+		return false;
+	}
+	if (!inFile(header->meshOffset, header->meshCount, sizeof(SceneMesh), size) ||
+		!inFile(header->nodeOffset, header->nodeCount, sizeof(SceneNode), size) ||
+		!inFile(header->textureOffset, header->textureCount, sizeof(SceneTexture), size) ||
+		!inFile(header->vertexOffset, header->vertexCount, sizeof(SceneVertex), size) ||
+		!inFile(header->indexOffset, header->indexCount, sizeof(GLuint), size))
+	{
+		std::cout << path << " is truncated" << std::endl;
+		close();
+		return false;
+	}
+
+	meshes = (const SceneMesh*)(data + header->meshOffset);
+	nodes = (const SceneNode*)(data + header->nodeOffset);
+	textures = (const SceneTexture*)(data + header->textureOffset);
+
+	for (uint32_t i = 0; i < header->meshCount; ++i)
+	{
+		if (!terminated(meshes[i].name))
+		{
+			std::cout << path << " has a mesh name without an end" << std::endl;
+			close();
+			return false;
+		}
+		if ((uint64_t)meshes[i].firstVertex + meshes[i].vertexCount > header->vertexCount ||
+			(uint64_t)meshes[i].firstIndex + meshes[i].indexCount > header->indexCount)
+		{
+			std::cout << path << " has a mesh outside the vertex/index data" << std::endl;
+			close();
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->nodeCount; ++i)
+	{
+		if (!terminated(nodes[i].name))
+		{
+			std::cout << path << " has a node name without an end" << std::endl;
+			close();
+			return false;
+		}
+	}
+
+	// Indices are relative to their mesh, so each one has to stay inside it
+	const GLuint* allIndices = indices();
+	for (uint32_t i = 0; i < header->meshCount; ++i)
+	{
+		const SceneMesh& mesh = meshes[i];
+		for (uint32_t j = 0; j < mesh.indexCount; ++j)
+		{
+			if ((uint64_t)mesh.firstVertex + allIndices[mesh.firstIndex + j] >= header->vertexCount)
+			{
+				std::cout << path << " has an index past the end of the vertices in mesh " << i << std::endl;
+				close();
+				return false;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < header->textureCount; ++i)
+	{
+		if (!inFile(textures[i].dataOffset, textures[i].dataSize, 1, size))
+		{
+			std::cout << path << " is truncated" << std::endl;
+			close();
+			return false;
+		}
+		if (!terminated(textures[i].name))
+		{
+			std::cout << path << " has a texture name without an end" << std::endl;
+			close();
+			return false;
+		}
+
+		// Every level gets uploaded straight out of the file, so they all have to fit.
+		// Stops as soon as it's too big, a silly width or level count can't overflow it.
+		const SceneTexture& texture = textures[i];
+		uint64_t levelBytes = 0;
+		uint64_t width = texture.width, height = texture.height;
+		bool fits = width > 0 && height > 0 && texture.levels > 0 && texture.levels <= 32;
+		for (uint32_t level = 0; fits && level < texture.levels; ++level)
+		{
+			fits = width <= texture.dataSize / height / 3 && levelBytes + width * height * 3 <= texture.dataSize;
+			levelBytes += width * height * 3;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		if (!fits)
+		{
+			std::cout << path << " has a bad texture, " << texture.levels << " levels of " << texture.width << "x"
+				<< texture.height << " in " << texture.dataSize << " bytes" << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void SceneFile::close()
+{
+	if (data && mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mappingHandle);
+		CloseHandle((HANDLE)fileHandle);
+		fileHandle = mappingHandle = NULL;
+#else
+		munmap((void*)data, size);
+#endif
+	}
+	data = NULL;
+	size = 0;
+	mapped = false;
+	header = NULL;
+	meshes = NULL;
+	nodes = NULL;
+	textures = NULL;
+}
+
+int SceneFile::findMesh(const char* name) const
+{
+	for (uint32_t i = 0; header && i < header->meshCount; ++i)
+		if (strncmp(meshes[i].name, name, SCENE_NAME_LENGTH) == 0)
+			return (int)i;
+	return -1;
+}
+
+int SceneFile::findTexture(const char* name) const
+{
+	for (uint32_t i = 0; header && i < header->textureCount; ++i)
+		if (strncmp(textures[i].name, name, SCENE_NAME_LENGTH) == 0)
+			return (int)i;
+	return -1;
+}
+
+const SceneVertex* SceneFile::vertices() const
+{
+	return (const SceneVertex*)(data + header->vertexOffset);
+}
+
+const GLuint* SceneFile::indices() const
+{
+	return (const GLuint*)(data + header->indexOffset);
+}
+
+const unsigned char* SceneFile::texels(const SceneTexture& texture) const
+{
+	return data + texture.dataOffset;
+}
+
+bool GpuScene::initialize(const SceneFile& scene, MeshArena& meshArena)
+{
+	const SceneHeader& header = *scene.header;
+	arena = &meshArena;
+
+	meshRanges.resize(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		const SceneMesh& mesh = scene.meshes[i];
+		if (!arena->add(scene.vertices() + mesh.firstVertex, mesh.vertexCount,
+			scene.indices() + mesh.firstIndex, mesh.indexCount, meshRanges[i]))
+			return false;
+	}
+
+	// Mips were made by the cooker, so this is just copying each level in
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	textureIDs.resize(header.textureCount);
+	for (uint32_t i = 0; i < header.textureCount; ++i)
+	{
+		const SceneTexture& texture = scene.textures[i];
+		textureIDs[i].create(std::string("scene texture ") + texture.name);
+		glBindTexture(GL_TEXTURE_2D, textureIDs[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+
+		const unsigned char* texels = scene.texels(texture);
+		int width = texture.width, height = texture.height;
+		for (uint32_t level = 0; level < texture.levels; ++level)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+			texels += width * height * 3;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		textureIDs[i].setBytes(glTextureBytes(GL_RGB, texture.width, texture.height, texture.levels));
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+GLuint GpuScene::vertexArray(GLint positionLocation, GLint normalLocation, GLint colorLocation, GLint uvLocation)
+{
+	VertexArray layout;
+	GLint locations[4] = { positionLocation, normalLocation, colorLocation, uvLocation };
+	memcpy(layout.locations, locations, sizeof(locations));
+	for (size_t i = 0; i < vertexArrays.size(); ++i)
+	{
+		if (memcmp(vertexArrays[i].locations, layout.locations, sizeof(layout.locations)) == 0)
+			return vertexArrays[i].vertexArrayID;
+	}
+
+	VertexLayout vertexLayout;
+	vertexLayout.stride = sizeof(SceneVertex);
+	vertexLayout.add(positionLocation, 3, GL_SHORT, GL_TRUE, offsetof(SceneVertex, position));
+	vertexLayout.add(normalLocation, 2, GL_SHORT, GL_TRUE, offsetof(SceneVertex, normal));
+	vertexLayout.add(colorLocation, 3, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(SceneVertex, color));
+	vertexLayout.add(uvLocation, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(SceneVertex, uv));
+	layout.vertexArrayID = createVertexArray(arena->vertexBufferID, arena->indexBufferID, vertexLayout, "scene vertex array");
+
+	GLuint vertexArrayID = layout.vertexArrayID;
+	vertexArrays.push_back(std::move(layout));
+	return vertexArrayID;
+}
+
+GLuint GpuScene::meshTexture(const SceneFile& scene, int mesh) const
+{
+	int texture = scene.meshes[mesh].texture;
+	return texture >= 0 && texture < (int)textureIDs.size() ? textureIDs[texture] : 0;
+}
+
+void GpuScene::cleanup()
+{
+	// The handles delete them
+	textureIDs.clear();
+	vertexArrays.clear();
+}
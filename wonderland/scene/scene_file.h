@@ -0,0 +1,78 @@
+#ifndef _SCENE_FILE_H_
+#define _SCENE_FILE_H_
+
+#include <glad/gl.h>
+#include "scene_format.h"
+#include <render/mesh_arena.h>
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// A cooked scene mapped straight into memory. Nothing is copied, the pointers all
+// point into the mapping and stay valid until close().
+struct SceneFile {
+	const unsigned char* data;
+	size_t size;
+	bool mapped;	// false when reading a buffer owned by someone else
+
+	const SceneHeader* header;
+	const SceneMesh* meshes;
+	const SceneNode* nodes;
+	const SceneTexture* textures;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+
+	SceneFile();
+
+	bool open(const std::string& path);
+	// Same as open, for a scene a SceneBuilder made in memory. The buffer has to outlive the SceneFile.
+	bool openMemory(const unsigned char* buffer, size_t bufferSize);
+	void close();
+
+	// -1 if there is no mesh/texture with that name
+	int findMesh(const char* name) const;
+	int findTexture(const char* name) const;
+
+	const SceneVertex* vertices() const;
+	const GLuint* indices() const;
+	const unsigned char* texels(const SceneTexture& texture) const;
+
+private:
+	bool parse(const std::string& name);
+};
+
+// GL side of a cooked scene: every mesh gets copied into the mesh arena, so a
+// single vertex array per shader layout covers all of them (and anything else
+// in the arena).
+struct GpuScene {
+	MeshArena* arena;
+	std::vector<MeshRange> meshRanges;	// one per scene mesh, same order
+	std::vector<GLTexture> textureIDs;
+
+	struct VertexArray {
+		GLint locations[4];	// position, normal, color, uv
+		GLVertexArray vertexArrayID;
+	};
+	std::vector<VertexArray> vertexArrays;
+
+	// The arena has to have room for the scene's vertices and indices and outlive the GpuScene
+	bool initialize(const SceneFile& scene, MeshArena& meshArena);
+
+	// Vertex array over the shared buffers with each attribute at the given shader
+	// location. Pass -1 for attributes the shader doesnt have. Positions, colors and uvs
+	// come out as floats in the shader, normals arrive octahedral encoded as a vec2.
+	// Asking for the same locations twice gives back the same vertex array, so objects
+	// drawn with the same layout dont make the render queue rebind. Deleted in cleanup.
+	GLuint vertexArray(GLint positionLocation, GLint normalLocation, GLint colorLocation, GLint uvLocation);
+
+	// Texture the mesh was cooked with, 0 if it has none
+	GLuint meshTexture(const SceneFile& scene, int mesh) const;
+
+	void cleanup();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _SCENE_FORMAT_H_
+#define _SCENE_FORMAT_H_
+
+#include <stdint.h>
+
+// Cooked scene file written by wonderland_cook. Everything is laid out the way
+// OpenGL wants it so the viewer can map the file and hand the blobs straight to
+// glBufferData / glTexImage2D:
+//
+//   SceneHeader
+//   SceneMesh[meshCount]
+//   SceneNode[nodeCount]
+//   SceneTexture[textureCount]
+//   vertex data  (SceneVertex, interleaved and quantized)
+//   index data   (uint32, relative to the mesh's first vertex, drawn with a base vertex)
+//   texel data   (RGB8, every mip level, tightly packed)
+//
+// All offsets are from the start of the file and every blob starts on a
+// SCENE_ALIGNMENT boundary. Bump SCENE_VERSION whenever any of this changes.
+
+#define SCENE_MAGIC (0x4e435357u)	// "WSCN"
+#define SCENE_VERSION (3)
+#define SCENE_ALIGNMENT (16)
+#define SCENE_NAME_LENGTH (32)
+
+// 20 bytes, down from 44 with plain floats. See model/quantize.h for the encodings.
+struct SceneVertex {
+	int16_t position[4];		// snorm16 across the mesh bounds, w is padding
+	int16_t normal[2];			// octahedral snorm16
+	uint16_t uv[2];				// half floats
+	uint8_t color[4];			// unorm8, a is padding
+};
+
+struct SceneHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;		// sizeof(SceneVertex), checked on load
+	uint32_t meshCount;
+	uint32_t nodeCount;
+	uint32_t textureCount;
+	uint64_t meshOffset;
+	uint64_t nodeOffset;
+	uint64_t textureOffset;
+	uint64_t vertexOffset;
+	uint64_t vertexCount;
+	uint64_t indexOffset;
+	uint64_t indexCount;
+};
+
+struct SceneMesh {
+	char name[SCENE_NAME_LENGTH];
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	int32_t texture;			// -1 if untextured
+	float dequantize[16];		// takes the snorm16 positions back to mesh space
+};
+
+// One placed mesh, with the full glTF node hierarchy already multiplied out
+struct SceneNode {
+	char name[SCENE_NAME_LENGTH];
+	int32_t mesh;
+	float transform[16];		// column major, like glm
+};
+
+struct SceneTexture {
+	char name[SCENE_NAME_LENGTH];
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;			// mip levels stored, level 0 first
+	uint32_t padding;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "terrain.h"
+
+#include <glm/gtc/constants.hpp>
+#include <cstdlib>
+#include <cmath>
+
+void terrainGrid(int n, float size, std::vector<glm::vec3>& vertices, std::vector<glm::vec2>& uvs)
+{
+	vertices.resize(n * n);
+	uvs.resize(n * n);
+
+	float step = size / (n - 1);
+	float x = -size / 2;	// 0,0 should be its center
+	float z = -size / 2;
+	int k = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			vertices[k] = glm::vec3(x, 0.0f, z);
+			z += step;
+
+			uvs[k] = glm::vec2((float)i / (n - 1), (float)j / (n - 1));
+			++k;
+		}
+		x += step;
+		z = -size / 2;
+	}
+}
+
+void terrainIndices(int n, std::vector<unsigned int>& indices)
+{
+	indices.clear();
+	indices.reserve((n - 1) * (n - 1) * 6);
+	for (int x = 0; x < n - 1; ++x)
+	{
+		for (int z = 0; z < n - 1; ++z)
+		{
+			int i = x * n + z;
+
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + n);
+
+			indices.push_back(i + 1);
+			indices.push_back(i + n + 1);
+			indices.push_back(i + n);
+		}
+	}
+}
+
+TerrainBump randomTerrainBump(float size)
+{
+	TerrainBump bump;
+	bump.centerX = ((float)rand() / RAND_MAX - 0.5f) * size;
+	bump.centerZ = ((float)rand() / RAND_MAX - 0.5f) * size;
+	bump.radius = (TERRAIN_MAX_BUMP_RADIUS * rand()) / RAND_MAX;
+	float sign = ((float)rand() / RAND_MAX) < TERRAIN_DIP_CHANCE ? -1.0f : 1.0f;
+	bump.displacement = (sign * (TERRAIN_MAX_DISPLACEMENT * rand())) / RAND_MAX;
+	return bump;
+}
+
+void applyTerrainBump(const TerrainBump& bump, glm::vec3* vertices, int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		glm::vec3& v = vertices[i];
+		float dx = bump.centerX - v.x;
+		float dz = bump.centerZ - v.z;
+		float pd = (sqrt((dx * dx) + (dz * dz))) / bump.radius;
+		if (fabs(pd) <= 1.0f)
+			v.y += bump.displacement * cos(pd * pd * glm::pi<float>());
+	}
+}
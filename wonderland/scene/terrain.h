@@ -0,0 +1,33 @@
+#ifndef _TERRAIN_H_
+#define _TERRAIN_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// The CPU half of the old heightmap: a flat grid that random circular bumps get
+// added to. Kept out of the viewer so the benchmarks can run it without GL.
+
+#define TERRAIN_MAX_BUMP_RADIUS (50.0f)
+#define TERRAIN_MAX_DISPLACEMENT (5.0f)
+#define TERRAIN_DIP_CHANCE (0.3f)	// how many bumps go down instead of up
+
+// One random circular bump (or dip) in the terrain
+struct TerrainBump {
+	float centerX, centerZ;
+	float radius;
+	float displacement;
+};
+
+// n x n vertices covering size x size, centred on 0 with y = 0. uvs go 0 to 1 across it.
+void terrainGrid(int n, float size, std::vector<glm::vec3>& vertices, std::vector<glm::vec2>& uvs);
+
+// Two triangles per grid square
+void terrainIndices(int n, std::vector<unsigned int>& indices);
+
+// Somewhere on a size x size grid. Rolled with rand(), so the same seed gives the same terrain.
+TerrainBump randomTerrainBump(float size);
+
+// Adds the bump to vertices [begin, end)
+void applyTerrainBump(const TerrainBump& bump, glm::vec3* vertices, int begin, int end);
+
+#endif
@@ -0,0 +1,378 @@
+// CPU micro-benchmarks for the hot paths the viewers depend on: terrain generation,
+// texture decoding, glTF parsing and reading, node transforms and the per frame
+// matrix maths. Each one is run a number of times and the median time per operation
+// is reported, so a noisy run or two doesn't move it.
+//
+// Usage: wonderland_bench [--assets dir] [--repeats n] [--output results.csv]
+//                         [--baseline baseline.csv] [--threshold percent]
+//
+// --output writes the results as CSV, which can be passed back in as --baseline on a
+// later build. Anything that got slower than the baseline by more than the threshold
+// (default 10%) is flagged, and the exit code is 1 so scripts can fail on it.
+
+#include <scene/terrain.h>
+#include <scene/scene_builder.h>
+#include <model/gltf_util.h>
+#include <render/culling.h>
+
+#define TINYGLTF_IMPLEMENTATION
+#include "tiny_gltf.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#define TERRAIN_VERTICES (100)		// per side, same as the window's heightmap
+#define TERRAIN_SIZE (2000.0f)
+#define FRAME_DRAWS (1000)			// draws worth of matrices per simulated frame
+
+// Results get added in here so the compiler can't drop the work
+static volatile float benchmarkSink = 0.0f;
+
+struct Benchmark {
+	std::string name;
+	int ops;						// operations per run, times are reported per op
+	std::function<bool()> run;		// false if it couldn't run, a missing asset say
+};
+
+struct BenchmarkResult {
+	std::string name;
+	int ops;
+	double median;		// microseconds per op
+	double min;
+};
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return !data.empty();
+}
+
+static bool loadGltf(const std::string& path, tinygltf::Model& model)
+{
+	tinygltf::TinyGLTF loader;
+	std::string err, warn;
+	model = tinygltf::Model();
+	return loader.LoadASCIIFromFile(&model, &err, &warn, path);
+}
+
+static void nodeTransforms(const tinygltf::Model& model, int node, const glm::mat4& parent, float& sum)
+{
+	glm::mat4 transform = parent * nodeTransform(model.nodes[node]);
+	sum += transform[3][0];
+	for (size_t i = 0; i < model.nodes[node].children.size(); ++i)
+		nodeTransforms(model, model.nodes[node].children[i], transform, sum);
+}
+
+// Everything the benchmarks read, loaded once up front so only the work gets timed
+struct BenchmarkData {
+	std::string assets;
+
+	std::vector<glm::vec3> terrain;
+	std::vector<glm::vec2> terrainUvs;
+	std::vector<unsigned int> terrainIndexList;
+
+	std::vector<unsigned char> jpeg, png;
+	tinygltf::Model model;
+	bool modelLoaded;
+
+	std::vector<glm::mat4> drawModels;
+	std::vector<Aabb> drawBounds;
+
+	void initialize()
+	{
+		srand(1);
+		terrainGrid(TERRAIN_VERTICES, TERRAIN_SIZE, terrain, terrainUvs);
+
+		readFile(assets + "/Ground_Files/IMGP1394.jpg", jpeg);
+		readFile(assets + "/Skybox_Files/Skybox_1.png", png);
+		modelLoaded = loadGltf(gltfPath(), model) && !model.scenes.empty();
+
+		drawModels.resize(FRAME_DRAWS);
+		drawBounds.resize(FRAME_DRAWS);
+		for (int i = 0; i < FRAME_DRAWS; ++i)
+		{
+			glm::vec3 position(rand() % 1000 - 500.0f, rand() % 50, rand() % 1000 - 500.0f);
+			drawModels[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.0f + rand() % 10));
+			drawBounds[i].min = glm::vec3(-1.0f);
+			drawBounds[i].max = glm::vec3(1.0f);
+		}
+	}
+
+	std::string gltfPath() const
+	{
+		return assets + "/Old_unused_model_code/Lampost/rusticLamps.gltf";
+	}
+
+	bool updateMap()
+	{
+		applyTerrainBump(randomTerrainBump(TERRAIN_SIZE), terrain.data(), 0, (int)terrain.size());
+		benchmarkSink += terrain[terrain.size() / 2].y;
+		return true;
+	}
+
+	bool generateIndices()
+	{
+		terrainIndices(TERRAIN_VERTICES, terrainIndexList);
+		benchmarkSink += (float)terrainIndexList.back();
+		return true;
+	}
+
+	bool decode(const std::vector<unsigned char>& file)
+	{
+		if (file.empty())
+			return false;
+		int w, h, channels;
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char* img = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &channels, 3);
+		if (!img)
+			return false;
+		benchmarkSink += img[w * h];
+		stbi_image_free(img);
+		return true;
+	}
+
+	// What startup does now: decode plus the whole mip chain
+	bool sceneTexture()
+	{
+		SceneTexture texture;
+		std::vector<unsigned char> texels;
+		if (jpeg.empty() || !loadSceneTexture(assets + "/Ground_Files/IMGP1394.jpg", texture, texels))
+			return false;
+		benchmarkSink += texels.back();
+		return true;
+	}
+
+	bool parseGltf()
+	{
+		tinygltf::Model parsed;
+		if (!loadGltf(gltfPath(), parsed))
+			return false;
+		benchmarkSink += (float)parsed.nodes.size();
+		return true;
+	}
+
+	// The CPU side of binding a model: reading every primitive's positions and indices
+	// out of the glTF buffers, which is what the cooker does with them
+	bool readGltf()
+	{
+		if (!modelLoaded)
+			return false;
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> indices;
+		for (size_t m = 0; m < model.meshes.size(); ++m)
+		{
+			for (size_t p = 0; p < model.meshes[m].primitives.size(); ++p)
+			{
+				const tinygltf::Primitive& primitive = model.meshes[m].primitives[p];
+				std::map<std::string, int>::const_iterator position = primitive.attributes.find("POSITION");
+				if (position != primitive.attributes.end() && readPositions(model, position->second, positions))
+					benchmarkSink += positions.back().x;
+				if (primitive.indices >= 0 && readIndices(model, primitive.indices, indices))
+					benchmarkSink += (float)indices.back();
+			}
+		}
+		return true;
+	}
+
+	bool walkNodes()
+	{
+		if (!modelLoaded)
+			return false;
+		float sum = 0.0f;
+		const tinygltf::Scene& scene = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0];
+		for (size_t i = 0; i < scene.nodes.size(); ++i)
+			nodeTransforms(model, scene.nodes[i], glm::mat4(1.0f), sum);
+		benchmarkSink += sum;
+		return true;
+	}
+
+	// One frame of the viewer's matrix work: camera and light, both frusta, then a
+	// model matrix, bounds and depth key for every draw
+	bool frameMatrices()
+	{
+		static float angle = 0.0f;
+		angle += 0.01f;
+		glm::vec3 cameraPosition(cosf(angle) * 300.0f, 80.0f, sinf(angle) * 300.0f);
+		glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(0.0f, 40.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 2500.0f);
+		glm::vec3 lightPosition(-100.0f, 200.0f, -200.0f);
+		glm::mat4 lightView = glm::lookAt(lightPosition, lightPosition + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 lightProjection = glm::perspective(glm::radians(100.0f), 1.0f, 0.1f, 1000.0f);
+
+		Frustum camera = extractFrustum(projection * view);
+		Frustum light = extractFrustum(lightProjection * lightView);
+		float sum = camera.d[0] + light.d[0];
+
+		glm::mat4 dequantize = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+		for (int i = 0; i < FRAME_DRAWS; ++i)
+		{
+			glm::mat4 model = drawModels[i] * dequantize;
+			Aabb bounds = transformAabb(drawBounds[i], drawModels[i]);
+			glm::vec4 center = view * model[3];
+			sum += model[0][0] + bounds.max.y - center.z;
+		}
+		benchmarkSink += sum;
+		return true;
+	}
+};
+
+static bool loadBaseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		std::cout << "Couldn't open baseline " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	std::getline(file, line);	// header
+	while (std::getline(file, line))
+	{
+		std::stringstream fields(line);
+		std::string name, ops, median;
+		if (std::getline(fields, name, ',') && std::getline(fields, ops, ',') && std::getline(fields, median, ','))
+			baseline[name] = atof(median.c_str());
+	}
+	return true;
+}
+
+static bool writeResults(const std::string& path, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream file(path.c_str());
+	if (!file)
+	{
+		std::cout << "Couldn't open " << path << " for the results" << std::endl;
+		return false;
+	}
+	file << "name,ops,median_us,min_us\n";
+	file << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < results.size(); ++i)
+		file << results[i].name << "," << results[i].ops << "," << results[i].median << "," << results[i].min << "\n";
+	std::cout << "Results saved to " << path << std::endl;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkData data;
+	data.assets = "../../../wonderland";
+	int repeats = 15;
+	std::string output, baselinePath;
+	double threshold = 10.0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc)
+			data.assets = argv[++i];
+		else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else
+			repeats = 0;
+	}
+	if (repeats < 1)
+	{
+		std::cout << "Usage: " << argv[0] << " [--assets dir] [--repeats n] [--output results.csv]"
+			" [--baseline baseline.csv] [--threshold percent]" << std::endl;
+		return 1;
+	}
+
+	std::map<std::string, double> baseline;
+	if (!baselinePath.empty() && !loadBaseline(baselinePath, baseline))
+		return 1;
+
+	data.initialize();
+	BenchmarkData* d = &data;
+	std::vector<Benchmark> benchmarks;
+	benchmarks.push_back({ "terrain.updateMap", 100, [d]() { return d->updateMap(); } });
+	benchmarks.push_back({ "terrain.generateIndices", 100, [d]() { return d->generateIndices(); } });
+	benchmarks.push_back({ "texture.decode.jpg", 1, [d]() { return d->decode(d->jpeg); } });
+	benchmarks.push_back({ "texture.decode.png", 1, [d]() { return d->decode(d->png); } });
+	benchmarks.push_back({ "texture.decodeWithMips", 1, [d]() { return d->sceneTexture(); } });
+	benchmarks.push_back({ "gltf.parse", 1, [d]() { return d->parseGltf(); } });
+	benchmarks.push_back({ "gltf.readPrimitives", 10, [d]() { return d->readGltf(); } });
+	benchmarks.push_back({ "gltf.nodeTransforms", 1000, [d]() { return d->walkNodes(); } });
+	benchmarks.push_back({ "frame.matrices", 100, [d]() { return d->frameMatrices(); } });
+
+	std::cout << "Median of " << repeats << " runs, microseconds per op" << std::endl;
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "median"
+		<< std::setw(12) << "min" << std::setw(12) << "baseline" << std::setw(10) << "change" << std::endl;
+
+	std::vector<BenchmarkResult> results;
+	int regressions = 0;
+	for (size_t b = 0; b < benchmarks.size(); ++b)
+	{
+		const Benchmark& benchmark = benchmarks[b];
+		std::cout << std::left << std::setw(28) << benchmark.name << std::right;
+
+		// First run warms the caches, and finds out if it can run at all
+		if (!benchmark.run())
+		{
+			std::cout << "  skipped, couldn't load its input from " << data.assets << std::endl;
+			continue;
+		}
+
+		std::vector<double> times;
+		for (int r = 0; r < repeats; ++r)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int op = 0; op < benchmark.ops; ++op)
+				benchmark.run();
+			std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+			times.push_back(elapsed.count() / benchmark.ops);
+		}
+		std::sort(times.begin(), times.end());
+
+		BenchmarkResult result;
+		result.name = benchmark.name;
+		result.ops = benchmark.ops;
+		result.median = times[times.size() / 2];
+		result.min = times[0];
+		results.push_back(result);
+
+		std::cout << std::fixed << std::setprecision(2) << std::setw(12) << result.median << std::setw(12) << result.min;
+		std::map<std::string, double>::const_iterator old = baseline.find(result.name);
+		if (old != baseline.end() && old->second > 0.0)
+		{
+			double change = (result.median - old->second) / old->second * 100.0;
+			std::ostringstream percent;
+			percent << std::fixed << std::setprecision(1) << std::showpos << change << "%";
+			std::cout << std::setw(12) << old->second << std::setw(10) << percent.str();
+			if (change > threshold)
+			{
+				std::cout << "  REGRESSION";
+				++regressions;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	if (!output.empty())
+		writeResults(output, results);
+	if (!baseline.empty())
+		std::cout << regressions << " regressions over " << std::setprecision(0) << threshold << "% against " << baselinePath << std::endl;
+	return regressions > 0 ? 1 : 0;
+}
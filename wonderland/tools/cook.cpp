@@ -0,0 +1,201 @@
+// Asset cooker: bakes the built-in meshes, glTF models and images into one cooked scene
+// file (see scene/scene_format.h) the viewers can map and upload without any parsing.
+//
+// Usage: wonderland_cook out.scene [model.gltf | model.glb | image.png | image.jpg]...
+//
+// The built-in meshes always go in. Images are matched to the built-ins by file name, so
+// pass Skybox_1.png and IMGP1394.jpg to get a textured skybox and ground.
+
+#include <model/gltf_util.h>
+#include <scene/scene_builder.h>
+
+#define TINYGLTF_IMPLEMENTATION
+#include "tiny_gltf.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+static SceneBuilder builder;
+
+static std::string extension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+	for (size_t i = 0; i < ext.size(); ++i)
+		ext[i] = (char)tolower(ext[i]);
+	return ext;
+}
+
+// Cooks one glTF primitive into a scene mesh. The material's base color is baked into
+// the vertex colors since the cooked box shader has no material inputs.
+static int cookPrimitive(const tinygltf::Model& model, const std::string& name, const tinygltf::Primitive& primitive)
+{
+	std::map<std::string, int>::const_iterator attribute = primitive.attributes.find("POSITION");
+	if (primitive.mode != TINYGLTF_MODE_TRIANGLES || attribute == primitive.attributes.end())
+		return -1;
+
+	std::vector<glm::vec3> positions, normals, colors;
+	std::vector<glm::vec2> uvs;
+	std::vector<uint32_t> meshIndices;
+	std::vector<glm::vec4> values;
+	if (!readPositions(model, attribute->second, positions))
+		return -1;
+
+	if (primitive.indices >= 0)
+	{
+		if (!readIndices(model, primitive.indices, meshIndices))
+			return -1;
+	}
+	else
+	{
+		for (size_t i = 0; i < positions.size(); ++i)
+			meshIndices.push_back((uint32_t)i);
+	}
+
+	attribute = primitive.attributes.find("NORMAL");
+	if (attribute != primitive.attributes.end() && readAccessor(model, attribute->second, values))
+		for (size_t i = 0; i < values.size(); ++i)
+			normals.push_back(glm::vec3(values[i]));
+
+	attribute = primitive.attributes.find("TEXCOORD_0");
+	if (attribute != primitive.attributes.end() && readAccessor(model, attribute->second, values))
+		for (size_t i = 0; i < values.size(); ++i)
+			uvs.push_back(glm::vec2(values[i]));
+
+	glm::vec3 baseColor(1.0f);
+	if (primitive.material >= 0 && primitive.material < (int)model.materials.size())
+	{
+		const std::vector<double>& factor = model.materials[primitive.material].pbrMetallicRoughness.baseColorFactor;
+		if (factor.size() >= 3)
+			baseColor = glm::vec3(factor[0], factor[1], factor[2]);
+	}
+	attribute = primitive.attributes.find("COLOR_0");
+	if (attribute != primitive.attributes.end() && readAccessor(model, attribute->second, values))
+		for (size_t i = 0; i < values.size(); ++i)
+			colors.push_back(baseColor * glm::vec3(values[i]));
+	else
+		colors.assign(positions.size(), baseColor);
+
+	return builder.addMesh(name, positions, normals, colors, uvs, meshIndices, -1);
+}
+
+static void cookNode(const tinygltf::Model& model, int nodeIndex, const glm::mat4& parentTransform,
+	std::map<std::pair<int, int>, int>& cookedPrimitives)
+{
+	const tinygltf::Node& node = model.nodes[nodeIndex];
+	glm::mat4 transform = parentTransform * nodeTransform(node);
+
+	if (node.mesh >= 0 && node.mesh < (int)model.meshes.size())
+	{
+		const tinygltf::Mesh& mesh = model.meshes[node.mesh];
+		for (size_t p = 0; p < mesh.primitives.size(); ++p)
+		{
+			// Instanced meshes only get cooked once
+			std::pair<int, int> key(node.mesh, (int)p);
+			if (cookedPrimitives.find(key) == cookedPrimitives.end())
+			{
+				std::ostringstream name;
+				name << (mesh.name.empty() ? "mesh" : mesh.name) << "." << p;
+				cookedPrimitives[key] = cookPrimitive(model, name.str(), mesh.primitives[p]);
+			}
+			if (cookedPrimitives[key] < 0)
+				continue;
+
+			builder.addNode(node.name, cookedPrimitives[key], transform);
+		}
+	}
+
+	for (size_t i = 0; i < node.children.size(); ++i)
+		cookNode(model, node.children[i], transform, cookedPrimitives);
+}
+
+static bool cookModel(const std::string& path)
+{
+	tinygltf::TinyGLTF loader;
+	tinygltf::Model model;
+	std::string err, warn;
+	bool loaded = extension(path) == "glb"
+		? loader.LoadBinaryFromFile(&model, &err, &warn, path)
+		: loader.LoadASCIIFromFile(&model, &err, &warn, path);
+	if (!warn.empty())
+		std::cout << "WARN: " << warn << std::endl;
+	if (!loaded)
+	{
+		std::cout << "Failed to load glTF: " << path << " " << err << std::endl;
+		return false;
+	}
+
+	size_t firstNode = builder.nodes.size();
+	size_t firstMesh = builder.meshes.size();
+	std::map<std::pair<int, int>, int> cookedPrimitives;
+	int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+	if (sceneIndex < (int)model.scenes.size())
+	{
+		const tinygltf::Scene& scene = model.scenes[sceneIndex];
+		for (size_t i = 0; i < scene.nodes.size(); ++i)
+			cookNode(model, scene.nodes[i], glm::mat4(), cookedPrimitives);
+	}
+
+	std::cout << "Model " << path << ": " << cookedPrimitives.size() << " primitives, " << builder.nodes.size() - firstNode << " placed" << std::endl;
+	builder.printReport("  optimised", firstMesh, builder.meshes.size());
+	return true;
+}
+
+static bool writeScene(const std::string& path)
+{
+	std::vector<unsigned char> data;
+	builder.serialize(data);
+
+	std::ofstream out(path.c_str(), std::ios::binary);
+	out.write((const char*)data.data(), (std::streamsize)data.size());
+	if (!out)
+	{
+		std::cout << "Couldnt write " << path << std::endl;
+		return false;
+	}
+
+	size_t fullSize = builder.vertices.size() * (3 + 3 + 3 + 2) * sizeof(float);
+	std::cout << "Wrote " << path << ": " << builder.meshes.size() << " meshes, " << builder.nodes.size() << " nodes, "
+		<< builder.textures.size() << " textures, " << builder.indices.size() / 3 << " triangles, " << data.size() << " bytes" << std::endl;
+	std::cout << "Vertices: " << builder.vertices.size() << ", " << builder.vertices.size() * sizeof(SceneVertex)
+		<< " bytes quantized, " << fullSize << " bytes as floats" << std::endl;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: " << argv[0] << " out.scene [model.gltf | model.glb | image.png | image.jpg]..." << std::endl;
+		return 1;
+	}
+
+	// Images first so the built-ins and models can refer to them
+	std::vector<std::string> models;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string ext = extension(argv[i]);
+		if (ext == "gltf" || ext == "glb")
+			models.push_back(argv[i]);
+		else if (!builder.addTexture(argv[i]))
+			return 1;
+		else
+			std::cout << "Texture " << argv[i] << ": " << builder.textures.back().width << "x" << builder.textures.back().height
+				<< ", " << builder.textures.back().levels << " levels" << std::endl;
+	}
+
+	builder.addBuiltinMeshes();
+	builder.printReport("Built-in meshes", 0, builder.meshes.size());
+
+	for (size_t i = 0; i < models.size(); ++i)
+		if (!cookModel(models[i]))
+			return 1;
+
+	return writeScene(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+// Job system benchmark: runs a few workloads shaped like the engine's (terrain bumps,
+// transform updates, the occlusion rasterizer and a flood of tiny jobs) with 1 to N
+// threads and prints the time and speedup for each.
+//
+// Usage: wonderland_jobbench [maxThreads] [repeats]
+
+#include <core/job_system.h>
+#include <render/occlusion.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+#define TERRAIN_SIZE (512)
+#define TERRAIN_BUMPS (100)
+#define TRANSFORM_COUNT (200000)
+#define OCCLUDER_TRIANGLES (20000)
+#define TINY_JOBS (4000)		// per round, has to stay under JOB_POOL_SIZE
+#define TINY_ROUNDS (25)
+
+struct Bump {
+	float x, z;
+	float radius;
+	float height;
+};
+
+struct Transform {
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+// Everything the workloads read and write, made once so only the work itself gets timed
+struct Workloads {
+	std::vector<glm::vec3> terrain;
+	std::vector<Bump> bumps;
+
+	std::vector<Transform> transforms;
+	std::vector<glm::mat4> matrices;
+
+	OcclusionCuller occlusion;
+	glm::mat4 viewProjection;
+
+	void initialize(JobSystem& jobs)
+	{
+		srand(1);
+
+		terrain.resize(TERRAIN_SIZE * TERRAIN_SIZE);
+		bumps.resize(TERRAIN_BUMPS);
+		for (size_t i = 0; i < bumps.size(); ++i)
+		{
+			bumps[i].x = (float)rand() / RAND_MAX * TERRAIN_SIZE;
+			bumps[i].z = (float)rand() / RAND_MAX * TERRAIN_SIZE;
+			bumps[i].radius = 5.0f + (float)rand() / RAND_MAX * 40.0f;
+			bumps[i].height = (float)rand() / RAND_MAX * 10.0f - 3.0f;
+		}
+
+		transforms.resize(TRANSFORM_COUNT);
+		matrices.resize(TRANSFORM_COUNT);
+		for (size_t i = 0; i < transforms.size(); ++i)
+		{
+			transforms[i].translation = glm::vec3(rand() % 1000, rand() % 100, rand() % 1000);
+			transforms[i].rotation = glm::angleAxis((float)rand() / RAND_MAX * 6.28f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+			transforms[i].scale = glm::vec3(1.0f + (float)rand() / RAND_MAX);
+		}
+
+		// Random triangles scattered in front of the camera
+		occlusion.initialize(jobs);
+		std::vector<glm::vec3> positions(OCCLUDER_TRIANGLES * 3);
+		std::vector<uint32_t> indices(OCCLUDER_TRIANGLES * 3);
+		for (int i = 0; i < OCCLUDER_TRIANGLES; ++i)
+		{
+			glm::vec3 center(rand() % 200 - 100.0f, rand() % 100 - 50.0f, -(rand() % 150) - 10.0f);
+			for (int v = 0; v < 3; ++v)
+			{
+				positions[i * 3 + v] = center + glm::vec3(rand() % 20 - 10.0f, rand() % 20 - 10.0f, rand() % 4 - 2.0f);
+				indices[i * 3 + v] = i * 3 + v;
+			}
+		}
+		occlusion.addOccluder(positions.data(), indices.data(), indices.size(), glm::mat4(1.0f));
+		viewProjection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 500.0f);
+	}
+
+	void runTerrain(JobSystem& jobs)
+	{
+		for (int i = 0; i < TERRAIN_SIZE * TERRAIN_SIZE; ++i)
+			terrain[i] = glm::vec3((float)(i % TERRAIN_SIZE), 0.0f, (float)(i / TERRAIN_SIZE));
+
+		parallelFor(jobs, (int)terrain.size(), 256, [this](int begin, int end) {
+			for (size_t b = 0; b < bumps.size(); ++b)
+			{
+				const Bump& bump = bumps[b];
+				for (int i = begin; i < end; ++i)
+				{
+					float dx = bump.x - terrain[i].x, dz = bump.z - terrain[i].z;
+					float distance = sqrtf(dx * dx + dz * dz) / bump.radius;
+					if (distance <= 1.0f)
+						terrain[i].y += bump.height * cosf(distance * distance * 3.14159265f);
+				}
+			}
+		});
+	}
+
+	void runTransforms(JobSystem& jobs)
+	{
+		parallelFor(jobs, (int)transforms.size(), 1024, [this](int begin, int end) {
+			for (int i = begin; i < end; ++i)
+			{
+				const Transform& t = transforms[i];
+				matrices[i] = glm::translate(glm::mat4(1.0f), t.translation) * glm::mat4_cast(t.rotation) * glm::scale(glm::mat4(1.0f), t.scale);
+			}
+		});
+	}
+
+	void runOcclusion(JobSystem&)
+	{
+		occlusion.render(viewProjection);
+	}
+
+	void runTinyJobs(JobSystem& jobs)
+	{
+		for (int round = 0; round < TINY_ROUNDS; ++round)
+		{
+			Job* root = jobs.create(&emptyJob);
+			for (int i = 0; i < TINY_JOBS; ++i)
+				jobs.run(jobs.create(&emptyJob, root));
+			jobs.run(root);
+			jobs.wait(root);
+		}
+	}
+
+	static void emptyJob(Job*, const void*)
+	{
+	}
+};
+
+typedef void (Workloads::*Workload)(JobSystem& jobs);
+
+static double timeWorkload(Workloads& workloads, Workload workload, JobSystem& jobs, int repeats)
+{
+	// First run warms the caches and wakes the workers up
+	(workloads.*workload)(jobs);
+
+	double best = 1e30;
+	for (int i = 0; i < repeats; ++i)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		(workloads.*workload)(jobs);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() < best)
+			best = elapsed.count();
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	int maxThreads = argc > 1 ? atoi(argv[1]) : hardwareThreads;
+	int repeats = argc > 2 ? atoi(argv[2]) : 10;
+	if (maxThreads < 1 || repeats < 1)
+	{
+		std::cout << "Usage: " << argv[0] << " [maxThreads] [repeats]" << std::endl;
+		return 1;
+	}
+
+	const char* names[] = { "terrain", "transforms", "occlusion", "tiny jobs" };
+	Workload workloads[] = { &Workloads::runTerrain, &Workloads::runTransforms, &Workloads::runOcclusion, &Workloads::runTinyJobs };
+	const int workloadCount = 4;
+
+	std::cout << "Best of " << repeats << " runs, " << hardwareThreads << " hardware threads" << std::endl;
+	std::cout << std::left << std::setw(9) << "threads";
+	for (int w = 0; w < workloadCount; ++w)
+		std::cout << std::setw(22) << names[w];
+	std::cout << std::endl;
+
+	std::vector<double> single(workloadCount);
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		JobSystem jobs;
+		jobs.initialize(threads - 1);
+		Workloads data;
+		data.initialize(jobs);
+
+		std::cout << std::setw(9) << threads;
+		for (int w = 0; w < workloadCount; ++w)
+		{
+			double ms = timeWorkload(data, workloads[w], jobs, repeats);
+			if (threads == 1)
+				single[w] = ms;
+
+			std::ostringstream cell;
+			cell << std::fixed << std::setprecision(2) << ms << " ms " << std::setprecision(1) << single[w] / ms << "x";
+			std::cout << std::setw(22) << cell.str();
+		}
+		std::cout << std::endl;
+
+		jobs.cleanup();
+	}
+
+	std::cout << "Occlusion only has " << OCCLUSION_BANDS << " bands, so it stops scaling there. Tiny jobs is "
+		<< TINY_JOBS * TINY_ROUNDS << " empty jobs, mostly measuring the queues." << std::endl;
+	return 0;
+}
@@ -0,0 +1,81 @@
+// Offline LOD generator: simplifies every triangle primitive of a glTF model into a
+// chain of coarser index buffers and writes them next to the model.
+//
+// Usage: wonderland_lodgen model.gltf [levels] [ratio]
+
+#include <model/gltf_util.h>
+#include <model/mesh_lod.h>
+
+#define TINYGLTF_IMPLEMENTATION
+#include "tiny_gltf.h"
+
+#include <iostream>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: " << argv[0] << " model.gltf [levels] [ratio]" << std::endl;
+		return 1;
+	}
+
+	std::string modelPath = argv[1];
+	int levels = argc > 2 ? atoi(argv[2]) : 4;
+	float ratio = argc > 3 ? (float)atof(argv[3]) : 0.5f;
+
+	tinygltf::TinyGLTF loader;
+	tinygltf::Model model;
+	std::string err, warn;
+	bool loaded = modelPath.size() > 4 && modelPath.substr(modelPath.size() - 4) == ".glb"
+		? loader.LoadBinaryFromFile(&model, &err, &warn, modelPath)
+		: loader.LoadASCIIFromFile(&model, &err, &warn, modelPath);
+	if (!warn.empty())
+		std::cout << "WARN: " << warn << std::endl;
+	if (!loaded)
+	{
+		std::cout << "Failed to load glTF: " << modelPath << " " << err << std::endl;
+		return 1;
+	}
+
+	std::vector<PrimitiveLods> allLods;
+	size_t fullIndices = 0, coarsestIndices = 0;
+
+	for (size_t m = 0; m < model.meshes.size(); ++m)
+	{
+		for (size_t p = 0; p < model.meshes[m].primitives.size(); ++p)
+		{
+			const tinygltf::Primitive& primitive = model.meshes[m].primitives[p];
+			std::map<std::string, int>::const_iterator position = primitive.attributes.find("POSITION");
+			if (primitive.mode != TINYGLTF_MODE_TRIANGLES || primitive.indices < 0 || position == primitive.attributes.end())
+				continue;
+
+			std::vector<glm::vec3> positions;
+			std::vector<unsigned int> indices;
+			if (!readPositions(model, position->second, positions) || !readIndices(model, primitive.indices, indices))
+			{
+				std::cout << "Skipping mesh " << m << " primitive " << p << ", couldnt read its data" << std::endl;
+				continue;
+			}
+
+			PrimitiveLods lods;
+			lods.mesh = (int)m;
+			lods.primitive = (int)p;
+			buildLodChain(positions, indices, levels, ratio, lods);
+
+			fullIndices += indices.size();
+			coarsestIndices += lods.levels.empty() ? indices.size() : lods.levels.back().indexCount;
+
+			if (!lods.levels.empty())
+				allLods.push_back(lods);
+		}
+	}
+
+	std::string lodPath = lodFilePath(modelPath);
+	if (!saveLodFile(lodPath, allLods))
+		return 1;
+
+	std::cout << "Wrote " << allLods.size() << " primitive LOD chains to " << lodPath << std::endl;
+	std::cout << "Triangles: " << fullIndices / 3 << " at full detail, " << coarsestIndices / 3 << " at the coarsest level" << std::endl;
+	return 0;
+}
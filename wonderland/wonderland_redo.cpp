@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
@@ -9,9 +10,32 @@
 #include <stb/stb_image.h>
 
 #include <render/shader.h>
+#include <render/gl_state.h>
+#include <render/render_queue.h>
+#include <render/stream_buffer.h>
+#include <render/uniform_blocks.h>
+#include <render/culling.h>
+#include <render/occlusion.h>
+#include <render/gpu_profiler.h>
+#include <render/hud.h>
+#include <render/gl_resource.h>
+#include <core/trace.h>
+#include <core/process_memory.h>
+#include <core/metrics.h>
+#include <core/job_system.h>
+#include <core/load_graph.h>
+#include <core/camera_path.h>
+#include <scene/builtin_meshes.h>
+#include <scene/scene_file.h>
+#include <scene/scene_builder.h>
 
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -20,6 +44,21 @@ static GLFWwindow* window;
 static int windowWidth = 1024;
 static int windowHeight = 768;
 
+// Headless benchmark, for machines without a display or a GPU. The window stays
+// hidden and the main pass draws into sceneFBO instead, while the camera flies a
+// fixed path. Frame times and GPU pass timings are written as JSON to the --output
+// file at the end. Stdout only gets a one line summary, with everything else logged.
+static bool benchmark = false;
+static int benchmarkFrames = 600;
+static const char* benchmarkOutput = NULL;	// where the JSON goes, needed with --benchmark
+#define BENCHMARK_WARMUP_FRAMES (30)		// not counted, while the caches and driver settle
+#define BENCHMARK_TIMESTEP (1.0f / 60.0f)	// simulated time per frame, so every run sees the same frames
+
+// Where the main pass draws, 0 for the window
+static GLFramebuffer sceneFBO;
+static GLRenderbuffer sceneColor;
+static GLRenderbuffer sceneDepth;
+
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 static void cursor_callback(GLFWwindow* window, double xpos, double ypos);
 
@@ -54,9 +93,8 @@ static glm::vec3 lightUp(0, 0, 1);
 static int shadowMapWidth = 2048;
 static int shadowMapHeight = 2048;
 
-static GLuint depthMapFBO;
-static GLuint depthMapTexture;
-static glm::mat4 lightSpaceMatrix;
+static GLFramebuffer depthMapFBO;
+static GLTexture depthMapTexture;
 static GLuint depthProgramID;
 
 static float depthFoV = 100.f;
@@ -66,6 +104,145 @@ static float depthFar = 1000.f; // Just needs to be bigger than where its cut of
 // Helper flag and function to save depth maps for debugging
 static bool saveDepth = false;
 
+// P writes the GPU pass timings out to gpu_profile.csv
+static bool saveGpuProfile = false;
+
+// T writes the last few seconds of CPU zones to trace.json, for chrome://tracing or Perfetto
+static bool saveTrace = false;
+
+// H toggles the stats overlay. --hud starts with it on, so a benchmark can time it too.
+static bool showHud = false;
+
+// --metrics port serves frame times, memory and scene counts on 127.0.0.1 for soak tests
+static int metricsPort = 0;
+
+// All binds in the frame go through this so repeats get dropped. It also counts
+// them, and prints last frame's numbers every glStatsInterval seconds (0 = never)
+static GLStateCache glState;
+static float glStatsInterval = 5.0f;
+
+// Views in the shared uniform buffer
+enum { VIEW_CAMERA = 0, VIEW_LIGHT = 1, VIEW_COUNT = 2 };
+
+// World bounds of everything that can be culled. The camera and the light each
+// cull it once a frame, and the counts get printed with the GL stats.
+static Bvh culler;
+
+// Whatever survives the camera's frustum is then tested against the big occluders,
+// rasterized on the CPU
+static OcclusionCuller occlusion;
+
+static Aabb meshBounds(const SceneFile& scene, int mesh)
+{
+	Aabb bounds;
+	bounds.min = glm::make_vec3(scene.meshes[mesh].boundsMin);
+	bounds.max = glm::make_vec3(scene.meshes[mesh].boundsMax);
+	return bounds;
+}
+
+// The occlusion culler wants plain positions, so undo the snorm16 the same way the GPU does
+static void addOccluder(const SceneFile& scene, int mesh, const glm::mat4& modelMatrix)
+{
+	const SceneMesh& sceneMesh = scene.meshes[mesh];
+	const SceneVertex* vertices = scene.vertices() + sceneMesh.firstVertex;
+	std::vector<glm::vec3> positions(sceneMesh.vertexCount);
+	for (uint32_t i = 0; i < sceneMesh.vertexCount; ++i)
+	{
+		glm::vec3 position(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
+		positions[i] = glm::max(position / 32767.0f, glm::vec3(-1.0f));
+	}
+	occlusion.addOccluder(positions.data(), scene.indices() + sceneMesh.firstIndex, sceneMesh.indexCount,
+		modelMatrix * glm::make_mat4(sceneMesh.dequantize));
+}
+
+
+// --record saves the camera every frame to a file, --replay flies it back one key per
+// frame at the recorded timestep, so runs on different builds draw the same frames
+static CameraPath recordedPath;
+static const char* recordFile = NULL;
+static CameraPath replayPath;
+static bool replaying = false;
+
+// Moves the camera for a frame when the player isn't flying it: along the replayed
+// path, or a slow circle round the box for a benchmark without one. Returns the time
+// the frame is simulated at, which is only the clock when playing live.
+static float driveCamera(int frame, float clock)
+{
+	float time = clock;
+	if (replaying)
+	{
+		const CameraKey& key = replayPath.key(frame);
+		cameraPosition = glm::make_vec3(key.position);
+		yaw = key.yaw;
+		pitch = key.pitch;
+		cameraLookVector = lookVectorFromAngles(key.yaw, key.pitch);
+		time = frame * replayPath.timestep;
+	}
+	else if (benchmark)
+	{
+		float angle = frame * 0.01f;
+		cameraPosition = glm::vec3(cosf(angle) * 300.0f, 80.0f, sinf(angle) * 300.0f);
+		glm::vec3 look = glm::normalize(glm::vec3(0.0f, 40.0f, 0.0f) - cameraPosition);
+		yaw = glm::degrees(atan2f(look.z, look.x));
+		pitch = glm::degrees(asinf(look.y));
+		cameraLookVector = lookVectorFromAngles((float)yaw, (float)pitch);
+		time = frame * BENCHMARK_TIMESTEP;
+	}
+
+	if (recordFile)
+		recordedPath.record(cameraPosition, (float)yaw, (float)pitch);
+	return time;
+}
+
+static bool createSceneFramebuffer()
+{
+	sceneColor.create("offscreen target");
+	glBindRenderbuffer(GL_RENDERBUFFER, sceneColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+	sceneColor.setBytes(glTextureBytes(GL_RGBA8, windowWidth, windowHeight));
+	sceneDepth.create("offscreen target");
+	glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+	sceneDepth.setBytes(glTextureBytes(GL_DEPTH_COMPONENT24, windowWidth, windowHeight));
+
+	sceneFBO.create("offscreen target");
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete)
+		std::cerr << "Offscreen framebuffer not complete!" << std::endl;
+	return complete;
+}
+
+static double percentile(const std::vector<double>& sorted, double fraction)
+{
+	return sorted.empty() ? 0.0 : sorted[(size_t)((sorted.size() - 1) * fraction)];
+}
+
+static void writeBenchmarkJson(std::ostream& out, std::vector<double> frameTimes, const GpuProfiler& gpuProfiler)
+{
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); ++i)
+		sum += frameTimes[i];
+
+	std::vector<GpuScopeStats> passes;
+	gpuProfiler.stats(passes);
+
+	out << std::fixed << std::setprecision(3);
+	out << "{\n  \"frames\": " << frameTimes.size() << ",\n";
+	out << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+	out << "  \"frame_ms\": { \"mean\": " << (frameTimes.empty() ? 0.0 : sum / frameTimes.size())
+		<< ", \"p50\": " << percentile(frameTimes, 0.5) << ", \"p95\": " << percentile(frameTimes, 0.95)
+		<< ", \"p99\": " << percentile(frameTimes, 0.99) << ", \"max\": " << (frameTimes.empty() ? 0.0 : frameTimes.back()) << " },\n";
+	out << "  \"gpu_passes_ms\": {";
+	for (size_t i = 0; i < passes.size(); ++i)
+		out << (i ? "," : "") << "\n    \"" << passes[i].path << "\": { \"mean\": " << passes[i].average
+			<< ", \"p50\": " << passes[i].median << ", \"p95\": " << passes[i].p95 << ", \"max\": " << passes[i].max << " }";
+	out << "\n  }\n}" << std::endl;
+}
 
 // This function retrieves and stores the depth map of the default frame buffer 
 // or a particular frame buffer (indicated by FBO ID) to a PNG image.
@@ -92,250 +269,53 @@ static void saveDepthTexture(GLuint fbo, std::string filename) {
 
 
 
-// function for loading textures
-static GLuint LoadTextureTileBox(const char* texture_file_path) {
-	int w, h, channels;
-	stbi_set_flip_vertically_on_load(true); // This flips our texture along its x axis. This means reversing the image for the skybox is not flipped
-	uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
-	GLuint texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // This must be added for uneven file sizes to prevent crashes
-
-	// To tile textures on a box, we set wrapping to repeat
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); //Changing this to Clamp to Edge because only small gaps in 1 direction
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);// This or Linear
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	if (img) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else {
-		std::cout << "Failed to load texture " << texture_file_path << std::endl;
-	}
-	stbi_image_free(img);
-
-	return texture;
-}
-
 struct Skybox {
 	glm::vec3 position;		// Position of the box - should be equal 
 	glm::vec3 scale;		// Size of the skybox in each axis
 
-	GLfloat vertex_buffer_data[72] = {	// Vertex definition for a canonical box
-		// if we swap position of two opposite corners, then rotate 90 degrees to right, it swaps
-		// left - all good
-		//  z,    y,   x   
-		-1.0f, -1.0f, 1.0f,		// top left
-		-1.0f, 1.0f, 1.0f,		// bottom left
-		1.0f, 1.0f, 1.0f,		// bottom right
-		1.0f, -1.0f, 1.0f,		// top right
-
-		// right - All good
-		1.0f, -1.0f, -1.0f,		// bottom right
-		1.0f, 1.0f, -1.0f,		// top right
-		-1.0f, 1.0f, -1.0f,		// top left
-		-1.0f, -1.0f, -1.0f,	// bottom left
-
-		// front - All good
-		-1.0f, -1.0f, -1.0f,	// bottom left
-		-1.0f, 1.0f, -1.0f,		// top left
-		-1.0f, 1.0f, 1.0f,		// top right
-		-1.0f, -1.0f, 1.0f,		// bottom right
-
-		// behind - All good
-		1.0f, -1.0f, 1.0f,		// bottom right
-		1.0f, 1.0f, 1.0f,		// top right
-		1.0f, 1.0f, -1.0f,		// top left
-		1.0f, -1.0f, -1.0f,		// bottom left
-
-		// top - All good
-		-1.0f, 1.0f, -1.0f,		// 
-		1.0f, 1.0f, -1.0f,
-		1.0f, 1.0f, 1.0f,		//
-		-1.0f, 1.0f, 1.0f,
-
-		// bottom - pointing outwards (flip by swapping zs)
-		1.0f, -1.0f, -1.0f,		//
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f, 1.0f,		//
-		1.0f, -1.0f, 1.0f,
-	};
-
-	GLfloat color_buffer_data[72] = {
-		// Front, red
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		// Back, yellow
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-
-		// Left, green
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		// Right, cyan
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-
-		// Top, blue
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-
-		// Bottom, magenta
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-	};
-
-	GLuint index_buffer_data[36] = {		// 12 triangle faces of a box
-		0, 1, 2,
-		0, 2, 3,
-
-		4, 5, 6,
-		4, 6, 7,
-
-		8, 9, 10,
-		8, 10, 11,
-
-		12, 13, 14,
-		12, 14, 15,
-
-		16, 17, 18,
-		16, 18, 19,
-
-		20, 21, 22,
-		20, 22, 23,
-	};
-
+	// OpenGL buffers. The mesh lives in the mesh arena, the texture belongs to the GpuScene
+	GLuint vertexArrayID;
+	MeshRange meshRange;
+	glm::mat4 dequantize;	// scene positions are quantized to the mesh bounds
 
-	// Here I am making everything end 1 before it actually should because I was getting black lines in the skybox
-	GLfloat uv_buffer_data[48] = {
-		// x, y
-		// left
-		0.25f, 0.334f,		// bottom right
-		0.25f, 0.666f,		// top right
-		0.0f, 0.666f,		// top left					BRING BACK
-		0.0f, 0.334f,		// bottom left
-		// right
-		0.75f, 0.334f,
-		0.75f, 0.666f,
-		0.5f, 0.666f,
-		0.5f, 0.334f,
-		// front
-		0.5f, 0.334f,		// bottom right
-		0.5f, 0.666f,		// top right
-		0.25f, 0.666f,		// top left
-		0.25f, 0.334f,		// bottom left
-		// behind
-		1.0f, 0.334f,
-		1.0f, 0.666f,
-		0.75f, 0.666f,
-		0.75f, 0.334f,
-		// Top
-		0.5f, 0.667f,		// 
-		0.5f, 1.0f,			//
-		0.251f, 1.0f,		// X is higher to avoid a black line
-		0.251f, 0.667f,		// 
-		// Bottom
-		0.499f, 0.0f,
-		0.499f, 0.334f,
-		0.25f, 0.334f,
-		0.25f, 0.0f,
+	// Program, texture and MVP location for the render queue
+	RenderMaterial material;
 
-	};
-
-	// OpenGL buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint uvBufferID;
-	GLuint textureID;
-
-	// Shader variable IDs
-	GLuint mvpMatrixID;
-	GLuint textureSamplerID;
-	GLuint programID;
-
-	void initialize(glm::vec3 position, glm::vec3 scale) {
+	bool initialize(glm::vec3 position, glm::vec3 scale, const SceneFile& scene, GpuScene& gpuScene, GLuint programID) {
 		// Define scale of the building geometry
 		this->position = position;
 		this->scale = scale;
 
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create a vertex buffer object to store the vertex data		
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the UV data
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data, GL_STATIC_DRAW);
-
-		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
-
-		// Create and compile our GLSL program from the shaders
-		//programID = LoadShadersFromFile("../lab2/box.vert", "../lab2/box.frag");
-		programID = LoadShadersFromFile("../../../wonderland/Skybox_Files/skybox.vert",
-			"../../../wonderland/Skybox_Files/skybox.frag");
-		if (programID == 0)
+		int mesh = scene.findMesh("skybox");
+		if (mesh < 0)
 		{
-			std::cerr << "Failed to load shaders." << std::endl;
+			std::cout << "Scene has no skybox mesh" << std::endl;
+			return false;
 		}
-
-		// Get a handle for our "MVP" uniform
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-
-		// Load a texture
-		textureID = LoadTextureTileBox("../../../wonderland/Skybox_Files/Skybox_1.png");
-
-		// Get a handle to texture sampler 
-		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
+		// skybox.frag only samples the texture, so the color stream is left off
+		vertexArrayID = gpuScene.vertexArray(0, -1, -1, 2);
+		meshRange = gpuScene.meshRanges[mesh];
+		dequantize = glm::make_mat4(scene.meshes[mesh].dequantize);
+
+		// Program was compiled during startup
+		material.programID = programID;
+
+		// Camera comes from the ViewData block, only the model matrix is set per draw
+		material.modelMatrixID = glGetUniformLocation(material.programID, "M");
+		material.normalMatrixID = -1;
+		bindUniformBlocks(material.programID);
+
+		// Texture was loaded with the scene
+		material.textureID = gpuScene.meshTexture(scene, mesh);
+		material.name = "skybox";
+
+		// Sampler always reads texture unit 0, only needs setting once
+		glUseProgram(material.programID);
+		glUniform1i(glGetUniformLocation(material.programID, "textureSampler"), 0);
+		return true;
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glUseProgram(programID);
-
-		glBindVertexArray(vertexArrayID);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
+	void submit(RenderQueue& queue, const glm::mat4& viewMatrix) {
 		// Model transform 
 		glm::mat4 modelMatrix = glm::mat4();
 
@@ -344,414 +324,454 @@ struct Skybox {
 		// Scale the box along each axis
 		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// Set model-view-projection matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-
-		// Enable UV buffer and texture sampler
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// Set textureSampler to use texture unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-
-		// Draw the box
-		glDrawElements(
-			GL_TRIANGLES,      // mode
-			36,    			   // number of indices
-			GL_UNSIGNED_INT,   // type
-			(void*)0           // element array buffer offset
-		);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		//glDisableVertexAttribArray(2);
+		queue.add(PASS_SKY, material, vertexArrayID, meshRange, modelMatrix, dequantize, viewMatrix);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		glDeleteProgram(material.programID);
 	}
 };
 
+// The ground is a 3x3 grid of the same tile, all drawn with one program and texture
 struct Ground
 {
-	glm::vec3 position;
+	std::vector<glm::vec3> tiles;
+	std::vector<int> cullIDs;
+	float tileSize;
+	Aabb bounds;	// one tile, before it is scaled and moved
 
+	// Same as the skybox, every tile shares the scene buffers and texture
 	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint uvBufferID;
-	GLuint textureID;
-
-	GLuint mvpMatrixID;
-	GLuint textureSamplerID;
-	GLuint programID;
-
-	GLfloat ground_vertex_buffer_data[12] = {
-	-0.5f, 0.0f, -0.5f,
-	 0.5f, 0.0f, -0.5f,
-	 0.5f, 0.0f,  0.5f,
-	-0.5f, 0.0f,  0.5f
-	};
+	MeshRange meshRange;
+	glm::mat4 dequantize;
 
-	GLfloat ground_uv_buffer_data[8] = {
-	0.0f, 0.0f,
-	1.0f, 0.0f,
-	1.0f, 1.0f,
-	0.0f, 1.0f
-	};
-
-	GLuint ground_index_buffer_data[6] = {
-	0, 2, 1,
-	0, 3, 2
-	};
+	RenderMaterial material;
 
 
-	void initialize(glm::vec3 position)
+	bool initialize(int tileCount, float tileSize, const SceneFile& scene, GpuScene& gpuScene, GLuint programID)
 	{
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(ground_vertex_buffer_data), ground_vertex_buffer_data, GL_STATIC_DRAW);
+		tiles.resize(tileCount);
+		this->tileSize = tileSize;
 
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(ground_uv_buffer_data), ground_uv_buffer_data, GL_STATIC_DRAW);
-
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ground_index_buffer_data), ground_index_buffer_data, GL_STATIC_DRAW);
-
-		programID = LoadShadersFromFile("../../../wonderland/Ground_Files/ground.vert", "../../../wonderland/Ground_Files/ground.frag");
-		if (programID == 0)
+		int mesh = scene.findMesh("ground");
+		if (mesh < 0)
 		{
-			std::cerr << "Failed to load shaders." << std::endl;
+			std::cout << "Scene has no ground mesh" << std::endl;
+			return false;
 		}
-
-		// Get a handle for our "MVP" uniform
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-
-		// Load a texture
-		textureID = LoadTextureTileBox("../../../wonderland/Ground_Files/IMGP1394.jpg");
-
-		// Get a handle to texture sampler 
-		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
-
-		glBindVertexArray(0);
+		vertexArrayID = gpuScene.vertexArray(0, -1, -1, 1);
+		meshRange = gpuScene.meshRanges[mesh];
+		dequantize = glm::make_mat4(scene.meshes[mesh].dequantize);
+
+		// Tiles follow the camera, so their bounds get updated every frame
+		bounds = meshBounds(scene, mesh);
+		cullIDs.resize(tileCount);
+		for (int i = 0; i < tileCount; ++i)
+			cullIDs[i] = culler.add(transformAabb(bounds, tileMatrix(i)));
+
+		material.programID = programID;
+
+		// Camera comes from the ViewData block, only the model matrix is set per draw
+		material.modelMatrixID = glGetUniformLocation(material.programID, "M");
+		material.normalMatrixID = -1;
+		bindUniformBlocks(material.programID);
+
+		// Texture was loaded with the scene
+		material.textureID = gpuScene.meshTexture(scene, mesh);
+		material.name = "ground";
+
+		glUseProgram(material.programID);
+		glUniform1i(glGetUniformLocation(material.programID, "textureSampler"), 0);
+		return true;
 	}
 
-	void render(const glm::mat4& cameraMatrix, float tileSize)
+	glm::mat4 tileMatrix(size_t tile) const
 	{
-		glUseProgram(programID);
-		glBindVertexArray(vertexArrayID);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-
 		glm::mat4 modelMatrix = glm::mat4();
-		modelMatrix = glm::translate(modelMatrix, position);
+		modelMatrix = glm::translate(modelMatrix, tiles[tile]);
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(tileSize));
+		return modelMatrix;
+	}
 
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-		glDrawElements(GL_TRIANGLES,
-			6,
-			GL_UNSIGNED_INT,
-			(void*)0
-		);
+	// After the tiles have moved
+	void updateBounds()
+	{
+		for (size_t i = 0; i < tiles.size(); ++i)
+			culler.update(cullIDs[i], transformAabb(bounds, tileMatrix(i)));
+	}
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
+	void submit(RenderQueue& queue, const glm::mat4& viewMatrix, const std::vector<char>& visible)
+	{
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			if (!visible[cullIDs[i]])
+				continue;
+			queue.add(PASS_OPAQUE, material, vertexArrayID, meshRange, tileMatrix(i), dequantize, viewMatrix);
+		}
 	}
 	void cleanup()
 	{
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		glDeleteProgram(material.programID);
 	}
 };
 
 
 struct Box {
 
-	GLfloat vertexBufferData[60] = {
-		// This doesnt include one of the vertexes  - its fine its not visible
-		-105.75, 82.5, -61.75,
-		-66.25, 82.5, -74.0,
-		-78.5, 82.5, -114.0,
-		-118.0, 82.5, -101.5,
-
-		-105.75, 0.0, -61.75,
-		-105.75, 82.5, -61.75,
-		-118.0, 82.5, -101.5,
-		-118.0, 0.0, -101.5,
-
-		-118.0, 0.0, -101.5,
-		-118.0, 82.5, -101.5,
-		-78.5, 82.5, -114.0,
-		-78.5, 0.0, -114.0,
-
-		-78.5, 0.0, -114.0,
-		-78.5, 82.5, -114.0,
-		-66.25, 82.5, -74.0,
-		-66.25, 0.0, -74.0,
-
-		-66.25, 0.0, -74.0,
-		-66.25, 82.5, -74.0,
-		-105.75, 82.5, -61.75,
-		-105.75, 0.0, -61.75
-	};
+	// Vertex array over the scene's shared buffers
+	GLuint vertexArrayID;
 
-	GLfloat normalBufferData[60] = {
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-		0.0, 1.0, 0.0,
-
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-		0.956, 0.0, 0.295,
-
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-		0.302, 0.0, -0.953,
-
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-		-0.955, 0.0, -0.293,
-
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
-		-0.296, 0.0, 0.955,
+	// One draw for the box itself, plus one for every model node in a cooked scene.
+	// Those all use the box shader and live in the same buffers so they get drawn here too.
+	struct Draw {
+		glm::mat4 modelMatrix;
+		glm::mat4 dequantize;
+		MeshRange meshRange;
+		int cullID;
 	};
-	GLfloat colorBufferData[60] = {
-		// Floor
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Ceiling
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Left wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Right wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-
-		// Back wall
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f
-	};
-
-	// Refer to original Cornell Box data 
-	// from https://www.graphics.cornell.edu/online/box/data.html
-
-	GLuint index_buffer_data[30] = {
-		0, 1, 2,
-		0, 2, 3,
+	std::vector<Draw> draws;
+
+	// Lit pass and shadow map pass. The queue sets M per draw, the camera and
+	// light come from the shared uniform blocks.
+	RenderMaterial material;
+	RenderMaterial depthMaterial;
+
+	void addDraw(const SceneFile& scene, const GpuScene& gpuScene, int mesh, const glm::mat4& modelMatrix) {
+		Draw draw;
+		draw.modelMatrix = modelMatrix;
+		draw.dequantize = glm::make_mat4(scene.meshes[mesh].dequantize);
+		draw.meshRange = gpuScene.meshRanges[mesh];
+		draw.cullID = culler.add(transformAabb(meshBounds(scene, mesh), modelMatrix));
+		draws.push_back(draw);
+	}
 
-		4, 5, 6,
-		4, 6, 7,
+	bool initialize(const SceneFile& scene, GpuScene& gpuScene, GLuint programID) {
+		int mesh = scene.findMesh("box");
+		if (mesh < 0)
+		{
+			std::cout << "Scene has no box mesh" << std::endl;
+			return false;
+		}
 
-		8, 9, 10,
-		8, 10, 11,
+		vertexArrayID = gpuScene.vertexArray(0, 2, 1, -1);
 
-		12, 13, 14,
-		12, 14, 15,
+		addDraw(scene, gpuScene, mesh, glm::mat4(1.0f));
+		// The walls hide most of what's behind them, the models are too small to bother with
+		addOccluder(scene, mesh, glm::mat4(1.0f));
 
-		16, 17, 18,
-		16, 18, 19,
-	};
-
-	// OpenGL buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint normalBufferID;
-
-	// Shader variable IDs
-	GLuint mvpMatrixID;
-	GLuint mMatrixID;
-	GLuint lightPositionID;
-	GLuint lightIntensityID;
-	GLuint lightSpaceMatrixID;
-	GLuint shadowMapSamplerID;
-	GLuint programID;
-
-	void initialize() {
-
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create a vertex buffer object to store the vertex data		
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->vertexBufferData), this->vertexBufferData, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->colorBufferData), this->colorBufferData, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the vertex normals		
-		glGenBuffers(1, &normalBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(this->normalBufferData), this->normalBufferData, GL_STATIC_DRAW);
-
-		// Create an index buffer object to store the index data that defines triangle faces
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
-
-		// Create and compile our GLSL program from the shaders
-		programID = LoadShadersFromFile("../../../wonderland/box.vert", "../../../wonderland/box.frag");
-		if (programID == 0)
+		// The cooker flattened the node hierarchy, each node comes with its world transform
+		for (uint32_t i = 0; i < scene.header->nodeCount; ++i)
 		{
-			std::cerr << "Failed to load shaders." << std::endl;
+			if (scene.nodes[i].mesh < 0 || scene.nodes[i].mesh >= (int)scene.header->meshCount)
+			{
+				std::cout << "Skipping node " << i << ", its mesh " << scene.nodes[i].mesh << " isnt in the scene" << std::endl;
+				continue;
+			}
+			addDraw(scene, gpuScene, scene.nodes[i].mesh, glm::make_mat4(scene.nodes[i].transform));
 		}
 
-		// Get a handle for our "MVP" uniform
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-		mMatrixID = glGetUniformLocation(programID, "M");
-		lightPositionID = glGetUniformLocation(programID, "lightPosition");
-		lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
-		lightSpaceMatrixID = glGetUniformLocation(programID, "lightSpaceMatrix");
-		shadowMapSamplerID = glGetUniformLocation(programID, "shadowMap");
-	}
+		material.programID = programID;
+		material.textureID = 0;
+		material.modelMatrixID = glGetUniformLocation(programID, "M");
+		material.normalMatrixID = glGetUniformLocation(programID, "N");
+		material.name = "box";
+		bindUniformBlocks(programID);
 
-	void render(glm::mat4 cameraMatrix, glm::mat4 viewMatrix) {
+		// Shadow map always sits on texture unit 1
 		glUseProgram(programID);
+		glUniform1i(glGetUniformLocation(programID, "shadowMap"), 1);
+
+		// Depth shader draws from the light's view
+		depthMaterial.programID = depthProgramID;
+		depthMaterial.textureID = 0;
+		depthMaterial.modelMatrixID = glGetUniformLocation(depthProgramID, "M");
+		depthMaterial.normalMatrixID = -1;
+		depthMaterial.name = "box";
+		bindUniformBlocks(depthProgramID);
+		return true;
+	}
 
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	// Once a frame, before the main queue is submitted
+	void bindShadowMap() {
+		glState.bindTexture(GL_TEXTURE1, depthMapTexture);
+	}
 
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	void submit(RenderQueue& queue, const glm::mat4& viewMatrix, const std::vector<char>& visible) {
+		// Dequantizing only goes into the position transforms, the queue makes the normal matrix without it
+		for (size_t i = 0; i < draws.size(); ++i)
+			if (visible[draws[i].cullID])
+				queue.add(PASS_OPAQUE, material, vertexArrayID, draws[i].meshRange,
+					draws[i].modelMatrix, draws[i].dequantize, viewMatrix);
+	}
+
+	// Getting the depth map for Shadow mapping. Culled against the light's frustum,
+	// things off camera can still cast shadows into view.
+	void submitDepth(RenderQueue& queue, const glm::mat4& lightView, const std::vector<char>& visible) {
+		for (size_t i = 0; i < draws.size(); ++i)
+			if (visible[draws[i].cullID])
+				queue.add(PASS_OPAQUE, depthMaterial, vertexArrayID, draws[i].meshRange,
+					draws[i].modelMatrix, draws[i].dequantize, lightView);
+	}
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	void cleanup() {
+		glDeleteProgram(material.programID);
+	}
+};
 
 
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
+// Frame packets in flight. The simulation fills one while the render thread draws the other.
+#define FRAME_PACKETS (2)
 
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+// Everything the render side needs for one frame. The simulation makes it, and nothing
+// writes to it again until the render thread has drawn it.
+struct FramePacket {
+	float time;
+	FrameData frameData;
+	ViewData views[VIEW_COUNT];
 
-		glUniformMatrix4fv(mMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
+	// Sorted and recorded, they only need replaying
+	RenderQueue shadowQueue;
+	RenderQueue mainQueue;
 
-		glm::mat4 mvMatrix = viewMatrix * modelMatrix;
-		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(mvMatrix)));
-		GLuint normalMatrixID = glGetUniformLocation(programID, "normalMatrix");
-		glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalMatrix[0][0]);
+	CullStats cameraCull;
+	CullStats lightCull;
+	OcclusionStats occlusion;
+	bool saveDepth;
+	float simulateMs;	// how long the job took to make it
+};
 
-		glUniform3fv(lightPositionID, 1, &lightPosition[0]);
-		glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
-		glUniformMatrix4fv(lightSpaceMatrixID, 1, GL_FALSE, &lightSpaceMatrix[0][0]);
+// What the simulation gets to see of the input. Copied on the main thread before the
+// job starts, the callbacks keep changing the globals while it runs.
+struct SimulationInput {
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraLookVector;
+	float time;
+	bool saveDepth;
+};
 
-		GLuint farPlaneID = glGetUniformLocation(programID, "farPlane");
-		glUniform1f(farPlaneID, depthFar);
+static SimulationInput readInput(float time)
+{
+	SimulationInput input;
+	input.cameraPosition = cameraPosition;
+	input.cameraLookVector = cameraLookVector;
+	input.time = time;
+	input.saveDepth = saveDepth;
+	saveDepth = false;
+	return input;
+}
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-		glUniform1i(shadowMapSamplerID, 1);
+// The half of a frame that doesn't touch GL: moving the ground, culling and building
+// the draw lists. Runs as a job, so it only ever reads its own copy of the input.
+// Besides the packet it owns the ground tiles, the skybox position, the BVH and the
+// occlusion culler, the render thread leaves all of those alone.
+struct Simulation {
+	Skybox* skybox;
+	Ground* ground;
+	Box* box;
+	JobSystem* jobs;
+	float tileSize;
+	glm::mat4 projectionMatrix;
+
+	SimulationInput input;
+	std::vector<char> cameraVisible, lightVisible;
+
+	void run(FramePacket& packet) {
+		TRACE_ZONE("simulate");
+		double start = glfwGetTime();
+		glm::vec3 lightTarget = lightPosition + glm::vec3(0.0f, -1.0f, 0.0f);
+		glm::mat4 lightView = glm::lookAt(lightPosition, lightTarget, lightUp);
 
-		// Draw the box
-		glDrawElements(
-			GL_TRIANGLES,      // mode
-			30,    			   // number of indices
-			GL_UNSIGNED_INT,   // type
-			(void*)0           // element array buffer offset
-		);
+		glm::mat4 lightProjection = glm::perspective(glm::radians(depthFoV), (float)shadowMapWidth / shadowMapHeight, depthNear, depthFar);
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-	}
+		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
 
-	// Getting the depth map for Shadow mapping
-	void renderDepth(const glm::mat4& lightSpaceMatrix) {
-		glUseProgram(depthProgramID);
-		glBindVertexArray(vertexArrayID);
+		// lookAt( where camera is, where its looking at relative to where it is, its up )
+		glm::mat4 viewMatrix = glm::lookAt(input.cameraPosition, input.cameraPosition + input.cameraLookVector, cameraUp);
+
+		packet.time = input.time;
+		packet.frameData.lightSpaceMatrix = lightSpaceMatrix;
+		packet.frameData.lightPosition = glm::vec4(lightPosition, 1.0f);
+		packet.frameData.lightIntensity = glm::vec4(lightIntensity, 0.0f);
+		packet.frameData.farPlane = depthFar;
+		packet.frameData.time = input.time;
+
+		ViewData* views = packet.views;
+		views[VIEW_CAMERA].view = viewMatrix;
+		views[VIEW_CAMERA].projection = projectionMatrix;
+		views[VIEW_CAMERA].viewProjection = projectionMatrix * viewMatrix;
+		views[VIEW_CAMERA].cameraPosition = glm::vec4(input.cameraPosition, 1.0f);
+
+		views[VIEW_LIGHT].view = lightView;
+		views[VIEW_LIGHT].projection = lightProjection;
+		views[VIEW_LIGHT].viewProjection = lightSpaceMatrix;
+		views[VIEW_LIGHT].cameraPosition = glm::vec4(lightPosition, 1.0f);
 
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
+		// For "moving" the ground as the player moves
+		int camTileX = static_cast<int>(floor(input.cameraPosition.x / tileSize));
+		int camTileZ = static_cast<int>(floor(input.cameraPosition.z / tileSize));
 
-		glm::mat4 mvp = lightSpaceMatrix * modelMatrix;
+		int index = 0;
+		for (int x = -1; x <= 1; ++x)
+		{
+			for (int z = -1; z <= 1; ++z)
+			{
+				ground->tiles[index].x = (camTileX + x) * tileSize;
+				ground->tiles[index].z = (camTileZ + z) * tileSize;
+				ground->tiles[index].y = 0.0f;
+				index++;
+			}
+		}
+		ground->updateBounds();
+
+		culler.refit();
+		culler.cull(extractFrustum(views[VIEW_CAMERA].viewProjection), cameraVisible, packet.cameraCull);
+		occlusion.render(views[VIEW_CAMERA].viewProjection);
+		occlusion.cull(culler.objectBounds, cameraVisible);
+		culler.cull(extractFrustum(lightSpaceMatrix), lightVisible, packet.lightCull);
+		packet.occlusion = occlusion.stats;
+
+		packet.shadowQueue.clear();
+		box->submitDepth(packet.shadowQueue, lightView, lightVisible);
+		packet.shadowQueue.sort();
+
+		skybox->position = input.cameraPosition;
+
+		// Collect everything, the render thread draws it grouped by program/texture/vertex array
+		packet.mainQueue.clear();
+		skybox->submit(packet.mainQueue, viewMatrix);
+		ground->submit(packet.mainQueue, viewMatrix, cameraVisible);
+		box->submit(packet.mainQueue, viewMatrix, cameraVisible);
+		packet.mainQueue.sort();
+
+		// Both queues get recorded at once, the render thread only replays them
+		Job* shadowRecording = packet.shadowQueue.recordAsync(*jobs);
+		Job* mainRecording = packet.mainQueue.recordAsync(*jobs);
+		jobs->wait(shadowRecording);
+		jobs->wait(mainRecording);
+
+		// The GL depth buffer gets saved when this packet is drawn
+		packet.saveDepth = input.saveDepth;
+		if (input.saveDepth) {
+			std::vector<unsigned char> occlusionImage(OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+			for (size_t i = 0; i < occlusionImage.size(); ++i)
+				occlusionImage[i] = (unsigned char)(std::min(std::max(occlusion.levels[0][i], 0.0f), 1.0f) * 255);
+			stbi_write_png("depth_occlusion.png", OCCLUSION_WIDTH, OCCLUSION_HEIGHT, 1, occlusionImage.data(), OCCLUSION_WIDTH);
+			std::cout << "Occlusion buffer saved to depth_occlusion.png" << std::endl;
+		}
+		packet.simulateMs = (float)((glfwGetTime() - start) * 1000.0);
+	}
+};
 
-		GLuint mvpDepthID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
-		glUniformMatrix4fv(mvpDepthID, 1, GL_FALSE, &mvp[0][0]);
+struct SimulationJob {
+	Simulation* simulation;
+	FramePacket* packet;
+};
 
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+static void simulationJob(Job*, const void* data)
+{
+	const SimulationJob* job = (const SimulationJob*)data;
+	job->simulation->run(*job->packet);
+}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
 
-		glDrawElements(GL_TRIANGLES, 30, GL_UNSIGNED_INT, (void*)0);
+// Render thread's side of the last frame, in milliseconds
+struct CpuTimings {
+	float frame;
+	float render;	// issuing the passes
+	float hud;
+	float swap;
+	float wait;		// for the simulation job
+};
 
-		glDisableVertexAttribArray(0);
+#define OVERLAY_GRAPH_FRAMES (240)
+#define OVERLAY_GRAPH_MS (33.3f)	// top of the graph, with a line at 60 fps
+#define OVERLAY_REFRESH (0.25f)		// seconds between updates of the text, slow enough to read
+#define OVERLAY_LINES (8)
+
+// Frame time graph and the numbers the console stats print, drawn over the scene in
+// one batch. The text is formatted a few times a second, the graph moves every frame.
+struct StatsOverlay {
+	Hud hud;
+	float cpuFrames[OVERLAY_GRAPH_FRAMES];
+	float gpuFrames[OVERLAY_GRAPH_FRAMES];
+	int newest;
+	float lastRefresh;
+
+	char lines[OVERLAY_LINES][128];
+	int lineCount;
+	float panelWidth;
+
+	bool initialize(GLuint programID, const StreamBuffer& stream) {
+		memset(cpuFrames, 0, sizeof(cpuFrames));
+		memset(gpuFrames, 0, sizeof(gpuFrames));
+		newest = 0;
+		lastRefresh = -OVERLAY_REFRESH;
+		lineCount = 0;
+		panelWidth = 0.0f;
+		return hud.initialize(programID, stream);
 	}
 
+	void update(float time, const CpuTimings& cpu, const GpuProfiler& gpuProfiler, const GLCallStats& calls,
+		const FramePacket& packet, const GLResourceTotals& gl) {
+		newest = (newest + 1) % OVERLAY_GRAPH_FRAMES;
+		cpuFrames[newest] = cpu.frame;
+		gpuFrames[newest] = gpuProfiler.latest("frame");
+		if (time - lastRefresh < OVERLAY_REFRESH)
+			return;
+		lastRefresh = time;
+
+		lineCount = 0;
+		snprintf(lines[lineCount++], sizeof(lines[0]), "Frame %.2f ms (%.0f fps)  GPU %.2f ms",
+			cpu.frame, cpu.frame > 0.0f ? 1000.0f / cpu.frame : 0.0f, gpuFrames[newest]);
+		snprintf(lines[lineCount++], sizeof(lines[0]), "CPU ms  simulate %.2f  render %.2f  hud %.3f  swap %.2f  wait %.2f",
+			packet.simulateMs, cpu.render, cpu.hud, cpu.swap, cpu.wait);
+
+		// Just the passes, their per material scopes would never fit on a line
+		std::vector<GpuScopeStats> scopes;
+		gpuProfiler.stats(scopes);
+		int written = snprintf(lines[lineCount], sizeof(lines[0]), "GPU ms ");
+		for (size_t i = 0; i < scopes.size() && written < (int)sizeof(lines[0]); ++i)
+			if (scopes[i].depth == 1)
+				written += snprintf(lines[lineCount] + written, sizeof(lines[0]) - written, " %s %.3f",
+					scopes[i].path.substr(scopes[i].path.rfind('/') + 1).c_str(), scopes[i].average);
+		lineCount++;
+
+		snprintf(lines[lineCount++], sizeof(lines[0]), "Draws %d  triangles %.1fk  GL calls %d issued, %d elided",
+			calls.issued[GL_CALL_DRAW], calls.triangles / 1000.0f, calls.totalIssued(), calls.totalElided());
+		snprintf(lines[lineCount++], sizeof(lines[0]), "Visible %d of %d  occluded %d",
+			packet.cameraCull.objectsVisible, packet.cameraCull.objectsVisible + packet.cameraCull.objectsCulled,
+			packet.occlusion.objectsOccluded);
+		snprintf(lines[lineCount++], sizeof(lines[0]), "Memory %.1f MB resident, %.1f MB GL (%.1f peak)",
+			processResidentBytes() / (1024.0 * 1024.0), gl.totalBytes / (1024.0 * 1024.0), gl.peakBytes / (1024.0 * 1024.0));
+
+		panelWidth = 0.0f;
+		for (int i = 0; i < lineCount; ++i)
+			panelWidth = std::max(panelWidth, Hud::textWidth(lines[i]));
+	}
 
-	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &normalBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteProgram(programID);
+	void draw(GLStateCache& state, StreamBuffer& stream) {
+		const float margin = 8.0f;
+		const float graphHeight = 60.0f;
+		float line = Hud::lineHeight();
+		float x = 2.0f * margin;
+		float y = 2.0f * margin;
+
+		hud.begin(windowWidth, windowHeight);
+		hud.rect(margin, margin, panelWidth + 2.0f * margin, lineCount * line + graphHeight + 3.0f * margin, HUD_RGBA(0, 0, 0, 160));
+		if (lineCount > 0)
+			hud.text(x, y, lines[0], HUD_RGBA(255, 255, 255, 255));
+		y += line;
+
+		// CPU frame time with the GPU's on top of it, and a line at 60 fps
+		hud.graph(x, y, panelWidth, graphHeight, cpuFrames, OVERLAY_GRAPH_FRAMES, newest, OVERLAY_GRAPH_MS, HUD_RGBA(80, 200, 120, 200));
+		hud.graph(x, y, panelWidth, graphHeight, gpuFrames, OVERLAY_GRAPH_FRAMES, newest, OVERLAY_GRAPH_MS, HUD_RGBA(255, 170, 40, 200));
+		hud.rect(x, y + graphHeight * (1.0f - 16.7f / OVERLAY_GRAPH_MS), panelWidth, 1.0f, HUD_RGBA(255, 255, 255, 120));
+		y += graphHeight + margin;
+
+		for (int i = 1; i < lineCount; ++i, y += line)
+			hud.text(x, y, lines[i], HUD_RGBA(220, 220, 220, 255));
+		hud.draw(state, stream);
 	}
 };
 
@@ -759,8 +779,64 @@ struct Box {
 // ------------------------------------------------------
 // ------------------------------------------------------
 
-int main(void)
+// Shader source for one program, read on a worker and then compiled on the main thread
+struct ShaderSource {
+	std::string vertex;
+	std::string fragment;
+};
+
+// Returns the compile task, anything using the program depends on that
+static int addProgramTasks(LoadGraph& graph, const std::string& name, const char* vertexPath, const char* fragmentPath,
+	ShaderSource& source, GLuint& programID)
+{
+	int read = graph.add("read " + name + " shaders", LOAD_WORKER, [vertexPath, fragmentPath, &source]() {
+		return ReadShaderFiles(vertexPath, fragmentPath, source.vertex, source.fragment);
+	});
+	int compile = graph.add("compile " + name + " program", LOAD_MAIN, [&source, &programID]() {
+		programID = source.vertex.empty() ? 0 : LoadShadersFromString(source.vertex, source.fragment);
+		return programID != 0;
+	});
+	graph.depends(compile, read);
+	return compile;
+}
+
+int main(int argc, char** argv)
 {
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmark = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				benchmarkFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			benchmarkOutput = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordFile = argv[++i];
+		else if (strcmp(argv[i], "--hud") == 0)
+			showHud = true;
+		else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+			metricsPort = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			if (!replayPath.load(argv[++i]))
+				return 1;
+			replaying = true;
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--benchmark [frames]] [--output file.json] [--record path.cam] [--replay path.cam] [--hud] [--metrics port]" << std::endl;
+			std::cout << "On machines without a GPU, run the benchmark under xvfb-run with LIBGL_ALWAYS_SOFTWARE=1" << std::endl;
+			return 1;
+		}
+	}
+	if (benchmark && !benchmarkOutput)
+	{
+		std::cout << "--benchmark needs --output file.json for its results" << std::endl;
+		return 1;
+	}
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
@@ -772,6 +848,8 @@ int main(void)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MacOS
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (benchmark)
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(windowWidth, windowHeight, "Wonderland", NULL, NULL);
@@ -787,8 +865,12 @@ int main(void)
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 	glfwSetKeyCallback(window, key_callback);
 
-	glfwSetCursorPosCallback(window, cursor_callback);
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // capture our mouse so it stays centred in our frame
+	// The benchmark and replays fly themselves, and shouldn't grab the mouse
+	if (!benchmark && !replaying)
+	{
+		glfwSetCursorPosCallback(window, cursor_callback);
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // capture our mouse so it stays centred in our frame
+	}
 
 	// Load OpenGL functions, gladLoadGL returns the loaded version, 0 on error.
 	int version = gladLoadGL(glfwGetProcAddress);
@@ -798,19 +880,26 @@ int main(void)
 		return -1;
 	}
 
-
-	// Shadow mapping
-	depthProgramID = LoadShadersFromFile("../../../wonderland/depth.vert", "../../../wonderland/depth.frag");
-	if (depthProgramID == 0) {
-		std::cerr << "Failed to load depth shaders." << std::endl;
+	if (benchmark)
+	{
+		// Nothing should wait on a display refresh, and a hidden window's own
+		// framebuffer doesnt have to keep anything drawn to it
+		glfwSwapInterval(0);
+		if (!createSceneFramebuffer())
+			return -1;
+		glStatsInterval = 0.0f;
+		std::cout << "Benchmarking " << benchmarkFrames << " frames on " << glGetString(GL_RENDERER) << std::endl;
 	}
 
-	glGenFramebuffers(1, &depthMapFBO);
 
-	glGenTextures(1, &depthMapTexture);
+	// Shadow mapping
+	depthMapFBO.create("shadow map");
+
+	depthMapTexture.create("shadow map");
 	glBindTexture(GL_TEXTURE_2D, depthMapTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
 		shadowMapWidth, shadowMapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	depthMapTexture.setBytes(glTextureBytes(GL_DEPTH_COMPONENT, shadowMapWidth, shadowMapHeight));
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -839,42 +928,191 @@ int main(void)
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 
+	// A worker per core besides this one, for loading and the occlusion rasterizer
+	JobSystem jobs;
+	jobs.initialize(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+	occlusion.initialize(jobs);
+
+	// Startup runs as a graph: shader files are read and images decoded on the workers,
+	// while this thread compiles, links and uploads each thing as soon as its inputs are in
+	LoadGraph startup;
+
+	ShaderSource depthSource, skyboxSource, groundSource, boxSource, hudSource;
+	GLuint skyboxProgramID = 0, groundProgramID = 0, boxProgramID = 0, hudProgramID = 0;
+	int depthProgram = addProgramTasks(startup, "depth", "../../../wonderland/depth.vert", "../../../wonderland/depth.frag", depthSource, depthProgramID);
+	int skyboxProgram = addProgramTasks(startup, "skybox", "../../../wonderland/Skybox_Files/skybox.vert",
+		"../../../wonderland/Skybox_Files/skybox.frag", skyboxSource, skyboxProgramID);
+	int groundProgram = addProgramTasks(startup, "ground", "../../../wonderland/Ground_Files/ground.vert",
+		"../../../wonderland/Ground_Files/ground.frag", groundSource, groundProgramID);
+	int boxProgram = addProgramTasks(startup, "box", "../../../wonderland/box.vert", "../../../wonderland/box.frag", boxSource, boxProgramID);
+	addProgramTasks(startup, "hud", "../../../wonderland/hud.vert", "../../../wonderland/hud.frag", hudSource, hudProgramID);
+
+	// Use the cooked scene if wonderland_cook has been run, otherwise cook the built-in
+	// meshes and textures in memory so everything goes down the same path.
+	// The cooked file is only mapped here, it gets read as it is uploaded.
+	SceneFile sceneFile;
+	std::vector<unsigned char> builtScene;
+	SceneBuilder builder;
+	const char* texturePaths[] = { "../../../wonderland/Skybox_Files/Skybox_1.png", "../../../wonderland/Ground_Files/IMGP1394.jpg" };
+	SceneTexture textures[2];
+	std::vector<unsigned char> texels[2];
+
+	int sceneReady = -1;
+	if (!sceneFile.open("../../../wonderland/wonderland.scene"))
+	{
+		// Images decode side by side, the meshes need them in order for their texture indices
+		sceneReady = startup.add("build scene", LOAD_WORKER, [&]() {
+			for (int i = 0; i < 2; ++i)
+				if (!texels[i].empty())
+					builder.addTexture(textures[i], texels[i]);
+			builder.addBuiltinMeshes();
+			builder.printReport("Built-in meshes", 0, builder.meshes.size());
+			builder.serialize(builtScene);
+			return sceneFile.openMemory(builtScene.data(), builtScene.size());
+		});
+		for (int i = 0; i < 2; ++i)
+		{
+			std::string path = texturePaths[i];
+			// A missing image only leaves its mesh untextured, the scene still gets built
+			int decode = startup.add("decode " + path.substr(path.find_last_of('/') + 1), LOAD_WORKER, [&, i]() {
+				loadSceneTexture(texturePaths[i], textures[i], texels[i]);
+				return true;
+			});
+			startup.depends(sceneReady, decode);
+		}
+	}
+
+	MeshArena meshArena;
+	GpuScene gpuScene;
+	int upload = startup.add("upload scene", LOAD_MAIN, [&]() {
+		// One vertex and index buffer for every static mesh, big enough for the scene
+		meshArena.initialize(sizeof(SceneVertex),
+			std::max<size_t>(MESH_ARENA_VERTICES, sceneFile.header->vertexCount),
+			std::max<size_t>(MESH_ARENA_INDICES, sceneFile.header->indexCount));
+		return gpuScene.initialize(sceneFile, meshArena);
+	});
+	if (sceneReady >= 0)
+		startup.depends(upload, sceneReady);
+
 	Skybox skybox;
-	skybox.initialize(cameraPosition, glm::vec3(500, 500, 500));  // Scale x,y,z
+	int skyboxReady = startup.add("skybox", LOAD_MAIN, [&]() {
+		return skybox.initialize(cameraPosition, glm::vec3(500, 500, 500), sceneFile, gpuScene, skyboxProgramID);  // Scale x,y,z
+	});
+	startup.depends(skyboxReady, upload);
+	startup.depends(skyboxReady, skyboxProgram);
 
 	// 3x3 grid for our ground so it appears infinite
 	int gridSize = 3;
 	float tileSize = 500.0f; // The size of each of the individual sections of ground
-	std::vector<Ground> groundTiles(gridSize * gridSize);
+	Ground ground;
+	int groundReady = startup.add("ground", LOAD_MAIN, [&]() {
+		return ground.initialize(gridSize * gridSize, tileSize, sceneFile, gpuScene, groundProgramID);
+	});
+	startup.depends(groundReady, upload);
+	startup.depends(groundReady, groundProgram);
 
-	int index = 0;
-	for (int x = -1; x <= 1; ++x)
+	Box box;
+	int boxReady = startup.add("box", LOAD_MAIN, [&]() {
+		return box.initialize(sceneFile, gpuScene, boxProgramID);
+	});
+	startup.depends(boxReady, upload);
+	startup.depends(boxReady, boxProgram);
+	startup.depends(boxReady, depthProgram);
+
+	bool loaded = startup.run(jobs);
+	startup.printReport();
+	if (!loaded)
 	{
-		for (int z = -1; z <= 1; ++z)
-		{
-			glm::vec3 startPosition;
-			startPosition.x = x * tileSize;
-			startPosition.y = 0.0f;
-			startPosition.z = z * tileSize;
+		std::cerr << "Startup failed, see the tasks above" << std::endl;
+		jobs.cleanup();
+		return -1;
+	}
 
-			groundTiles[index].initialize(startPosition);
-			index++;
-		}
+	// Nothing gets added after this, only moved
+	culler.build();
+
+	// What got loaded, before the scene file goes away. The counts don't change after this.
+	MetricsExporter metrics;
+	bool exportingMetrics = metricsPort > 0 && metrics.start(metricsPort, &jobs);
+	if (exportingMetrics)
+	{
+		int failed = 0;
+		for (size_t i = 0; i < startup.tasks.size(); ++i)
+			failed += startup.tasks[i].succeeded ? 0 : 1;
+		metrics.set(METRIC_MESHES, sceneFile.header->meshCount);
+		metrics.set(METRIC_NODES, sceneFile.header->nodeCount);
+		metrics.set(METRIC_TEXTURES, sceneFile.header->textureCount);
+		metrics.set(METRIC_VERTICES, sceneFile.header->vertexCount);
+		metrics.set(METRIC_TRIANGLES_LOADED, sceneFile.header->indexCount / 3);
+		metrics.set(METRIC_LOAD_TASKS_FAILED, failed);
 	}
 
-	Box box;
-	box.initialize();
+	// Everything is on the GPU now
+	sceneFile.close();
+	std::vector<unsigned char>().swap(builtScene);
+	builder = SceneBuilder();
+	for (int i = 0; i < 2; ++i)
+		std::vector<unsigned char>().swap(texels[i]);
 
 
 	// Camera setup
-	glm::mat4 viewMatrix, projectionMatrix;
+	glm::mat4 projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(FoV), (float)windowWidth / windowHeight, zNear, zFar);
 
+	// Frames are pipelined: while this thread draws one packet, a job simulates the
+	// next frame into the other. Input shows up a frame later than it would otherwise.
+	Simulation simulation;
+	simulation.skybox = &skybox;
+	simulation.ground = &ground;
+	simulation.box = &box;
+	simulation.jobs = &jobs;
+	simulation.tileSize = tileSize;
+	simulation.projectionMatrix = projectionMatrix;
+	FramePacket packets[FRAME_PACKETS];
+	int frame = 0;
+
+	// First packet is made up front so there's something to draw
+	simulation.input = readInput(driveCamera(0, static_cast<float>(glfwGetTime())));
+
+	// A replay stops at the end of its path, a benchmark without one after its frames
+	int lastFrame = -1;
+	if (replaying)
+		lastFrame = (int)replayPath.keys.size();
+	else if (benchmark)
+		lastFrame = BENCHMARK_WARMUP_FRAMES + benchmarkFrames;
+	simulation.run(packets[0]);
+
+	// Everything rewritten each frame comes out of this, a few frames ahead of the GPU.
+	// Most of it is the overlay's vertices when that's on.
+	StreamBuffer stream;
+	stream.initialize(256 * 1024, glfwGetProcAddress);
+
+	StatsOverlay overlay;
+	overlay.initialize(hudProgramID, stream);
+	CpuTimings cpu;
+	memset(&cpu, 0, sizeof(cpu));
+
+	// Times each pass on the GPU, printed with the GL stats
+	GpuProfiler gpuProfiler;
+	gpuProfiler.initialize(glfwGetProcAddress);
+
+	// Camera and light data for every program, written once a frame
+	UniformBlocks uniformBlocks;
+	uniformBlocks.initialize();
+
+	// Loading bound all sorts behind the cache's back
+	glState.invalidate();
+	float lastStatsTime = 0.0f;
+	std::vector<double> frameTimes;	// milliseconds, benchmark only
+	double loopStart = glfwGetTime();
+
 	// -----------------------------------------------------------
 	// -----------------------------------------------------------
 
 	do
 	{
+		TRACE_ZONE("frame");
+		double frameStart = glfwGetTime();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Getting timing for frames
@@ -882,98 +1120,180 @@ int main(void)
 		deltaTime = currentFrame - previousFrame;
 		previousFrame = currentFrame;
 
+		// Kick off the next frame, then draw this one while it runs
+		FramePacket& packet = packets[frame % FRAME_PACKETS];
+		simulation.input = readInput(driveCamera(frame + 1, currentFrame));
+		SimulationJob next = { &simulation, &packets[(frame + 1) % FRAME_PACKETS] };
+		Job* simulating = jobs.create(&simulationJob, NULL, &next, sizeof(next));
+		jobs.run(simulating);
 
-		glm::vec3 lightTarget = lightPosition + glm::vec3(0.0f, -1.0f, 0.0f);
-		glm::mat4 lightView = glm::lookAt(lightPosition, lightTarget, lightUp);
-
-		glm::mat4 lightProjection = glm::perspective(glm::radians(depthFoV), (float)shadowMapWidth / shadowMapHeight, depthNear, depthFar);
+		stream.beginFrame();
+		gpuProfiler.beginFrame();
+		gpuProfiler.begin("frame");
+		uniformBlocks.update(stream, packet.frameData, packet.views, VIEW_COUNT);
 
-		lightSpaceMatrix = lightProjection * lightView;
-
-		
-		glViewport(0, 0, shadowMapWidth, shadowMapHeight);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+		glState.viewport(0, 0, shadowMapWidth, shadowMapHeight);
+		glState.bindFramebuffer(depthMapFBO);
 		glClear(GL_DEPTH_BUFFER_BIT);
-		glCullFace(GL_FRONT);
-
-		glUseProgram(depthProgramID);
-		GLuint depthLightSpaceMatrixID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
-		GLuint depthLightPositionID = glGetUniformLocation(depthProgramID, "lightPosition");
-		GLuint depthFarPlaneID = glGetUniformLocation(depthProgramID, "farPlane");
-
-		glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, &lightSpaceMatrix[0][0]);
-		glUniform3fv(depthLightPositionID, 1, &lightPosition[0]);
-		glUniform1f(depthFarPlaneID, depthFar);
+		glState.cullFace(GL_FRONT);
 
-		box.renderDepth(lightSpaceMatrix);
+		gpuProfiler.begin("shadow");
+		uniformBlocks.bindView(VIEW_LIGHT);
+		packet.shadowQueue.replay(glState, &gpuProfiler);
+		gpuProfiler.end();
 
 
-		glCullFace(GL_BACK);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glState.cullFace(GL_BACK);
+		glState.bindFramebuffer(sceneFBO);
 
-		glViewport(0, 0, windowWidth, windowHeight);
+		glState.viewport(0, 0, windowWidth, windowHeight);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		box.bindShadowMap();
 
+		gpuProfiler.begin("main");
+		uniformBlocks.bindView(VIEW_CAMERA);
+		packet.mainQueue.replay(glState, &gpuProfiler);
+		gpuProfiler.end();
 
+		// Shadow mapping
+		if (packet.saveDepth) {
+			std::string filename = "depth_camera.png";
+			saveDepthTexture(sceneFBO, filename);
+			std::cout << "Depth texture saved to " << filename << std::endl;
+		}
+		cpu.render = (float)((glfwGetTime() - frameStart) * 1000.0);
+
+		cpu.hud = 0.0f;
+		if (showHud) {
+			TRACE_ZONE("hud");
+			double hudStart = glfwGetTime();
+			gpuProfiler.begin("hud");
+			overlay.update(currentFrame, cpu, gpuProfiler, glState.lastFrame, packet, glResources().totals());
+			overlay.draw(glState, stream);
+			gpuProfiler.end();
+			cpu.hud = (float)((glfwGetTime() - hudStart) * 1000.0);
+		}
 
-		// lookAt( where camera is, where its looking at relative to where it is, its up )
-		viewMatrix = glm::lookAt(cameraPosition, cameraPosition + cameraLookVector, cameraUp);
-		glm::mat4 vp = projectionMatrix * viewMatrix;
-
-		skybox.position = cameraPosition;
-		skybox.render(vp);
+		gpuProfiler.end();
+		gpuProfiler.endFrame();
+		stream.endFrame();
+		glState.endFrame();
+		if (saveGpuProfile) {
+			gpuProfiler.writeCsv("gpu_profile.csv");
+			saveGpuProfile = false;
+		}
+		if (saveTrace) {
+			traceWrite("trace.json");
+			saveTrace = false;
+		}
+		if (glStatsInterval > 0.0f && currentFrame - lastStatsTime >= glStatsInterval)
+		{
+			const CullStats& cameraCull = packet.cameraCull;
+			const CullStats& lightCull = packet.lightCull;
+			glState.printStats();
+			gpuProfiler.printStats();
+			glResources().printStats();
+			std::cout << "Culling: camera " << cameraCull.objectsVisible << " visible, " << cameraCull.objectsCulled << " culled ("
+				<< cameraCull.nodesTested << " nodes, " << cameraCull.objectsTested << " objects tested), light "
+				<< lightCull.objectsVisible << " visible, " << lightCull.objectsCulled << " culled" << std::endl;
+			std::cout << "Occlusion: " << packet.occlusion.occluderTriangles << " occluder triangles, "
+				<< packet.occlusion.objectsOccluded << " of " << packet.occlusion.objectsTested << " objects occluded" << std::endl;
+			lastStatsTime = currentFrame;
+		}
 
-		// For "moving" the ground as the player moves
-		int camTileX = static_cast<int>(floor(cameraPosition.x / tileSize));
-		int camTileZ = static_cast<int>(floor(cameraPosition.z / tileSize));
+		// Swap buffers
+		double swapStart = glfwGetTime();
+		{
+			TRACE_ZONE("swap buffers");
+			glfwSwapBuffers(window);
+		}
+		glfwPollEvents();
 
-		int index = 0;
-		for (int x = -1; x <= 1; ++x)
+		// Next frame draws what it made, and this packet is free for it to fill after that.
+		// Waiting here also means nothing is left running once the loop ends.
+		double waitStart = glfwGetTime();
 		{
-			for (int z = -1; z <= 1; ++z)
-			{
-				groundTiles[index].position.x = (camTileX + x) * tileSize;
-				groundTiles[index].position.z = (camTileZ + z) * tileSize;
-				groundTiles[index].position.y = 0.0f;
-				index++;
-			}
+			TRACE_ZONE("wait for simulation");
+			jobs.wait(simulating);
 		}
-		// ACtually rendering the ground
-		for (Ground& g : groundTiles)
+		double frameEnd = glfwGetTime();
+		cpu.swap = (float)((waitStart - swapStart) * 1000.0);
+		cpu.wait = (float)((frameEnd - waitStart) * 1000.0);
+		cpu.frame = (float)((frameEnd - frameStart) * 1000.0);
+		if (benchmark && frame >= BENCHMARK_WARMUP_FRAMES)
+			frameTimes.push_back(cpu.frame);
+
+		// Only atomics get touched here, the exporter's thread does the rest when scraped
+		if (exportingMetrics)
 		{
-			g.render(vp, tileSize);
+			metrics.recordFrame(cpu.frame, gpuProfiler.latest("frame"));
+			metrics.set(METRIC_DRAWS, glState.lastFrame.issued[GL_CALL_DRAW]);
+			metrics.set(METRIC_TRIANGLES_DRAWN, glState.lastFrame.triangles);
+			metrics.set(METRIC_VISIBLE_OBJECTS, packet.cameraCull.objectsVisible);
+			GLResourceTotals gl = glResources().totals();
+			metrics.set(METRIC_GPU_BUFFER_BYTES, gl.bytes[GL_RESOURCE_BUFFER]);
+			metrics.set(METRIC_GPU_TEXTURE_BYTES, gl.bytes[GL_RESOURCE_TEXTURE] + gl.bytes[GL_RESOURCE_RENDERBUFFER]);
 		}
+		frame++;
 
-		box.render(vp, viewMatrix);
-
-		// Shadow mapping
-		if (saveDepth) {
-			std::string filename = "depth_camera.png";
-			saveDepthTexture(0, filename);
-			std::cout << "Depth texture saved to " << filename << std::endl;
-			saveDepth = false;
-		}
+	} // Check if the ESC key was pressed or the window was closed
+	while (!glfwWindowShouldClose(window) && !(lastFrame >= 0 && frame >= lastFrame));
 
-		// Swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	// Live recordings replay at the average frame time they were made at. The camera
+	// is driven a frame ahead, so the last key is for a frame that was never drawn.
+	if (recordFile)
+	{
+		if (recordedPath.keys.size() > (size_t)frame)
+			recordedPath.keys.resize(frame);
+		if (!replaying && !benchmark && frame > 0)
+			recordedPath.timestep = (float)((glfwGetTime() - loopStart) / frame);
+		recordedPath.save(recordFile);
+	}
 
-	} // Check if the ESC key was pressed or the window was closed
-	while (!glfwWindowShouldClose(window));
+	int exitCode = 0;
+	if (benchmark)
+	{
+		std::ofstream file(benchmarkOutput);
+		if (file)
+		{
+			writeBenchmarkJson(file, frameTimes, gpuProfiler);
+			std::vector<double> sorted(frameTimes);
+			std::sort(sorted.begin(), sorted.end());
+			std::cout << std::fixed << std::setprecision(3) << "Benchmark: " << sorted.size() << " frames, p50 " << percentile(sorted, 0.5)
+				<< " ms, p99 " << percentile(sorted, 0.99) << " ms, results in " << benchmarkOutput << std::endl;
+		}
+		else
+		{
+			std::cerr << "Couldn't open " << benchmarkOutput << " for the results" << std::endl;
+			exitCode = 1;
+		}
+	}
 
 	// Clean up
 	skybox.cleanup();
-	for (Ground& g : groundTiles)
-	{
-		g.cleanup();
-	}
+	ground.cleanup();
 	box.cleanup();
+	overlay.hud.cleanup();
+	metrics.stop();
+	jobs.cleanup();
+	gpuProfiler.cleanup();
+	sceneFBO.reset();
+	sceneColor.reset();
+	sceneDepth.reset();
+	depthMapFBO.reset();
+	depthMapTexture.reset();
+	stream.cleanup();
+	gpuScene.cleanup();
+	meshArena.cleanup();
+
+	// Anything still alive now was never cleaned up
+	glResources().shutdown();
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
-	return 0;
+	return exitCode;
 }
 
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -1012,6 +1332,15 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		cameraPosition += glm::normalize(glm::cross(cameraLookVector, cameraUp)) * cameraSpeed;
 	}
 
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		saveGpuProfile = true;
+
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		saveTrace = true;
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS)
+		showHud = !showHud;
+
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
 }
@@ -1039,10 +1368,5 @@ static void cursor_callback(GLFWwindow* window, double xPos, double yPos) {
 	if (pitch < -89.0f)
 		pitch = -89.0f;
 
-	glm::vec3 tempVec(
-		cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
-		sin(glm::radians(pitch)),
-		sin(glm::radians(yaw)) * cos(glm::radians(pitch))
-	);
-	cameraLookVector = glm::normalize(tempVec);
+	cameraLookVector = lookVectorFromAngles((float)yaw, (float)pitch);
 }
\ No newline at end of file